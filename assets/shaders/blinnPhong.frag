@@ -1,73 +1,67 @@
 #version 450 core
 
-struct Material
+#include "include/common.glsl"
+#include "include/lighting.glsl"
+
+// per material values, filled in from Material's params and bound as one buffer range
+layout (std140, binding=3) uniform MaterialParams
 {
-	sampler2D diffuse;
-	sampler2D specular;
 	float shininess;
 };
 
-struct PointLight
-{
-	vec3 position;
-	vec3 color;
-	float ambientStrength;
-};
+// samplers only exist in the variants that use them, see ShaderFeature
+#ifdef HAS_DIFFUSE_MAP
+layout (binding=0) uniform sampler2D diffuseMap;
+#endif
+#ifdef HAS_SPECULAR_MAP
+layout (binding=1) uniform sampler2D specularMap;
+#endif
 
 in vec3 v_fragPos;
 in vec3 v_normal;
 in vec2 v_uv1;
 
-uniform Material material;
-
-layout (std140, binding=1) uniform Lighting
-{
-	PointLight light;
-};
-
-// TEMP
-layout (std140, binding=2) uniform Camera
-{
-	vec3 viewPos;
-};
-
 out vec4 fragColor;
 
 void main()
 {
-    // calculate values we'll be using throughout
-    vec3 normal = normalize(v_normal);
-    vec3 viewDirection = normalize(viewPos - v_fragPos);
-    vec3 lightDirection = normalize(light.position - v_fragPos);
-    float distance = length(light.position - v_fragPos);
-    float attenuation = 1.0 / (distance * distance);
-
     // sample textures
-    vec4 diffuse = texture(material.diffuse, v_uv1);
-    vec3 specular = vec3(texture(material.specular, v_uv1));
-
+#ifdef HAS_DIFFUSE_MAP
+    vec4 diffuse = texture(diffuseMap, v_uv1);
     if (diffuse.a < 0.1)
     {
         discard;
     }
+#else
+    vec4 diffuse = vec4(1.0);
+#endif
+
+    // calculate values we'll be using throughout
+    vec3 normal = normalize(v_normal);
+    vec3 lightDirection = normalize(light.position - v_fragPos);
+    float distance = length(light.position - v_fragPos);
+    float attenuation = 1.0 / (distance * distance);
 
     // calculate lighting components
     // ambient
     vec3 ambient = diffuse.rgb * light.ambientStrength;
 
     // diffuse
-    float NdotL = max(dot(normal, lightDirection), 0.0);
+    float NdotL = Lambert(normal, lightDirection);
     diffuse.rgb *= NdotL;
 
-    // specular
-    vec3 halfwayDirection = normalize(viewDirection + lightDirection);
-    float NdotH = max(dot(normal, halfwayDirection), 0.0);
-    float specPow = pow(NdotH, material.shininess);
+    // specular, skipped entirely without a map since it would always be black
+#ifdef HAS_SPECULAR_MAP
+    vec3 viewDirection = normalize(viewPos - v_fragPos);
+    vec3 specular = vec3(texture(specularMap, v_uv1));
     float specFalloff = 1 - pow(1 - NdotL, 3.0);
-    specular *= specPow * specFalloff;
+    specular *= BlinnPhong(normal, viewDirection, lightDirection, shininess) * specFalloff;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     // fragColor.rgb = ((diffuse.rgb + specular) * attenuation + ambient) * light.color;
     fragColor.rgb = (diffuse.rgb + specular + ambient) * attenuation * light.color;
-    fragColor.rgb = pow(fragColor.rgb, vec3(1.0/2.2));
+    fragColor.rgb = LinearToGamma(fragColor.rgb);
     fragColor.a = diffuse.a;
 }
\ No newline at end of file
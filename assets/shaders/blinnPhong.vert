@@ -3,23 +3,34 @@ layout (location = 0) in vec3 a_position;
 layout (location = 1) in vec3 a_normal;
 layout (location = 2) in vec2 a_uv1;
 
+#include "include/common.glsl"
+
+#ifdef HAS_DRAW_DATA
+#include "include/draw_data.glsl"
+
+// instanced attribute counting up from 0, offset to the draw's index by its base instance
+layout (location = 3) in uint a_drawId;
+#endif
+
 out vec3 v_fragPos;
 out vec3 v_normal;
 out vec2 v_uv1;
 
-layout (std140, binding=0) uniform Matrices
-{
-	mat4 projection;
-	mat4 view;
-};
+#ifndef HAS_DRAW_DATA
 uniform mat4 model;
+#endif
 
 void main()
 {
+#ifdef HAS_DRAW_DATA
+	// every matrix comes precomputed from the CPU or the culling pass
+	v_fragPos = vec3(draws[a_drawId].transform * vec4(a_position, 1.0));
+	v_normal = mat3(draws[a_drawId].normalMatrix) * a_normal;
+	gl_Position = draws[a_drawId].worldViewProjection * vec4(a_position, 1.0);
+#else
 	v_fragPos = vec3(model * vec4(a_position, 1.0));
-	// TODO: calculate normal matrix on CPU
 	v_normal = mat3(transpose(inverse(model))) * a_normal;
-	v_uv1 = a_uv1;
-	
 	gl_Position = projection * view * model * vec4(a_position, 1.0);
+#endif
+	v_uv1 = a_uv1;
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+// uniform blocks shared by every shader, bound once per frame by the renderer. Binding 3 is left for each shader's
+// MaterialParams block.
+
+struct PointLight
+{
+	vec3 position;
+	vec3 color;
+	float ambientStrength;
+};
+
+layout (std140, binding=0) uniform Matrices
+{
+	mat4 projection;
+	mat4 view;
+};
+
+layout (std140, binding=1) uniform Lighting
+{
+	PointLight light;
+};
+
+// TEMP
+layout (std140, binding=2) uniform Camera
+{
+	vec3 viewPos;
+};
\ No newline at end of file
@@ -0,0 +1,29 @@
+// per draw values, indexed by the draw id. Matches GpuDrawData in DrawData.h.
+
+struct DrawData
+{
+	mat4 transform;
+	// inverse transpose of the transform's 3x3, use as mat3
+	mat3x4 normalMatrix;
+	mat4 worldViewProjection;
+	// local space bounds, w unused
+	vec4 boundsMin;
+	vec4 boundsMax;
+	uint numIndices;
+	uint firstIndex;
+	int baseVertex;
+	// which of the model's materials the mesh is drawn with
+	uint group;
+};
+
+// the culling pass fills in worldViewProjection for the GPU driven path
+#ifdef DRAW_DATA_WRITABLE
+#define DRAW_DATA_ACCESS
+#else
+#define DRAW_DATA_ACCESS readonly
+#endif
+
+layout (std430, binding=0) DRAW_DATA_ACCESS buffer Draws
+{
+	DrawData draws[];
+};
\ No newline at end of file
@@ -0,0 +1,22 @@
+// Blinn-Phong terms shared by the lit shaders. Every direction is normalized and points away from the surface.
+
+float Lambert(vec3 normal, vec3 lightDirection)
+{
+	return max(dot(normal, lightDirection), 0.0);
+}
+
+float BlinnPhong(vec3 normal, vec3 viewDirection, vec3 lightDirection, float shininess)
+{
+	vec3 halfwayDirection = normalize(viewDirection + lightDirection);
+	return pow(max(dot(normal, halfwayDirection), 0.0), shininess);
+}
+
+vec3 GammaToLinear(vec3 color)
+{
+	return pow(color, vec3(2.2));
+}
+
+vec3 LinearToGamma(vec3 color)
+{
+	return pow(color, vec3(1.0 / 2.2));
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #version 450 core
 
+#include "include/lighting.glsl"
+
 in vec3 v_fragPos;
 in vec3 v_normal;
 
@@ -18,20 +20,18 @@ out vec4 fragColor;
 void main()
 {
 	// apply gamma to color
-	float gamma = 2.2;
-	vec3 c = pow(color, vec3(gamma));
+	vec3 c = GammaToLinear(color);
 
 	vec3 normal     = normalize(v_normal);
 	vec3 viewDir    = normalize(viewPos - v_fragPos);
 	vec3 lightDir   = normalize(lightPosition - v_fragPos);
-	vec3 halfwayDir = normalize(viewDir + lightDir);
 
-	float diffuseStrength  = max(dot(normal, lightDir), 0.0);
+	float diffuseStrength  = Lambert(normal, lightDir);
 
 	vec3 ambient  = lightColor * ambientStrength * c;
 	vec3 diffuse  = lightColor * diffuseStrength * c;
-	vec3 specular = lightColor * specularIntensity * pow(max(dot(normal, halfwayDir), 0.0), smoothness);
+	vec3 specular = lightColor * specularIntensity * BlinnPhong(normal, viewDir, lightDir, smoothness);
 
 	fragColor = vec4(diffuse + specular + ambient, 1.0);
-	fragColor.rgb = pow(fragColor.rgb, vec3(1.0/gamma));
+	fragColor.rgb = LinearToGamma(fragColor.rgb);
 }
\ No newline at end of file
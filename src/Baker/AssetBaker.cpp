@@ -0,0 +1,370 @@
+#include "AssetBaker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <utility>
+
+#include "Core/FileSystem.h"
+#include "Core/JobSystem.h"
+#include "Core/PakFile.h"
+#include "Renderer/Ktx2File.h"
+#include "Renderer/MeshCache.h"
+#include "Renderer/ModelImporter.h"
+#include "Renderer/TextureImage.h"
+#include "TextureEncoder.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const char* const MODEL_EXTENSIONS[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".blend" };
+	const char* const TEXTURE_EXTENSIONS[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif" };
+	const char* const MANIFEST_FILENAME = ".bake_manifest";
+
+	// bump whenever the texture conversion changes so every texture gets rebaked
+	const unsigned int TEXTURE_BAKE_VERSION = 3;
+
+	template <size_t N>
+	bool HasExtension(const fs::path& path, const char* const (&extensions)[N])
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+	}
+
+	// asset references use whatever separator the authoring tool wrote, but manifest keys need to be consistent
+	std::string NormalizePath(std::string path)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+		return fs::path(path).lexically_normal().generic_string();
+	}
+
+	template <typename T>
+	hash_t HashValue(const T& value, hash_t seed)
+	{
+		return HashBytes(&value, sizeof(value), seed);
+	}
+}
+
+AssetBaker::AssetBaker(const BakeOptions& options)
+	: m_options(options)
+	, m_previousManifest()
+	, m_manifest()
+	, m_models()
+	, m_textures()
+	, m_textureRequests()
+	, m_numBaked(0)
+	, m_numUpToDate(0)
+	, m_numFailed(0)
+	, m_numMissing(0)
+{
+}
+
+bool AssetBaker::Run()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::error_code error;
+	if (!fs::is_directory(m_options.assetsDirectory, error))
+	{
+		printf("Asset directory \"%s\" doesn't exist\n", m_options.assetsDirectory.c_str());
+		return false;
+	}
+
+	const std::string manifestFilename = NormalizePath((fs::path(m_options.assetsDirectory) / MANIFEST_FILENAME).generic_string());
+	if (!m_options.bForce)
+	{
+		m_previousManifest.Load(manifestFilename);
+	}
+
+	ScanAssets();
+	printf("Found %zu models and %zu textures in \"%s\"\n", m_models.size(), m_textures.size(), m_options.assetsDirectory.c_str());
+
+	JobSystem* pJobSystem = JobSystem::GetInstance();
+	// created here rather than lazily by the first bake job to read a file
+	FileSystem::GetInstance();
+
+	// models go first, since their materials decide how each texture will be loaded
+	pJobSystem->ParallelFor(static_cast<unsigned int>(m_models.size()), [this](unsigned int i)
+	{
+		BakeModel(i);
+	});
+
+	// textures no model references are baked with the default load settings
+	std::vector<std::pair<std::string, TextureRequest>> textureJobs(m_textureRequests.begin(), m_textureRequests.end());
+	for (const auto& texture : m_textures)
+	{
+		if (m_textureRequests.find(texture) == m_textureRequests.end())
+		{
+			textureJobs.emplace_back(texture, TextureRequest());
+		}
+	}
+
+	pJobSystem->ParallelFor(static_cast<unsigned int>(textureJobs.size()), [this, &textureJobs](unsigned int i)
+	{
+		BakeTexture(textureJobs[i].first, textureJobs[i].second);
+	});
+
+	m_manifest.Save(manifestFilename);
+
+	auto end = std::chrono::steady_clock::now();
+	printf("Baked %u, %u up to date, %u failed, %u missing in %.1fms using %u threads\n", m_numBaked.load(), m_numUpToDate.load(), m_numFailed.load(),
+		m_numMissing.load(), std::chrono::duration<double, std::milli>(end - start).count(), pJobSystem->GetNumWorkers() + 1);
+
+	if (m_numFailed > 0)
+	{
+		return false;
+	}
+
+	return m_options.packFilename.empty() || Pack();
+}
+
+void AssetBaker::ScanAssets()
+{
+	std::error_code error;
+	for (auto it = fs::recursive_directory_iterator(m_options.assetsDirectory, error); it != fs::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error)
+		{
+			printf("Error scanning \"%s\": %s\n", m_options.assetsDirectory.c_str(), error.message().c_str());
+			break;
+		}
+
+		if (!it->is_regular_file(error))
+		{
+			continue;
+		}
+
+		const fs::path& path = it->path();
+		if (HasExtension(path, MODEL_EXTENSIONS))
+		{
+			m_models.push_back(NormalizePath(path.generic_string()));
+		}
+		else if (HasExtension(path, TEXTURE_EXTENSIONS))
+		{
+			m_textures.push_back(NormalizePath(path.generic_string()));
+		}
+	}
+
+	std::sort(m_models.begin(), m_models.end());
+	std::sort(m_textures.begin(), m_textures.end());
+}
+
+void AssetBaker::BakeModel(unsigned int modelIndex)
+{
+	const std::string& source = m_models[modelIndex];
+	BakeManifest::Entry entry;
+	if (!HashFile(source, entry.sourceHash))
+	{
+		printf("Failed to read model \"%s\"\n", source.c_str());
+		++m_numFailed;
+		return;
+	}
+
+	entry.settingsHash = HashValue(MESH_CACHE_VERSION, HASH_SEED);
+	for (const auto& dependency : GetModelDependencies(source))
+	{
+		// a missing dependency hashes to 0, so it still triggers a rebuild once it shows up
+		hash_t dependencyHash = 0;
+		HashFile(dependency, dependencyHash);
+		entry.dependencies.emplace_back(NormalizePath(dependency), dependencyHash);
+	}
+
+	// the cache itself is keyed on the material libraries too, so the runtime can tell when they've changed
+	hash_t cacheHash = 0;
+	GetModelSourceHash(source, cacheHash);
+
+	const std::string output = source + MESH_CACHE_EXTENSION;
+	std::vector<ModelData::MaterialDesc> materials;
+	bool bHaveMaterials = false;
+
+	if (IsUpToDate(source, entry, output))
+	{
+		// nothing to rebuild, but the materials are still needed to know how the textures are used
+		MeshCache cache;
+		if (cache.Open(output, cacheHash))
+		{
+			materials.resize(cache.GetNumMaterials());
+			for (unsigned int i = 0; i < cache.GetNumMaterials(); ++i)
+			{
+				cache.GetMaterial(i, materials[i]);
+			}
+			bHaveMaterials = true;
+			++m_numUpToDate;
+		}
+	}
+
+	if (!bHaveMaterials)
+	{
+		ModelData data;
+		if (!ImportModelData(source, data) || !WriteMeshCache(output, cacheHash, data))
+		{
+			printf("Failed to bake model \"%s\"\n", source.c_str());
+			++m_numFailed;
+			return;
+		}
+
+		materials = std::move(data.materials);
+		printf("Baked \"%s\"\n", output.c_str());
+		++m_numBaked;
+	}
+
+	m_manifest.Set(source, entry);
+
+	// texture paths are relative to the model, the same way Model resolves them
+	const std::string directory = fs::path(source).parent_path().generic_string() + "/";
+	TextureRequest request;
+	request.modelIndex = modelIndex;
+	for (const auto& material : materials)
+	{
+		if (!material.diffuseTexture.empty())
+		{
+			GetMaterialTextureParams(MTS_DIFFUSE, request.params, request.isSRGB);
+			++request.useIndex;
+			RequestTexture(NormalizePath(directory + material.diffuseTexture), request);
+		}
+		if (!material.specularTexture.empty())
+		{
+			GetMaterialTextureParams(MTS_SPECULAR, request.params, request.isSRGB);
+			++request.useIndex;
+			RequestTexture(NormalizePath(directory + material.specularTexture), request);
+		}
+	}
+}
+
+void AssetBaker::BakeTexture(const std::string& source, const TextureRequest& request)
+{
+	std::error_code error;
+	if (!fs::exists(source, error))
+	{
+		printf("Warning: texture \"%s\" is referenced but doesn't exist, skipping it\n", source.c_str());
+		++m_numMissing;
+		return;
+	}
+
+	BakeManifest::Entry entry;
+	if (!HashFile(source, entry.sourceHash))
+	{
+		printf("Failed to read texture \"%s\"\n", source.c_str());
+		++m_numFailed;
+		return;
+	}
+
+	// only the settings that change the baked data, filtering and wrapping are applied at load time
+	entry.settingsHash = HashValue(TEXTURE_BAKE_VERSION, HASH_SEED);
+	entry.settingsHash = HashValue(request.params.compression, entry.settingsHash);
+	entry.settingsHash = HashValue(request.params.forceComponents, entry.settingsHash);
+	entry.settingsHash = HashValue(request.params.bGenerateMips, entry.settingsHash);
+	entry.settingsHash = HashValue(request.params.bFlipVerticallyOnLoad, entry.settingsHash);
+	entry.settingsHash = HashValue(request.isSRGB, entry.settingsHash);
+
+	const std::string output = source + BAKED_TEXTURE_EXTENSION;
+	if (IsUpToDate(source, entry, output))
+	{
+		m_manifest.Set(source, entry);
+		++m_numUpToDate;
+		return;
+	}
+
+	TextureImage image;
+	if (!DecodeTextureImage(source, request.params, request.isSRGB, image))
+	{
+		++m_numFailed;
+		return;
+	}
+
+	if (request.params.bGenerateMips)
+	{
+		GenerateMipChain(image);
+	}
+
+	if (request.params.compression != TC_NONE && !CompressTextureImage(image, GetCompressedFormat(request.params.compression)))
+	{
+		++m_numFailed;
+		return;
+	}
+
+	if (!WriteKtx2(output, image, entry.sourceHash))
+	{
+		++m_numFailed;
+		return;
+	}
+
+	m_manifest.Set(source, entry);
+	printf("Baked \"%s\"\n", output.c_str());
+	++m_numBaked;
+}
+
+bool AssetBaker::Pack()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// sources go in alongside their baked files, since the runtime still checks baked files against them
+	std::vector<PakSourceFile> files;
+	std::error_code error;
+	const fs::path archivePath = fs::absolute(m_options.packFilename, error);
+	for (auto it = fs::recursive_directory_iterator(m_options.assetsDirectory, error); it != fs::recursive_directory_iterator(); it.increment(error))
+	{
+		if (error)
+		{
+			printf("Error scanning \"%s\": %s\n", m_options.assetsDirectory.c_str(), error.message().c_str());
+			return false;
+		}
+
+		const fs::path& path = it->path();
+		if (!it->is_regular_file(error) || path.filename() == MANIFEST_FILENAME || path.extension() == ".tmp" || fs::absolute(path, error) == archivePath)
+		{
+			continue;
+		}
+
+		const std::string filename = NormalizePath(path.generic_string());
+		files.push_back({ filename, filename });
+	}
+
+	if (!WritePak(m_options.packFilename, files, m_options.bCompressPack))
+	{
+		return false;
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	printf("Packed %zu files into \"%s\" in %.1fms\n", files.size(), m_options.packFilename.c_str(), std::chrono::duration<double, std::milli>(end - start).count());
+	return true;
+}
+
+bool AssetBaker::IsUpToDate(const std::string& source, const BakeManifest::Entry& entry, const std::string& output) const
+{
+	if (m_options.bForce)
+	{
+		return false;
+	}
+
+	BakeManifest::Entry previousEntry;
+	std::error_code error;
+	return m_previousManifest.Find(source, previousEntry) && previousEntry == entry && fs::exists(output, error);
+}
+
+void AssetBaker::RequestTexture(const std::string& source, const TextureRequest& request)
+{
+	std::lock_guard<std::mutex> lock(m_textureRequestsMutex);
+	auto it = m_textureRequests.find(source);
+	if (it == m_textureRequests.end())
+	{
+		m_textureRequests.emplace(source, request);
+		return;
+	}
+
+	TextureRequest& existing = it->second;
+	if (existing.params.compression != request.params.compression || existing.params.forceComponents != request.params.forceComponents || existing.params.bGenerateMips != request.params.bGenerateMips
+		|| existing.params.bFlipVerticallyOnLoad != request.params.bFlipVerticallyOnLoad || existing.isSRGB != request.isSRGB)
+	{
+		printf("Warning: texture \"%s\" is used with conflicting settings, baking it for its first use only\n", source.c_str());
+	}
+
+	if (std::make_pair(request.modelIndex, request.useIndex) < std::make_pair(existing.modelIndex, existing.useIndex))
+	{
+		existing = request;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef ASSET_BAKER_H
+#define ASSET_BAKER_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BakeManifest.h"
+#include "Renderer/Texture.h"
+
+struct BakeOptions
+{
+	std::string assetsDirectory = "assets";
+	// when set, everything in the asset directory is packed into this archive after baking
+	std::string packFilename;
+	bool bCompressPack = true;
+	bool bForce = false;
+};
+
+// Walks the asset directory and bakes everything that changed since the last run into the formats the runtime
+// loads directly: models into mesh caches (.omesh) and textures into KTX2 files with full mip chains, block
+// compressed when their material slot asks for it. Baked files are written next to their sources, and the whole
+// directory can then be packed into a single .opak archive.
+class AssetBaker
+{
+public:
+	AssetBaker(const BakeOptions& options);
+
+	// returns false if any asset failed to bake
+	bool Run();
+
+private:
+	struct TextureRequest
+	{
+		TextureParams params;
+		bool isSRGB = false;
+		// where the texture was first used, in model then material order. Models bake in parallel, so this is what
+		// decides which use wins when they disagree rather than whichever job got there first.
+		unsigned int modelIndex = 0;
+		unsigned int useIndex = 0;
+	};
+
+	void ScanAssets();
+	void BakeModel(unsigned int modelIndex);
+	void BakeTexture(const std::string& source, const TextureRequest& request);
+	bool Pack();
+
+	bool IsUpToDate(const std::string& source, const BakeManifest::Entry& entry, const std::string& output) const;
+	void RequestTexture(const std::string& source, const TextureRequest& request);
+
+	BakeOptions m_options;
+	BakeManifest m_previousManifest;
+	BakeManifest m_manifest;
+
+	std::vector<std::string> m_models;
+	std::vector<std::string> m_textures;
+
+	// how each texture is going to be loaded, discovered from the materials of the models that reference it
+	std::map<std::string, TextureRequest> m_textureRequests;
+	std::mutex m_textureRequestsMutex;
+
+	std::atomic<unsigned int> m_numBaked;
+	std::atomic<unsigned int> m_numUpToDate;
+	std::atomic<unsigned int> m_numFailed;
+	// textures materials reference that aren't on disk, the runtime shows its placeholder for those
+	std::atomic<unsigned int> m_numMissing;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "BakeManifest.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	bool ParseHash(const std::string& str, hash_t& outHash)
+	{
+		uint64_t value = 0;
+		if (sscanf(str.c_str(), "%" SCNx64, &value) != 1)
+		{
+			return false;
+		}
+
+		outHash = value;
+		return true;
+	}
+
+	std::string FormatHash(hash_t hash)
+	{
+		char buffer[17];
+		snprintf(buffer, sizeof(buffer), "%016" PRIx64, static_cast<uint64_t>(hash));
+		return buffer;
+	}
+}
+
+bool BakeManifest::Load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::vector<std::string> fields;
+		std::istringstream lineStream(line);
+		std::string field;
+		while (std::getline(lineStream, field, '\t'))
+		{
+			fields.push_back(field);
+		}
+
+		// a malformed line just means that asset gets rebuilt
+		Entry entry;
+		if (fields.size() < 3 || fields.size() % 2 == 0 || !ParseHash(fields[1], entry.sourceHash) || !ParseHash(fields[2], entry.settingsHash))
+		{
+			continue;
+		}
+
+		bool bValid = true;
+		for (size_t i = 3; i < fields.size() && bValid; i += 2)
+		{
+			hash_t dependencyHash = 0;
+			bValid = ParseHash(fields[i + 1], dependencyHash);
+			entry.dependencies.emplace_back(fields[i], dependencyHash);
+		}
+
+		if (bValid)
+		{
+			m_entries[fields[0]] = entry;
+		}
+	}
+
+	return true;
+}
+
+bool BakeManifest::Save(const std::string& filename) const
+{
+	std::ofstream file(filename, std::ios::trunc);
+	if (!file)
+	{
+		printf("Failed to write bake manifest \"%s\"\n", filename.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (const auto& it : m_entries)
+	{
+		file << it.first << '\t' << FormatHash(it.second.sourceHash) << '\t' << FormatHash(it.second.settingsHash);
+		for (const auto& dependency : it.second.dependencies)
+		{
+			file << '\t' << dependency.first << '\t' << FormatHash(dependency.second);
+		}
+		file << '\n';
+	}
+
+	return static_cast<bool>(file);
+}
+
+bool BakeManifest::Find(const std::string& source, Entry& outEntry) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(source);
+	if (it == m_entries.end())
+	{
+		return false;
+	}
+
+	outEntry = it->second;
+	return true;
+}
+
+void BakeManifest::Set(const std::string& source, const Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries[source] = entry;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef BAKE_MANIFEST_H
+#define BAKE_MANIFEST_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Core/Hash.h"
+
+// Record of what every baked asset was built from: the hash of its source, the hash of the settings it was baked
+// with and the hashes of any other files it depends on. An asset only needs rebuilding when one of those changes.
+//
+// stored as text, one asset per line:
+// <source>\t<source hash>\t<settings hash>[\t<dependency>\t<dependency hash>]...
+class BakeManifest
+{
+public:
+	struct Entry
+	{
+		hash_t sourceHash = 0;
+		hash_t settingsHash = 0;
+		std::vector<std::pair<std::string, hash_t>> dependencies;
+
+		bool operator==(const Entry& other) const
+		{
+			return sourceHash == other.sourceHash && settingsHash == other.settingsHash && dependencies == other.dependencies;
+		}
+	};
+
+	bool Load(const std::string& filename);
+	bool Save(const std::string& filename) const;
+
+	// both are safe to call from multiple threads
+	bool Find(const std::string& source, Entry& outEntry) const;
+	void Set(const std::string& source, const Entry& entry);
+
+private:
+	std::map<std::string, Entry> m_entries;
+	mutable std::mutex m_mutex;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,588 @@
+#include "TextureEncoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace
+{
+	const unsigned int BLOCK_PIXELS = 16;
+	const unsigned int MAX_PALETTE_SIZE = 16;
+
+	// interpolation weights (out of 64) for BC7's 4 bit indices
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// a 4x4 block with each channel stored contiguously, so 4 pixels can be processed per SSE op
+	struct alignas(16) BlockPixels
+	{
+		float channels[4][BLOCK_PIXELS];
+	};
+
+	struct Palette
+	{
+		float colors[MAX_PALETTE_SIZE][4];
+		unsigned int size;
+	};
+
+	// packs little endian bit fields, least significant bit first
+	class BitWriter
+	{
+	public:
+		BitWriter(unsigned char* pData, size_t size)
+			: m_pData(pData)
+			, m_offset(0)
+		{
+			memset(pData, 0, size);
+		}
+
+		void Write(uint32_t value, unsigned int numBits)
+		{
+			for (unsigned int i = 0; i < numBits; ++i, ++m_offset)
+			{
+				m_pData[m_offset >> 3] |= static_cast<unsigned char>(((value >> i) & 1) << (m_offset & 7));
+			}
+		}
+
+	private:
+		unsigned char* m_pData;
+		unsigned int m_offset;
+	};
+
+	void LoadBlock(const unsigned char* pSrc, unsigned int width, unsigned int height, unsigned int numComponents, unsigned int blockX, unsigned int blockY, BlockPixels& outBlock)
+	{
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			// partial blocks at the right and bottom edges repeat the last column/row
+			const unsigned int x = std::min(blockX * 4 + (i & 3), width - 1);
+			const unsigned int y = std::min(blockY * 4 + (i >> 2), height - 1);
+			const unsigned char* pTexel = pSrc + (static_cast<size_t>(y) * width + x) * numComponents;
+
+			float texel[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+			if (numComponents == 1)
+			{
+				// greyscale, so colour formats get the same value in every channel
+				texel[0] = texel[1] = texel[2] = pTexel[0];
+			}
+			else
+			{
+				for (unsigned int c = 0; c < numComponents; ++c)
+				{
+					texel[c] = pTexel[c];
+				}
+			}
+
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				outBlock.channels[c][i] = texel[c];
+			}
+		}
+	}
+
+	// outT[i] = dot(pixel i - origin, axis) over channels [firstChannel, firstChannel + numChannels)
+	void ProjectBlock(const BlockPixels& block, unsigned int firstChannel, unsigned int numChannels, const float* pOrigin, const float* pAxis, float* pOutT)
+	{
+#ifdef ORCA_SSE2
+		for (unsigned int i = 0; i < BLOCK_PIXELS; i += 4)
+		{
+			__m128 t = _mm_setzero_ps();
+			for (unsigned int c = 0; c < numChannels; ++c)
+			{
+				const __m128 delta = _mm_sub_ps(_mm_load_ps(&block.channels[firstChannel + c][i]), _mm_set1_ps(pOrigin[c]));
+				t = _mm_add_ps(t, _mm_mul_ps(delta, _mm_set1_ps(pAxis[c])));
+			}
+			_mm_storeu_ps(pOutT + i, t);
+		}
+#else
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			float t = 0.0f;
+			for (unsigned int c = 0; c < numChannels; ++c)
+			{
+				t += (block.channels[firstChannel + c][i] - pOrigin[c]) * pAxis[c];
+			}
+			pOutT[i] = t;
+		}
+#endif
+	}
+
+	// picks the closest palette entry for every pixel and returns the total squared error. Palette colors are indexed
+	// relative to firstChannel.
+	float SelectIndices(const BlockPixels& block, unsigned int firstChannel, unsigned int numChannels, const Palette& palette, unsigned char* pOutIndices)
+	{
+#ifdef ORCA_SSE2
+		__m128 totalError = _mm_setzero_ps();
+		for (unsigned int i = 0; i < BLOCK_PIXELS; i += 4)
+		{
+			__m128 bestError = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (unsigned int p = 0; p < palette.size; ++p)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (unsigned int c = 0; c < numChannels; ++c)
+				{
+					const __m128 delta = _mm_sub_ps(_mm_load_ps(&block.channels[firstChannel + c][i]), _mm_set1_ps(palette.colors[p][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(delta, delta));
+				}
+
+				const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+				bestError = _mm_min_ps(error, bestError);
+			}
+
+			alignas(16) int32_t indices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+			for (unsigned int j = 0; j < 4; ++j)
+			{
+				pOutIndices[i + j] = static_cast<unsigned char>(indices[j]);
+			}
+			totalError = _mm_add_ps(totalError, bestError);
+		}
+
+		alignas(16) float errors[4];
+		_mm_store_ps(errors, totalError);
+		return errors[0] + errors[1] + errors[2] + errors[3];
+#else
+		float totalError = 0.0f;
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			float bestError = FLT_MAX;
+			for (unsigned int p = 0; p < palette.size; ++p)
+			{
+				float error = 0.0f;
+				for (unsigned int c = 0; c < numChannels; ++c)
+				{
+					const float delta = block.channels[firstChannel + c][i] - palette.colors[p][c];
+					error += delta * delta;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					pOutIndices[i] = static_cast<unsigned char>(p);
+				}
+			}
+			totalError += bestError;
+		}
+		return totalError;
+#endif
+	}
+
+	// endpoints at either end of the block's colors along their principal axis, found by power iteration on the
+	// covariance matrix
+	void FitEndpoints(const BlockPixels& block, unsigned int firstChannel, unsigned int numChannels, float* pOutEndpoint0, float* pOutEndpoint1)
+	{
+		float mean[4] = {};
+		for (unsigned int c = 0; c < numChannels; ++c)
+		{
+			for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+			{
+				mean[c] += block.channels[firstChannel + c][i];
+			}
+			mean[c] /= BLOCK_PIXELS;
+		}
+
+		float covariance[4][4] = {};
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			for (unsigned int a = 0; a < numChannels; ++a)
+			{
+				for (unsigned int b = 0; b < numChannels; ++b)
+				{
+					covariance[a][b] += (block.channels[firstChannel + a][i] - mean[a]) * (block.channels[firstChannel + b][i] - mean[b]);
+				}
+			}
+		}
+
+		// starting from the channel with the largest spread converges in a handful of iterations
+		unsigned int largest = 0;
+		for (unsigned int c = 1; c < numChannels; ++c)
+		{
+			largest = covariance[c][c] > covariance[largest][largest] ? c : largest;
+		}
+
+		float axis[4] = {};
+		memcpy(axis, covariance[largest], sizeof(axis));
+		for (unsigned int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float scale = 0.0f;
+			for (unsigned int a = 0; a < numChannels; ++a)
+			{
+				for (unsigned int b = 0; b < numChannels; ++b)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				scale = std::max(scale, std::fabs(next[a]));
+			}
+
+			if (scale < FLT_EPSILON)
+			{
+				break;
+			}
+
+			for (unsigned int c = 0; c < numChannels; ++c)
+			{
+				axis[c] = next[c] / scale;
+			}
+		}
+
+		float length = 0.0f;
+		for (unsigned int c = 0; c < numChannels; ++c)
+		{
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (unsigned int c = 0; c < numChannels; ++c)
+		{
+			// a flat block has no axis, both endpoints then end up at the mean
+			axis[c] = length > FLT_EPSILON ? axis[c] / length : 0.0f;
+		}
+
+		float t[BLOCK_PIXELS];
+		ProjectBlock(block, firstChannel, numChannels, mean, axis, t);
+		const float minT = *std::min_element(t, t + BLOCK_PIXELS);
+		const float maxT = *std::max_element(t, t + BLOCK_PIXELS);
+		for (unsigned int c = 0; c < numChannels; ++c)
+		{
+			pOutEndpoint0[c] = mean[c] + axis[c] * minT;
+			pOutEndpoint1[c] = mean[c] + axis[c] * maxT;
+		}
+	}
+
+	// least squares endpoints for the chosen indices, where pWeights[index] is how much of endpoint 1 that index
+	// blends in. Returns false if the indices don't constrain both endpoints.
+	bool RefitEndpoints(const BlockPixels& block, unsigned int firstChannel, unsigned int numChannels, const unsigned char* pIndices, const float* pWeights, float* pOutEndpoint0, float* pOutEndpoint1)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			const float b = pWeights[pIndices[i]];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (unsigned int c = 0; c < numChannels; ++c)
+			{
+				ax[c] += a * block.channels[firstChannel + c][i];
+				bx[c] += b * block.channels[firstChannel + c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < FLT_EPSILON)
+		{
+			return false;
+		}
+
+		for (unsigned int c = 0; c < numChannels; ++c)
+		{
+			pOutEndpoint0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+			pOutEndpoint1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	unsigned int Quantize(float value, unsigned int maxValue)
+	{
+		return static_cast<unsigned int>(std::min(std::max(value * maxValue / 255.0f + 0.5f, 0.0f), static_cast<float>(maxValue)));
+	}
+
+	uint16_t PackRGB565(const float* pColor)
+	{
+		return static_cast<uint16_t>((Quantize(pColor[0], 31) << 11) | (Quantize(pColor[1], 63) << 5) | Quantize(pColor[2], 31));
+	}
+
+	void UnpackRGB565(uint16_t packed, float* pOutColor)
+	{
+		const unsigned int r = (packed >> 11) & 31;
+		const unsigned int g = (packed >> 5) & 63;
+		const unsigned int b = packed & 31;
+		pOutColor[0] = static_cast<float>((r << 3) | (r >> 2));
+		pOutColor[1] = static_cast<float>((g << 2) | (g >> 4));
+		pOutColor[2] = static_cast<float>((b << 3) | (b >> 2));
+	}
+
+	// BC1 colour block in 4 colour mode (color0 > color1), which may swap the endpoints. Returns the squared error
+	// and the indices as stored.
+	float EncodeBC1Colors(const BlockPixels& block, const float* pEndpoint0, const float* pEndpoint1, unsigned char* pOutBlock, unsigned char* pOutIndices)
+	{
+		uint16_t color0 = PackRGB565(pEndpoint0);
+		uint16_t color1 = PackRGB565(pEndpoint1);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		// palette order is color0, color1, 2/3 color0 + 1/3 color1, 1/3 color0 + 2/3 color1. Equal endpoints would
+		// switch to 3 colour mode, but every pixel then simply uses index 0.
+		Palette palette;
+		palette.size = color0 == color1 ? 1 : 4;
+		UnpackRGB565(color0, palette.colors[0]);
+		UnpackRGB565(color1, palette.colors[1]);
+		for (unsigned int c = 0; c < 3; ++c)
+		{
+			palette.colors[2][c] = (2.0f * palette.colors[0][c] + palette.colors[1][c]) / 3.0f;
+			palette.colors[3][c] = (palette.colors[0][c] + 2.0f * palette.colors[1][c]) / 3.0f;
+		}
+
+		const float error = SelectIndices(block, 0, 3, palette, pOutIndices);
+
+		BitWriter writer(pOutBlock, 8);
+		writer.Write(color0, 16);
+		writer.Write(color1, 16);
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			writer.Write(pOutIndices[i], 2);
+		}
+		return error;
+	}
+
+	void EncodeBC1Block(const BlockPixels& block, unsigned char* pOutBlock)
+	{
+		// how much of color1 each index blends in
+		const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float endpoint0[4];
+		float endpoint1[4];
+		unsigned char indices[BLOCK_PIXELS];
+		FitEndpoints(block, 0, 3, endpoint0, endpoint1);
+		const float error = EncodeBC1Colors(block, endpoint0, endpoint1, pOutBlock, indices);
+		if (error == 0.0f)
+		{
+			return;
+		}
+
+		// the refit is relative to the endpoints as stored, EncodeBC1Colors reorders them again as needed
+		unsigned char refitBlock[8];
+		unsigned char refitIndices[BLOCK_PIXELS];
+		if (RefitEndpoints(block, 0, 3, indices, weights, endpoint0, endpoint1) && EncodeBC1Colors(block, endpoint0, endpoint1, refitBlock, refitIndices) < error)
+		{
+			memcpy(pOutBlock, refitBlock, sizeof(refitBlock));
+		}
+	}
+
+	// 8 value mode (value0 > value1) for a single channel
+	void EncodeBC4Block(const BlockPixels& block, unsigned int channel, unsigned char* pOutBlock)
+	{
+		const float* pValues = block.channels[channel];
+		const unsigned int value0 = Quantize(*std::max_element(pValues, pValues + BLOCK_PIXELS), 255);
+		const unsigned int value1 = Quantize(*std::min_element(pValues, pValues + BLOCK_PIXELS), 255);
+
+		Palette palette;
+		palette.size = value0 == value1 ? 1 : 8;
+		palette.colors[0][0] = static_cast<float>(value0);
+		palette.colors[1][0] = static_cast<float>(value1);
+		for (unsigned int i = 2; i < 8; ++i)
+		{
+			palette.colors[i][0] = ((8 - i) * value0 + (i - 1) * value1) / 7.0f;
+		}
+
+		unsigned char indices[BLOCK_PIXELS];
+		SelectIndices(block, channel, 1, palette, indices);
+
+		BitWriter writer(pOutBlock, 8);
+		writer.Write(value0, 8);
+		writer.Write(value1, 8);
+		for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+		{
+			writer.Write(indices[i], 3);
+		}
+	}
+
+	// rounds an 8 bit endpoint to 7 bits per channel plus a shared low bit, picking whichever low bit fits best
+	void QuantizeBC7Endpoint(const float* pColor, unsigned int* pOutQuantized, unsigned int& outPBit, float* pOutColor)
+	{
+		float bestError = FLT_MAX;
+		for (unsigned int pBit = 0; pBit < 2; ++pBit)
+		{
+			float error = 0.0f;
+			unsigned int quantized[4];
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				quantized[c] = static_cast<unsigned int>(std::min(std::max((pColor[c] - pBit) * 0.5f + 0.5f, 0.0f), 127.0f));
+				const float delta = pColor[c] - static_cast<float>((quantized[c] << 1) | pBit);
+				error += delta * delta;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				outPBit = pBit;
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					pOutQuantized[c] = quantized[c];
+					pOutColor[c] = static_cast<float>((quantized[c] << 1) | pBit);
+				}
+			}
+		}
+	}
+
+	// may swap the endpoints to satisfy the anchor index rule. Returns the squared error and the indices as stored.
+	float EncodeBC7Mode6(const BlockPixels& block, const float* pEndpoint0, const float* pEndpoint1, unsigned char* pOutBlock, unsigned char* pOutIndices)
+	{
+		unsigned int quantized[2][4];
+		unsigned int pBits[2];
+		Palette palette;
+		palette.size = 16;
+		QuantizeBC7Endpoint(pEndpoint0, quantized[0], pBits[0], palette.colors[0]);
+		QuantizeBC7Endpoint(pEndpoint1, quantized[1], pBits[1], palette.colors[15]);
+
+		float endpoints[2][4];
+		memcpy(endpoints[0], palette.colors[0], sizeof(endpoints[0]));
+		memcpy(endpoints[1], palette.colors[15], sizeof(endpoints[1]));
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				const int value = ((64 - BC7_WEIGHTS[i]) * static_cast<int>(endpoints[0][c]) + BC7_WEIGHTS[i] * static_cast<int>(endpoints[1][c]) + 32) >> 6;
+				palette.colors[i][c] = static_cast<float>(value);
+			}
+		}
+
+		const float error = SelectIndices(block, 0, 4, palette, pOutIndices);
+
+		// the first index is stored without its top bit, so it has to be in the lower half of the palette
+		unsigned int first = 0;
+		if (pOutIndices[0] & 8)
+		{
+			first = 1;
+			for (unsigned int i = 0; i < BLOCK_PIXELS; ++i)
+			{
+				pOutIndices[i] = static_cast<unsigned char>(15 - pOutIndices[i]);
+			}
+		}
+		const unsigned int second = 1 - first;
+
+		BitWriter writer(pOutBlock, 16);
+		writer.Write(1 << 6, 7);
+		for (unsigned int c = 0; c < 4; ++c)
+		{
+			writer.Write(quantized[first][c], 7);
+			writer.Write(quantized[second][c], 7);
+		}
+		writer.Write(pBits[first], 1);
+		writer.Write(pBits[second], 1);
+		writer.Write(pOutIndices[0], 3);
+		for (unsigned int i = 1; i < BLOCK_PIXELS; ++i)
+		{
+			writer.Write(pOutIndices[i], 4);
+		}
+		return error;
+	}
+
+	void EncodeBC7Block(const BlockPixels& block, unsigned char* pOutBlock)
+	{
+		float weights[16];
+		for (unsigned int i = 0; i < 16; ++i)
+		{
+			weights[i] = BC7_WEIGHTS[i] / 64.0f;
+		}
+
+		float endpoint0[4];
+		float endpoint1[4];
+		unsigned char indices[BLOCK_PIXELS];
+		FitEndpoints(block, 0, 4, endpoint0, endpoint1);
+		const float error = EncodeBC7Mode6(block, endpoint0, endpoint1, pOutBlock, indices);
+		if (error == 0.0f)
+		{
+			return;
+		}
+
+		unsigned char refitBlock[16];
+		unsigned char refitIndices[BLOCK_PIXELS];
+		if (RefitEndpoints(block, 0, 4, indices, weights, endpoint0, endpoint1) && EncodeBC7Mode6(block, endpoint0, endpoint1, refitBlock, refitIndices) < error)
+		{
+			memcpy(pOutBlock, refitBlock, sizeof(refitBlock));
+		}
+	}
+
+	void EncodeBlock(const BlockPixels& block, TextureFormat format, unsigned char* pOutBlock)
+	{
+		switch (format)
+		{
+		case TF_BC1:
+			EncodeBC1Block(block, pOutBlock);
+			break;
+		case TF_BC3:
+			EncodeBC4Block(block, 3, pOutBlock);
+			EncodeBC1Block(block, pOutBlock + 8);
+			break;
+		case TF_BC4:
+			EncodeBC4Block(block, 0, pOutBlock);
+			break;
+		case TF_BC5:
+			EncodeBC4Block(block, 0, pOutBlock);
+			EncodeBC4Block(block, 1, pOutBlock + 8);
+			break;
+		case TF_BC7:
+			EncodeBC7Block(block, pOutBlock);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+bool CompressTextureImage(TextureImage& image, TextureFormat format)
+{
+	if (!IsCompressedFormat(format) || IsCompressedFormat(image.format))
+	{
+		printf("Error. Can't compress a texture from format %i to %i\n", image.format, format);
+		return false;
+	}
+
+	struct BlockRow
+	{
+		unsigned int level;
+		unsigned int row;
+	};
+
+	const unsigned int numComponents = GetTextureFormatComponents(image.format);
+	const unsigned int blockSize = GetTextureFormatBlockSize(format);
+	const unsigned int numLevels = static_cast<unsigned int>(image.levels.size());
+
+	// every row of blocks in every level is an independent job
+	std::vector<std::vector<unsigned char>> compressedLevels(numLevels);
+	std::vector<BlockRow> rows;
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		const unsigned int width = std::max(image.width >> level, 1u);
+		const unsigned int height = std::max(image.height >> level, 1u);
+		compressedLevels[level].resize(GetTextureLevelSize(format, width, height));
+		for (unsigned int row = 0; row < (height + 3) / 4; ++row)
+		{
+			rows.push_back({ level, row });
+		}
+	}
+
+	JobSystem::GetInstance()->ParallelFor(static_cast<unsigned int>(rows.size()), [&](unsigned int i)
+	{
+		const BlockRow& row = rows[i];
+		const unsigned int width = std::max(image.width >> row.level, 1u);
+		const unsigned int height = std::max(image.height >> row.level, 1u);
+		const unsigned int numBlocksX = (width + 3) / 4;
+		unsigned char* pDst = compressedLevels[row.level].data() + static_cast<size_t>(row.row) * numBlocksX * blockSize;
+
+		BlockPixels block;
+		for (unsigned int blockX = 0; blockX < numBlocksX; ++blockX)
+		{
+			LoadBlock(image.levels[row.level].data(), width, height, numComponents, blockX, row.row, block);
+			EncodeBlock(block, format, pDst + blockX * blockSize);
+		}
+	});
+
+	image.levels = std::move(compressedLevels);
+	image.format = format;
+	image.bSRGB = image.bSRGB && HasSRGBVariant(format);
+	return true;
+}
\ No newline at end of file
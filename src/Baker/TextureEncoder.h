@@ -0,0 +1,11 @@
+#ifndef TEXTURE_ENCODER_H
+#define TEXTURE_ENCODER_H
+
+#include "Renderer/TextureImage.h"
+
+// Block compresses every level of an uncompressed image in place. Blocks are fit along the principal axis of their
+// colors and refined with a least squares pass. BC7 only uses mode 6 (a single RGBA subset with 4 bit indices).
+// Rows of blocks are spread across the job system.
+bool CompressTextureImage(TextureImage& image, TextureFormat format);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <cstring>
+
+#include "AssetBaker.h"
+
+void PrintUsage()
+{
+	printf("Usage: orca-bake [options] [asset directory]\n");
+	printf("Bakes models and textures into the formats Orca loads directly. Defaults to \"assets\".\n\n");
+	printf("Options:\n");
+	printf("  -f, --force            Rebake everything, ignoring the manifest from previous runs\n");
+	printf("  -p, --pack <archive>   Pack the asset directory into an archive after baking\n");
+	printf("      --no-compress      Store files in the archive uncompressed\n");
+	printf("  -h, --help             Show this message\n");
+}
+
+int main(int argc, char** argv)
+{
+	BakeOptions options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--force") == 0)
+		{
+			options.bForce = true;
+		}
+		else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pack") == 0) && i + 1 < argc)
+		{
+			options.packFilename = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-compress") == 0)
+		{
+			options.bCompressPack = false;
+		}
+		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (argv[i][0] == '-')
+		{
+			printf("Unknown option \"%s\"\n\n", argv[i]);
+			PrintUsage();
+			return -1;
+		}
+		else
+		{
+			options.assetsDirectory = argv[i];
+		}
+	}
+
+	AssetBaker baker(options);
+	return baker.Run() ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,552 @@
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "JobSystem.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ORCA_IO_URING
+#endif
+#endif
+
+#ifdef ORCA_IO_URING
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+#endif
+
+AsyncFileReader* AsyncFileReader::s_instance = nullptr;
+
+struct AsyncFileReader::Request
+{
+	std::string filename;
+	ReadCallback callback;
+	FileContents contents;
+	size_t size = 0;
+	size_t offset = 0;
+	int fd = -1;
+#ifdef ORCA_IO_URING
+	struct statx stat;
+	unsigned int numPendingOps = 0;
+	bool bFailed = false;
+#endif
+};
+
+#ifdef ORCA_IO_URING
+namespace
+{
+	const unsigned int RING_ENTRIES = 64;
+	// every request has at most two operations in flight, so this keeps both queues from ever filling up
+	const unsigned int MAX_ACTIVE_REQUESTS = RING_ENTRIES / 2;
+	// a single read is limited to a 32 bit length, larger files are read in pieces
+	const size_t MAX_READ_SIZE = 1 << 30;
+
+	// the operation is stored in the low bits of the user data, requests are always at least 4 byte aligned
+	enum RingOperation
+	{
+		RO_WAKE = 0,
+		RO_OPEN = 1,
+		RO_STAT = 2,
+		RO_READ = 3,
+	};
+	const unsigned long long RING_OPERATION_MASK = 3;
+	// everything a request needs, all added in 5.6 along with the probe itself
+	const unsigned char REQUIRED_OPCODES[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ };
+}
+
+struct AsyncFileReader::Ring
+{
+	int fd = -1;
+
+	void* pSqMapping = MAP_FAILED;
+	size_t sqMappingSize = 0;
+	void* pCqMapping = MAP_FAILED;
+	size_t cqMappingSize = 0;
+	io_uring_sqe* pSqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	size_t sqesSize = 0;
+
+	unsigned int* pSqHead = nullptr;
+	unsigned int* pSqTail = nullptr;
+	unsigned int sqMask = 0;
+	unsigned int* pSqArray = nullptr;
+
+	unsigned int* pCqHead = nullptr;
+	unsigned int* pCqTail = nullptr;
+	unsigned int cqMask = 0;
+	io_uring_cqe* pCqes = nullptr;
+
+	unsigned int numQueued = 0;
+
+	bool Setup()
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+		if (fd < 0)
+		{
+			return false;
+		}
+
+		sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+		}
+
+		pSqMapping = mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (pSqMapping == MAP_FAILED)
+		{
+			return false;
+		}
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			pCqMapping = pSqMapping;
+		}
+		else
+		{
+			pCqMapping = mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if (pCqMapping == MAP_FAILED)
+			{
+				return false;
+			}
+		}
+
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		pSqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+		if (pSqes == MAP_FAILED)
+		{
+			return false;
+		}
+
+		unsigned char* pSq = static_cast<unsigned char*>(pSqMapping);
+		pSqHead = reinterpret_cast<unsigned int*>(pSq + params.sq_off.head);
+		pSqTail = reinterpret_cast<unsigned int*>(pSq + params.sq_off.tail);
+		sqMask = *reinterpret_cast<unsigned int*>(pSq + params.sq_off.ring_mask);
+		pSqArray = reinterpret_cast<unsigned int*>(pSq + params.sq_off.array);
+
+		unsigned char* pCq = static_cast<unsigned char*>(pCqMapping);
+		pCqHead = reinterpret_cast<unsigned int*>(pCq + params.cq_off.head);
+		pCqTail = reinterpret_cast<unsigned int*>(pCq + params.cq_off.tail);
+		cqMask = *reinterpret_cast<unsigned int*>(pCq + params.cq_off.ring_mask);
+		pCqes = reinterpret_cast<io_uring_cqe*>(pCq + params.cq_off.cqes);
+		return true;
+	}
+
+	// asks the kernel which operations it knows, a ring on an older kernel sets up fine and only fails each request
+	bool SupportsOpcodes(const unsigned char* pOpcodes, unsigned int numOpcodes)
+	{
+		const unsigned int maxOps = 256;
+		std::vector<unsigned char> probeBuffer(sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op), 0);
+		io_uring_probe* pProbe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+		if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, pProbe, maxOps) < 0)
+		{
+			return false;
+		}
+
+		for (unsigned int i = 0; i < numOpcodes; ++i)
+		{
+			if (pOpcodes[i] > pProbe->last_op || !(pProbe->ops[pOpcodes[i]].flags & IO_URING_OP_SUPPORTED))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Destroy()
+	{
+		if (pSqes != MAP_FAILED)
+		{
+			munmap(pSqes, sqesSize);
+		}
+		if (pCqMapping != MAP_FAILED && pCqMapping != pSqMapping)
+		{
+			munmap(pCqMapping, cqMappingSize);
+		}
+		if (pSqMapping != MAP_FAILED)
+		{
+			munmap(pSqMapping, sqMappingSize);
+		}
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+
+	// fills in the next submission queue entry, which the kernel only sees after Submit(). Callers hold the submit
+	// mutex, the completion thread only ever touches the completion queue.
+	io_uring_sqe* Queue(unsigned char opcode, int targetFd, unsigned long long userData)
+	{
+		const unsigned int tail = *pSqTail + numQueued;
+		if (tail - __atomic_load_n(pSqHead, __ATOMIC_ACQUIRE) > sqMask)
+		{
+			return nullptr;
+		}
+
+		const unsigned int index = tail & sqMask;
+		io_uring_sqe* pSqe = &pSqes[index];
+		memset(pSqe, 0, sizeof(*pSqe));
+		pSqe->opcode = opcode;
+		pSqe->fd = targetFd;
+		pSqe->user_data = userData;
+		pSqArray[index] = index;
+		++numQueued;
+		return pSqe;
+	}
+
+	bool Submit()
+	{
+		__atomic_store_n(pSqTail, *pSqTail + numQueued, __ATOMIC_RELEASE);
+		while (numQueued > 0)
+		{
+			const int numSubmitted = static_cast<int>(syscall(__NR_io_uring_enter, fd, numQueued, 0, 0, nullptr, 0));
+			if (numSubmitted < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				{
+					continue;
+				}
+				printf("Error. io_uring submit failed (%s)\n", strerror(errno));
+				numQueued = 0;
+				return false;
+			}
+			numQueued -= std::min(static_cast<unsigned int>(numSubmitted), numQueued);
+		}
+		return true;
+	}
+};
+#else
+struct AsyncFileReader::Ring
+{
+};
+#endif
+
+AsyncFileReader::AsyncFileReader()
+	: m_pRing(nullptr)
+	, m_waitingRequests()
+	, m_numActiveRequests(0)
+	, m_submitMutex()
+	, m_completionThread()
+	, m_bShutdown(false)
+{
+#ifdef ORCA_IO_URING
+	Ring* pRing = new Ring();
+	if (pRing->Setup() && pRing->SupportsOpcodes(REQUIRED_OPCODES, sizeof(REQUIRED_OPCODES)))
+	{
+		m_pRing = pRing;
+		m_completionThread = std::thread(&AsyncFileReader::CompletionLoop, this);
+	}
+	else
+	{
+		// seccomp filters and kernels older than 5.6 both end up here, reads just become blocking jobs
+		pRing->Destroy();
+		delete pRing;
+	}
+#endif
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+#ifdef ORCA_IO_URING
+	if (m_pRing)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_submitMutex);
+			m_bShutdown = true;
+			// wake the completion thread, it exits once the requests still in flight are done
+			if (m_pRing->Queue(IORING_OP_NOP, -1, RO_WAKE))
+			{
+				m_pRing->Submit();
+			}
+		}
+		m_completionThread.join();
+
+		m_pRing->Destroy();
+		delete m_pRing;
+	}
+#endif
+}
+
+AsyncFileReader* AsyncFileReader::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new AsyncFileReader();
+	}
+
+	return s_instance;
+}
+
+void AsyncFileReader::Read(const std::string& filename, ReadCallback callback)
+{
+	std::vector<FileRead> reads(1);
+	reads[0].filename = filename;
+	reads[0].callback = std::move(callback);
+	Read(reads);
+}
+
+void AsyncFileReader::Read(const std::vector<FileRead>& reads)
+{
+	if (!m_pRing)
+	{
+		for (const FileRead& read : reads)
+		{
+			const std::string filename = read.filename;
+			const ReadCallback callback = read.callback;
+			JobSystem::GetInstance()->Submit([filename, callback]()
+			{
+				FileContents contents;
+				if (FILE* pFile = fopen(filename.c_str(), "rb"))
+				{
+					fseek(pFile, 0, SEEK_END);
+					const long size = ftell(pFile);
+					fseek(pFile, 0, SEEK_SET);
+					if (size >= 0)
+					{
+						contents = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(size));
+						if (fread(contents->data(), 1, contents->size(), pFile) != contents->size())
+						{
+							contents.reset();
+						}
+					}
+					fclose(pFile);
+				}
+				callback(contents);
+			});
+		}
+		return;
+	}
+
+#ifdef ORCA_IO_URING
+	std::lock_guard<std::mutex> lock(m_submitMutex);
+	for (const FileRead& read : reads)
+	{
+		Request* pRequest = new Request();
+		pRequest->filename = read.filename;
+		pRequest->callback = read.callback;
+		if (m_numActiveRequests < MAX_ACTIVE_REQUESTS)
+		{
+			++m_numActiveRequests;
+			StartRequest(pRequest);
+		}
+		else
+		{
+			m_waitingRequests.push_back(pRequest);
+		}
+	}
+	// every file's operations go to the kernel together
+	m_pRing->Submit();
+#endif
+}
+
+#ifdef ORCA_IO_URING
+void AsyncFileReader::StartRequest(Request* pRequest)
+{
+	// open and stat go in together, the size is known by the time the file descriptor is
+	const unsigned long long userData = reinterpret_cast<unsigned long long>(pRequest);
+	io_uring_sqe* pOpen = m_pRing->Queue(IORING_OP_OPENAT, AT_FDCWD, userData | RO_OPEN);
+	io_uring_sqe* pStat = pOpen ? m_pRing->Queue(IORING_OP_STATX, AT_FDCWD, userData | RO_STAT) : nullptr;
+	if (!pOpen || !pStat)
+	{
+		printf("Error. io_uring submission queue is full\n");
+		m_pRing->numQueued -= pOpen ? 1 : 0;
+		pRequest->bFailed = true;
+		pRequest->numPendingOps = 0;
+		JobSystem::GetInstance()->Submit([this, pRequest]()
+		{
+			FinishRequest(pRequest, false);
+			SubmitQueued();
+		});
+		return;
+	}
+
+	pOpen->addr = reinterpret_cast<unsigned long long>(pRequest->filename.c_str());
+	pOpen->open_flags = O_RDONLY | O_CLOEXEC;
+
+	pStat->addr = reinterpret_cast<unsigned long long>(pRequest->filename.c_str());
+	pStat->len = STATX_SIZE;
+	pStat->off = reinterpret_cast<unsigned long long>(&pRequest->stat);
+
+	pRequest->numPendingOps = 2;
+}
+
+void AsyncFileReader::OnOpenComplete(Request* pRequest)
+{
+	if (pRequest->bFailed)
+	{
+		FinishRequest(pRequest, false);
+		return;
+	}
+
+	pRequest->contents = std::make_shared<std::vector<unsigned char>>(pRequest->size);
+	if (pRequest->size == 0)
+	{
+		FinishRequest(pRequest, true);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_submitMutex);
+	QueueRead(pRequest);
+}
+
+void AsyncFileReader::QueueRead(Request* pRequest)
+{
+	io_uring_sqe* pRead = m_pRing->Queue(IORING_OP_READ, pRequest->fd, reinterpret_cast<unsigned long long>(pRequest) | RO_READ);
+	if (!pRead)
+	{
+		printf("Error. io_uring submission queue is full\n");
+		JobSystem::GetInstance()->Submit([this, pRequest]()
+		{
+			FinishRequest(pRequest, false);
+			SubmitQueued();
+		});
+		return;
+	}
+
+	pRead->addr = reinterpret_cast<unsigned long long>(pRequest->contents->data() + pRequest->offset);
+	pRead->len = static_cast<unsigned int>(std::min(pRequest->size - pRequest->offset, MAX_READ_SIZE));
+	pRead->off = pRequest->offset;
+}
+
+void AsyncFileReader::SubmitQueued()
+{
+	std::lock_guard<std::mutex> lock(m_submitMutex);
+	m_pRing->Submit();
+}
+
+void AsyncFileReader::FinishRequest(Request* pRequest, bool bSuccess)
+{
+	if (pRequest->fd >= 0)
+	{
+		close(pRequest->fd);
+	}
+	if (!bSuccess)
+	{
+		pRequest->contents.reset();
+	}
+
+	ReadCallback callback = std::move(pRequest->callback);
+	FileContents contents = std::move(pRequest->contents);
+	JobSystem::GetInstance()->Submit([callback, contents]() { callback(contents); });
+	delete pRequest;
+
+	std::lock_guard<std::mutex> lock(m_submitMutex);
+	--m_numActiveRequests;
+	if (!m_waitingRequests.empty())
+	{
+		Request* pNext = m_waitingRequests.front();
+		m_waitingRequests.pop_front();
+		++m_numActiveRequests;
+		StartRequest(pNext);
+	}
+}
+
+void AsyncFileReader::CompletionLoop()
+{
+	for (;;)
+	{
+		if (syscall(__NR_io_uring_enter, m_pRing->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+		{
+			printf("Error. io_uring wait failed (%s)\n", strerror(errno));
+			return;
+		}
+
+		unsigned int head = *m_pRing->pCqHead;
+		const unsigned int tail = __atomic_load_n(m_pRing->pCqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head)
+		{
+			const io_uring_cqe& cqe = m_pRing->pCqes[head & m_pRing->cqMask];
+			const unsigned long long userData = cqe.user_data;
+			const int result = cqe.res;
+			// hand the slot back before handling it, the handlers may queue more work
+			__atomic_store_n(m_pRing->pCqHead, head + 1, __ATOMIC_RELEASE);
+
+			Request* pRequest = reinterpret_cast<Request*>(userData & ~RING_OPERATION_MASK);
+			switch (userData & RING_OPERATION_MASK)
+			{
+			case RO_OPEN:
+				if (result >= 0)
+				{
+					pRequest->fd = result;
+				}
+				else
+				{
+					pRequest->bFailed = true;
+				}
+				if (--pRequest->numPendingOps == 0)
+				{
+					OnOpenComplete(pRequest);
+				}
+				break;
+			case RO_STAT:
+				if (result >= 0)
+				{
+					pRequest->size = static_cast<size_t>(pRequest->stat.stx_size);
+				}
+				else
+				{
+					pRequest->bFailed = true;
+				}
+				if (--pRequest->numPendingOps == 0)
+				{
+					OnOpenComplete(pRequest);
+				}
+				break;
+			case RO_READ:
+				if (result == -EINTR || result == -EAGAIN)
+				{
+					std::lock_guard<std::mutex> lock(m_submitMutex);
+					QueueRead(pRequest);
+				}
+				else if (result <= 0)
+				{
+					// zero means the file shrank since the stat
+					FinishRequest(pRequest, false);
+				}
+				else
+				{
+					pRequest->offset += static_cast<size_t>(result);
+					if (pRequest->offset < pRequest->size)
+					{
+						std::lock_guard<std::mutex> lock(m_submitMutex);
+						QueueRead(pRequest);
+					}
+					else
+					{
+						FinishRequest(pRequest, true);
+					}
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		// whatever the handlers queued, reads and newly started requests alike, goes to the kernel in one call
+		std::lock_guard<std::mutex> lock(m_submitMutex);
+		m_pRing->Submit();
+		if (m_bShutdown && m_numActiveRequests == 0)
+		{
+			return;
+		}
+	}
+}
+#endif
\ No newline at end of file
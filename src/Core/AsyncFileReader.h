@@ -0,0 +1,70 @@
+#ifndef ASYNC_FILE_READER_H
+#define ASYNC_FILE_READER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::shared_ptr<std::vector<unsigned char>> FileContents;
+
+// Reads whole loose files in the background and hands their contents to the job system. On Linux the open, stat
+// and read of every file are batched through io_uring, so any number of reads are in flight at once without
+// tying up a thread each. Elsewhere, or on kernels without io_uring's 5.6 file operations, each read is a blocking
+// job instead.
+class AsyncFileReader
+{
+public:
+	// runs on a job system thread, with null contents if the file couldn't be read
+	typedef std::function<void(FileContents contents)> ReadCallback;
+
+	struct FileRead
+	{
+		std::string filename;
+		ReadCallback callback;
+	};
+
+	~AsyncFileReader();
+
+	static AsyncFileReader* GetInstance();
+
+	void Read(const std::string& filename, ReadCallback callback);
+	// starts every read in the list with a single submission
+	void Read(const std::vector<FileRead>& reads);
+
+	bool IsUsingIoUring() const { return m_pRing != nullptr; }
+
+private:
+	struct Request;
+	struct Ring;
+
+	AsyncFileReader();
+
+	// StartRequest and QueueRead expect the submit mutex to be held and only queue, their callers submit once
+	// they've queued everything they have
+	void StartRequest(Request* pRequest);
+	void QueueRead(Request* pRequest);
+	void SubmitQueued();
+	void OnOpenComplete(Request* pRequest);
+	// may start a waiting request, which is only queued
+	void FinishRequest(Request* pRequest, bool bSuccess);
+	void CompletionLoop();
+
+	// null when io_uring isn't available
+	Ring* m_pRing;
+
+	// requests waiting for a slot, which keeps the completion queue from overflowing
+	std::deque<Request*> m_waitingRequests;
+	unsigned int m_numActiveRequests;
+	std::mutex m_submitMutex;
+
+	std::thread m_completionThread;
+	bool m_bShutdown;
+
+	static AsyncFileReader* s_instance;
+};
+
+#endif
\ No newline at end of file
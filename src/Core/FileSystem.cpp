@@ -0,0 +1,251 @@
+#include "FileSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+
+#include "JobSystem.h"
+
+File::File()
+	: m_mapping()
+	, m_buffer()
+	, m_view()
+	, m_bOpen(false)
+{
+}
+
+File::~File()
+{
+	Close();
+}
+
+void File::Close()
+{
+	m_mapping.Close();
+	m_buffer.reset();
+	m_view = FileView();
+	m_bOpen = false;
+}
+
+FileSystem* FileSystem::s_instance = nullptr;
+
+FileSystem::FileSystem()
+	: m_archives()
+	, m_prefetchedFiles()
+	, m_prefetchMutex()
+{
+}
+
+FileSystem::~FileSystem()
+{
+}
+
+FileSystem* FileSystem::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new FileSystem();
+	}
+
+	return s_instance;
+}
+
+bool FileSystem::Mount(const std::string& archiveFilename)
+{
+	std::unique_ptr<PakArchive> pArchive(new PakArchive());
+	if (!pArchive->Open(archiveFilename))
+	{
+		return false;
+	}
+
+	printf("Mounted \"%s\" with %u files\n", archiveFilename.c_str(), pArchive->GetNumEntries());
+	m_archives.push_back(std::move(pArchive));
+	return true;
+}
+
+bool FileSystem::Open(const std::string& filename, File& outFile) const
+{
+	outFile.Close();
+
+	const PakArchive* pArchive = nullptr;
+	const PakEntry* pEntry = FindEntry(filename, &pArchive);
+	if (!pEntry)
+	{
+		outFile.m_buffer = FindPrefetched(filename);
+		if (outFile.m_buffer)
+		{
+			outFile.m_view.pData = outFile.m_buffer->data();
+			outFile.m_view.size = outFile.m_buffer->size();
+			outFile.m_bOpen = true;
+			return true;
+		}
+
+		if (!outFile.m_mapping.Open(filename))
+		{
+			return false;
+		}
+
+		outFile.m_view.pData = outFile.m_mapping.GetData();
+		outFile.m_view.size = outFile.m_mapping.GetSize();
+		outFile.m_bOpen = true;
+		return true;
+	}
+
+	const unsigned char* pStoredData = pArchive->GetEntryData(*pEntry);
+	if (pEntry->compression == PC_NONE)
+	{
+		outFile.m_view.pData = pStoredData;
+		outFile.m_view.size = static_cast<size_t>(pEntry->size);
+		outFile.m_bOpen = true;
+		return true;
+	}
+
+	outFile.m_buffer = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(pEntry->uncompressedSize));
+	if (!DecompressPakEntry(*pEntry, pStoredData, outFile.m_buffer->data()))
+	{
+		printf("Failed to decompress \"%s\" from \"%s\"\n", filename.c_str(), pArchive->GetFilename().c_str());
+		outFile.Close();
+		return false;
+	}
+
+	outFile.m_view.pData = outFile.m_buffer->data();
+	outFile.m_view.size = outFile.m_buffer->size();
+	outFile.m_bOpen = true;
+	return true;
+}
+
+bool FileSystem::Exists(const std::string& filename) const
+{
+	std::error_code error;
+	return FindEntry(filename, nullptr) || FindPrefetched(filename) || std::filesystem::is_regular_file(filename, error);
+}
+
+bool FileSystem::GetFileHash(const std::string& filename, hash_t& outHash) const
+{
+	const PakEntry* pEntry = FindEntry(filename, nullptr);
+	if (pEntry)
+	{
+		outHash = pEntry->contentHash;
+		return true;
+	}
+
+	const FileContents contents = FindPrefetched(filename);
+	if (contents)
+	{
+		outHash = HashBytes(contents->data(), contents->size());
+		return true;
+	}
+
+	return HashFile(filename, outHash);
+}
+
+void FileSystem::Prefetch(const std::vector<std::string>& filenames, std::function<void()> onReady)
+{
+	struct PrefetchBatch
+	{
+		std::atomic<unsigned int> numPending;
+		std::function<void()> onReady;
+		// files that made it into m_prefetchedFiles, guarded by m_prefetchMutex
+		std::vector<std::string> names;
+	};
+
+	auto pBatch = std::make_shared<PrefetchBatch>();
+	pBatch->numPending = 1;
+	pBatch->onReady = std::move(onReady);
+
+	// the extra count held during the loop keeps onReady from running before every read has been started
+	auto complete = [this, pBatch]()
+	{
+		if (--pBatch->numPending == 0)
+		{
+			pBatch->onReady();
+			ReleasePrefetched(pBatch->names);
+		}
+	};
+
+	std::vector<AsyncFileReader::FileRead> reads;
+	for (const std::string& filename : filenames)
+	{
+		const PakArchive* pArchive = nullptr;
+		const PakEntry* pEntry = FindEntry(filename, &pArchive);
+		if (pEntry)
+		{
+			pArchive->PrefetchEntry(*pEntry);
+			continue;
+		}
+
+		++pBatch->numPending;
+		const std::string name = NormalizePakPath(filename);
+		AsyncFileReader::FileRead read;
+		read.filename = filename;
+		read.callback = [this, pBatch, name, complete](FileContents contents)
+		{
+			if (contents)
+			{
+				std::lock_guard<std::mutex> lock(m_prefetchMutex);
+				PrefetchedFile& file = m_prefetchedFiles[name];
+				file.contents = contents;
+				++file.refCount;
+				pBatch->names.push_back(name);
+			}
+			complete();
+		};
+		reads.push_back(std::move(read));
+	}
+	if (!reads.empty())
+	{
+		AsyncFileReader::GetInstance()->Read(reads);
+	}
+
+	// drop the loop's count from a job, so onReady never runs on the calling thread even if nothing was read
+	JobSystem::GetInstance()->Submit(complete);
+}
+
+const PakEntry* FileSystem::FindEntry(const std::string& filename, const PakArchive** ppOutArchive) const
+{
+	if (m_archives.empty())
+	{
+		return nullptr;
+	}
+
+	const std::string name = NormalizePakPath(filename);
+	for (auto it = m_archives.rbegin(); it != m_archives.rend(); ++it)
+	{
+		const PakEntry* pEntry = (*it)->Find(name);
+		if (pEntry)
+		{
+			if (ppOutArchive)
+			{
+				*ppOutArchive = it->get();
+			}
+			return pEntry;
+		}
+	}
+
+	return nullptr;
+}
+
+FileContents FileSystem::FindPrefetched(const std::string& filename) const
+{
+	std::lock_guard<std::mutex> lock(m_prefetchMutex);
+	if (m_prefetchedFiles.empty())
+	{
+		return nullptr;
+	}
+
+	auto it = m_prefetchedFiles.find(NormalizePakPath(filename));
+	return it != m_prefetchedFiles.end() ? it->second.contents : nullptr;
+}
+
+void FileSystem::ReleasePrefetched(const std::vector<std::string>& names)
+{
+	std::lock_guard<std::mutex> lock(m_prefetchMutex);
+	for (const std::string& name : names)
+	{
+		auto it = m_prefetchedFiles.find(name);
+		if (it != m_prefetchedFiles.end() && --it->second.refCount == 0)
+		{
+			m_prefetchedFiles.erase(it);
+		}
+	}
+}
\ No newline at end of file
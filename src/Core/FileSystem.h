@@ -0,0 +1,101 @@
+#ifndef FILE_SYSTEM_H
+#define FILE_SYSTEM_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AsyncFileReader.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "PakFile.h"
+
+// zero-copy view of a file's contents
+struct FileView
+{
+	const unsigned char* pData = nullptr;
+	size_t size = 0;
+
+	const unsigned char* begin() const { return pData; }
+	const unsigned char* end() const { return pData + size; }
+	bool empty() const { return size == 0; }
+};
+
+// An open file from FileSystem. Its contents point into a mounted archive, a mapping of a loose file or a buffer
+// (decompressed or prefetched) shared with the file, and stay valid until Close() or destruction.
+class File
+{
+	friend class FileSystem;
+
+public:
+	File();
+	~File();
+
+	File(const File&) = delete;
+	File& operator=(const File&) = delete;
+
+	void Close();
+
+	bool IsOpen() const { return m_bOpen; }
+	const unsigned char* GetData() const { return m_view.pData; }
+	size_t GetSize() const { return m_view.size; }
+	const FileView& GetView() const { return m_view; }
+
+private:
+	MappedFile m_mapping;
+	FileContents m_buffer;
+	FileView m_view;
+	bool m_bOpen;
+};
+
+// Every asset read goes through here. Files are looked up in the mounted .opak archives first, most recently
+// mounted first, then on disk. Archive lookups don't touch the OS at all, and uncompressed entries are used
+// straight from the archive's mapping.
+class FileSystem
+{
+public:
+	~FileSystem();
+
+	static FileSystem* GetInstance();
+
+	// mount archives before any loads are in flight, the lookups themselves take no locks
+	bool Mount(const std::string& archiveFilename);
+
+	bool Open(const std::string& filename, File& outFile) const;
+	bool Exists(const std::string& filename) const;
+
+	// hash of the file's contents, as HashFile would compute it. Free for archive entries, which store it.
+	bool GetFileHash(const std::string& filename, hash_t& outHash) const;
+
+	// Starts reading every file in the list in the background and runs onReady on a job system thread once they're
+	// all in memory. Until onReady returns, opening those files is served from memory. Loose files are read with
+	// AsyncFileReader, archive entries are only hinted to the OS since they're already mapped. Missing files are
+	// skipped, opening them fails as usual.
+	void Prefetch(const std::vector<std::string>& filenames, std::function<void()> onReady);
+
+private:
+	struct PrefetchedFile
+	{
+		FileContents contents;
+		unsigned int refCount = 0;
+	};
+
+	FileSystem();
+
+	const PakEntry* FindEntry(const std::string& filename, const PakArchive** ppOutArchive) const;
+	FileContents FindPrefetched(const std::string& filename) const;
+	void ReleasePrefetched(const std::vector<std::string>& names);
+
+	std::vector<std::unique_ptr<PakArchive>> m_archives;
+
+	// keyed by NormalizePakPath
+	std::unordered_map<std::string, PrefetchedFile> m_prefetchedFiles;
+	mutable std::mutex m_prefetchMutex;
+
+	static FileSystem* s_instance;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include "Hash.h"
+
+#include "MappedFile.h"
+
+bool HashFile(const std::string& filename, hash_t& outHash)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		return false;
+	}
+
+	outHash = HashBytes(file.GetData(), file.GetSize());
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+typedef uint64_t hash_t;
+
+const hash_t HASH_SEED = 14695981039346656037ull;
+
+// 64-bit FNV-1a. Not cryptographic, only used to detect content changes
+inline hash_t HashBytes(const void* pData, size_t size, hash_t seed = HASH_SEED)
+{
+	const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+	hash_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline hash_t HashString(const std::string& str, hash_t seed = HASH_SEED)
+{
+	return HashBytes(str.data(), str.size(), seed);
+}
+
+// same as HashString, but usable at compile time so names known up front cost nothing to look up
+constexpr hash_t HashLiteral(const char* pStr, hash_t seed = HASH_SEED)
+{
+	hash_t hash = seed;
+	for (; *pStr != '\0'; ++pStr)
+	{
+		hash ^= static_cast<unsigned char>(*pStr);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool HashFile(const std::string& filename, hash_t& outHash);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+JobSystem* JobSystem::s_instance = nullptr;
+
+JobSystem::JobSystem()
+	: m_workers()
+	, m_jobs()
+	, m_numActiveJobs(0)
+	, m_bShutdown(false)
+{
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	unsigned int numWorkers = numThreads > 1 ? numThreads - 1 : 1;
+
+	m_workers.reserve(numWorkers);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+JobSystem* JobSystem::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new JobSystem();
+	}
+
+	return s_instance;
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+void JobSystem::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// shared with the helper jobs, which may only get to run after this call has returned
+	struct ParallelForState
+	{
+		std::atomic<unsigned int> nextIndex;
+		std::atomic<unsigned int> numCompleted;
+		std::mutex mutex;
+		std::condition_variable completed;
+		std::function<void(unsigned int)> func;
+		unsigned int count;
+	};
+
+	auto pState = std::make_shared<ParallelForState>();
+	pState->nextIndex = 0;
+	pState->numCompleted = 0;
+	pState->func = func;
+	pState->count = count;
+
+	auto RunItems = [](ParallelForState& state)
+	{
+		for (unsigned int i = state.nextIndex++; i < state.count; i = state.nextIndex++)
+		{
+			state.func(i);
+			if (++state.numCompleted == state.count)
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.completed.notify_all();
+			}
+		}
+	};
+
+	unsigned int numHelpers = std::min(count - 1, GetNumWorkers());
+	for (unsigned int i = 0; i < numHelpers; ++i)
+	{
+		Submit([pState, RunItems]() { RunItems(*pState); });
+	}
+
+	RunItems(*pState);
+
+	std::unique_lock<std::mutex> lock(pState->mutex);
+	pState->completed.wait(lock, [&pState]() { return pState->numCompleted == pState->count; });
+}
+
+void JobSystem::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_jobs.empty() && m_numActiveJobs == 0; });
+}
+
+void JobSystem::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this]() { return m_bShutdown || !m_jobs.empty(); });
+			if (m_bShutdown && m_jobs.empty())
+			{
+				return;
+			}
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			++m_numActiveJobs;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_numActiveJobs;
+			if (m_jobs.empty() && m_numActiveJobs == 0)
+			{
+				m_idle.notify_all();
+			}
+		}
+	}
+}
\ No newline at end of file
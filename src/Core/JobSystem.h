@@ -0,0 +1,47 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads (one per hardware thread, minus the caller) pulling from a single FIFO queue.
+class JobSystem
+{
+public:
+	~JobSystem();
+
+	static JobSystem* GetInstance();
+
+	// queue a job to run on a worker thread
+	void Submit(std::function<void()> job);
+
+	// runs func(i) for every i in [0, count) spread across the workers and the calling thread, and returns once all
+	// of them have completed. Safe to call from inside a job, since the caller always keeps pulling work itself.
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func);
+
+	// blocks until the queue is empty and no job is running
+	void WaitIdle();
+
+	unsigned int GetNumWorkers() const { return static_cast<unsigned int>(m_workers.size()); }
+
+private:
+	JobSystem();
+
+	void WorkerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+	unsigned int m_numActiveJobs;
+	bool m_bShutdown;
+
+	static JobSystem* s_instance;
+};
+
+#endif
\ No newline at end of file
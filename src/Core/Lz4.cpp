@@ -0,0 +1,209 @@
+#include "Lz4.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const size_t MIN_MATCH = 4;
+	// the last match has to start at least this far from the end of the input...
+	const size_t MF_LIMIT = 12;
+	// ...and the last bytes are always literals
+	const size_t LAST_LITERALS = 5;
+	const size_t MAX_OFFSET = 65535;
+	const unsigned int HASH_LOG = 16;
+
+	uint32_t Read32(const unsigned char* pData)
+	{
+		uint32_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	uint32_t HashSequence(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_LOG);
+	}
+
+	// lengths of 15 and over spill into extra bytes of 255 each, terminated by one below 255
+	unsigned char* WriteLength(unsigned char* pDst, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			*pDst++ = 255;
+		}
+		*pDst++ = static_cast<unsigned char>(length);
+		return pDst;
+	}
+
+	bool ReadLength(const unsigned char*& pSrc, const unsigned char* pSrcEnd, size_t& length)
+	{
+		unsigned char value;
+		do
+		{
+			if (pSrc >= pSrcEnd)
+			{
+				return false;
+			}
+			value = *pSrc++;
+			length += value;
+		} while (value == 255);
+		return true;
+	}
+
+	// token, literals and (unless it's the last sequence) the match offset and length. Returns null if it doesn't fit.
+	unsigned char* WriteSequence(unsigned char* pDst, unsigned char* pDstEnd, const unsigned char* pLiterals, size_t numLiterals, size_t offset, size_t matchLength)
+	{
+		// worst case size, including the extra length bytes
+		if (static_cast<size_t>(pDstEnd - pDst) < 1 + numLiterals + numLiterals / 255 + 1 + 2 + matchLength / 255 + 1)
+		{
+			return nullptr;
+		}
+
+		unsigned char* pToken = pDst++;
+		*pToken = static_cast<unsigned char>(numLiterals >= 15 ? 15 << 4 : numLiterals << 4);
+		if (numLiterals >= 15)
+		{
+			pDst = WriteLength(pDst, numLiterals - 15);
+		}
+		memcpy(pDst, pLiterals, numLiterals);
+		pDst += numLiterals;
+
+		if (matchLength == 0)
+		{
+			return pDst;
+		}
+
+		*pDst++ = static_cast<unsigned char>(offset & 0xFF);
+		*pDst++ = static_cast<unsigned char>(offset >> 8);
+		const size_t extraLength = matchLength - MIN_MATCH;
+		*pToken |= static_cast<unsigned char>(extraLength >= 15 ? 15 : extraLength);
+		if (extraLength >= 15)
+		{
+			pDst = WriteLength(pDst, extraLength - 15);
+		}
+		return pDst;
+	}
+}
+
+size_t Lz4CompressBound(size_t srcSize)
+{
+	return srcSize + srcSize / 255 + 16;
+}
+
+size_t Lz4Compress(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstCapacity)
+{
+	unsigned char* pOut = pDst;
+	unsigned char* pOutEnd = pDst + dstCapacity;
+	size_t anchor = 0;
+
+	if (srcSize > MF_LIMIT)
+	{
+		// most recent position + 1 of each hashed 4 byte sequence, 0 meaning none yet
+		std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_LOG, 0);
+		const size_t matchLimit = srcSize - LAST_LITERALS;
+		const size_t searchLimit = srcSize - MF_LIMIT;
+
+		size_t pos = 0;
+		while (pos < searchLimit)
+		{
+			const uint32_t sequence = Read32(pSrc + pos);
+			const uint32_t hash = HashSequence(sequence);
+			const size_t candidate = table[hash];
+			table[hash] = static_cast<uint32_t>(pos + 1);
+
+			if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || Read32(pSrc + candidate - 1) != sequence)
+			{
+				++pos;
+				continue;
+			}
+
+			const size_t matchPos = candidate - 1;
+			size_t matchLength = MIN_MATCH;
+			while (pos + matchLength < matchLimit && pSrc[matchPos + matchLength] == pSrc[pos + matchLength])
+			{
+				++matchLength;
+			}
+
+			pOut = WriteSequence(pOut, pOutEnd, pSrc + anchor, pos - anchor, pos - matchPos, matchLength);
+			if (!pOut)
+			{
+				return 0;
+			}
+
+			pos += matchLength;
+			anchor = pos;
+		}
+	}
+
+	pOut = WriteSequence(pOut, pOutEnd, pSrc + anchor, srcSize - anchor, 0, 0);
+	return pOut ? static_cast<size_t>(pOut - pDst) : 0;
+}
+
+bool Lz4Decompress(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize)
+{
+	const unsigned char* pSrcEnd = pSrc + srcSize;
+	unsigned char* pOut = pDst;
+	unsigned char* pOutEnd = pDst + dstSize;
+
+	while (pSrc < pSrcEnd)
+	{
+		const unsigned char token = *pSrc++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !ReadLength(pSrc, pSrcEnd, numLiterals))
+		{
+			return false;
+		}
+		if (numLiterals > static_cast<size_t>(pSrcEnd - pSrc) || numLiterals > static_cast<size_t>(pOutEnd - pOut))
+		{
+			return false;
+		}
+		memcpy(pOut, pSrc, numLiterals);
+		pSrc += numLiterals;
+		pOut += numLiterals;
+
+		// the last sequence has no match
+		if (pSrc == pSrcEnd)
+		{
+			break;
+		}
+
+		if (pSrcEnd - pSrc < 2)
+		{
+			return false;
+		}
+		const size_t offset = pSrc[0] | (pSrc[1] << 8);
+		pSrc += 2;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(pSrc, pSrcEnd, matchLength))
+		{
+			return false;
+		}
+		matchLength += MIN_MATCH;
+
+		if (offset == 0 || offset > static_cast<size_t>(pOut - pDst) || matchLength > static_cast<size_t>(pOutEnd - pOut))
+		{
+			return false;
+		}
+
+		// the match may overlap the bytes it produces, which repeats them
+		const unsigned char* pMatch = pOut - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(pOut, pMatch, matchLength);
+			pOut += matchLength;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; ++i)
+			{
+				*pOut++ = *pMatch++;
+			}
+		}
+	}
+
+	return pOut == pOutEnd;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+
+// LZ4 block format (no frame), compatible with the reference implementation. The compressor is a simple greedy
+// one meant for offline packing, the decompressor checks every read and write against the buffer bounds.
+size_t Lz4CompressBound(size_t srcSize);
+
+// returns the compressed size, or 0 if it doesn't fit in dstCapacity
+size_t Lz4Compress(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstCapacity);
+
+// fails unless the data decompresses to exactly dstSize bytes
+bool Lz4Decompress(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize);
+
+#endif
\ No newline at end of file
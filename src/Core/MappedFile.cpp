@@ -0,0 +1,183 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_pData(nullptr)
+	, m_size(0)
+	, m_bOpen(false)
+#ifdef _WIN32
+	, m_fileHandle(INVALID_HANDLE_VALUE)
+	, m_mappingHandle(nullptr)
+#else
+	, m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	m_fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_fileHandle, &size))
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	// zero-length files can't be mapped, but they're still valid files
+	if (m_size > 0)
+	{
+		m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_mappingHandle)
+		{
+			Close();
+			return false;
+		}
+
+		m_pData = static_cast<const unsigned char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (!m_pData)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_bOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+	}
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+	}
+
+	m_pData = nullptr;
+	m_size = 0;
+	m_bOpen = false;
+	m_fileHandle = INVALID_HANDLE_VALUE;
+	m_mappingHandle = nullptr;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_size)
+	{
+		return;
+	}
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<unsigned char*>(m_pData + offset);
+	range.NumberOfBytes = std::min(size, m_size - offset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	m_fd = open(filename.c_str(), O_RDONLY);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_fd, &fileStat) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileStat.st_size);
+
+	// zero-length files can't be mapped, but they're still valid files
+	if (m_size > 0)
+	{
+		void* pMapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+		if (pMapping == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+		m_pData = static_cast<const unsigned char*>(pMapping);
+	}
+
+	m_bOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		munmap(const_cast<unsigned char*>(m_pData), m_size);
+	}
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+
+	m_pData = nullptr;
+	m_size = 0;
+	m_bOpen = false;
+	m_fd = -1;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (!m_pData || offset >= m_size)
+	{
+		return;
+	}
+
+	// madvise wants a page aligned start
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t start = offset - offset % pageSize;
+	const size_t end = offset + std::min(size, m_size - offset);
+	madvise(const_cast<unsigned char*>(m_pData + start), end - start, MADV_WILLNEED);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of an entire file. The mapping stays valid until Close() or destruction.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	// hints that the given range will be read soon, so the OS can start paging it in
+	void Prefetch(size_t offset, size_t size) const;
+
+	bool IsOpen() const { return m_bOpen; }
+	const unsigned char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+	bool m_bOpen;
+
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fd;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "PakFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "JobSystem.h"
+#include "Lz4.h"
+
+namespace
+{
+	struct PakItem
+	{
+		std::string name;
+		std::string filename;
+		hash_t nameHash;
+	};
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + PAK_ALIGNMENT - 1) & ~(PAK_ALIGNMENT - 1);
+	}
+
+	uint32_t ReadU32(const unsigned char* pData)
+	{
+		uint32_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	void AppendU32(std::vector<unsigned char>& data, uint32_t value)
+	{
+		const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&value);
+		data.insert(data.end(), pBytes, pBytes + sizeof(value));
+	}
+
+	size_t GetBlockSize(uint64_t totalSize, size_t block)
+	{
+		return static_cast<size_t>(std::min<uint64_t>(PAK_BLOCK_SIZE, totalSize - static_cast<uint64_t>(block) * PAK_BLOCK_SIZE));
+	}
+
+	// splits the data into independently compressed blocks, see the layout in PakFile.h
+	void CompressBlocks(const unsigned char* pData, size_t size, std::vector<unsigned char>& outData)
+	{
+		const size_t numBlocks = (size + PAK_BLOCK_SIZE - 1) / PAK_BLOCK_SIZE;
+		std::vector<std::vector<unsigned char>> blocks(numBlocks);
+		JobSystem::GetInstance()->ParallelFor(static_cast<unsigned int>(numBlocks), [&](unsigned int i)
+		{
+			const unsigned char* pBlock = pData + static_cast<size_t>(i) * PAK_BLOCK_SIZE;
+			const size_t blockSize = GetBlockSize(size, i);
+			std::vector<unsigned char>& block = blocks[i];
+			block.resize(Lz4CompressBound(blockSize));
+			const size_t compressedSize = Lz4Compress(pBlock, blockSize, block.data(), block.size());
+			if (compressedSize == 0 || compressedSize >= blockSize)
+			{
+				block.assign(pBlock, pBlock + blockSize);
+			}
+			else
+			{
+				block.resize(compressedSize);
+			}
+		});
+
+		outData.clear();
+		AppendU32(outData, static_cast<uint32_t>(numBlocks));
+		for (size_t i = 0; i < numBlocks; ++i)
+		{
+			const bool bStored = blocks[i].size() == GetBlockSize(size, i);
+			AppendU32(outData, static_cast<uint32_t>(blocks[i].size()) | (bStored ? PAK_BLOCK_UNCOMPRESSED : 0));
+		}
+		for (const auto& block : blocks)
+		{
+			outData.insert(outData.end(), block.begin(), block.end());
+		}
+	}
+
+	bool WritePadded(FILE* pFile, uint64_t& position, uint64_t offset, const void* pData, size_t size)
+	{
+		static const char padding[PAK_ALIGNMENT] = {};
+
+		// the first entry's padding also reserves the space for the header and table
+		while (position < offset)
+		{
+			const size_t paddingSize = static_cast<size_t>(std::min<uint64_t>(offset - position, sizeof(padding)));
+			if (std::fwrite(padding, 1, paddingSize, pFile) != paddingSize)
+			{
+				return false;
+			}
+			position += paddingSize;
+		}
+
+		if (std::fwrite(pData, 1, size, pFile) != size)
+		{
+			return false;
+		}
+
+		position = offset + size;
+		return true;
+	}
+}
+
+std::string NormalizePakPath(const std::string& path)
+{
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", start);
+		end = end == std::string::npos ? path.size() : end;
+
+		std::string part = path.substr(start, end - start);
+		if (part == "..")
+		{
+			if (!parts.empty() && parts.back() != "..")
+			{
+				parts.pop_back();
+			}
+			else
+			{
+				parts.push_back(part);
+			}
+		}
+		else if (!part.empty() && part != ".")
+		{
+			parts.push_back(part);
+		}
+
+		start = end + 1;
+	}
+
+	std::string normalized;
+	for (const auto& part : parts)
+	{
+		normalized += normalized.empty() ? part : "/" + part;
+	}
+	return normalized;
+}
+
+bool WritePak(const std::string& filename, const std::vector<PakSourceFile>& files, bool bCompress)
+{
+	std::vector<PakItem> items;
+	items.reserve(files.size());
+	for (const auto& file : files)
+	{
+		const std::string name = NormalizePakPath(file.name);
+		items.push_back({ name, file.filename, HashString(name) });
+	}
+
+	std::sort(items.begin(), items.end(), [](const PakItem& a, const PakItem& b) { return a.nameHash != b.nameHash ? a.nameHash < b.nameHash : a.name < b.name; });
+	auto duplicate = std::adjacent_find(items.begin(), items.end(), [](const PakItem& a, const PakItem& b) { return a.name == b.name; });
+	if (duplicate != items.end())
+	{
+		printf("Failed to write archive \"%s\", \"%s\" was added twice\n", filename.c_str(), duplicate->name.c_str());
+		return false;
+	}
+
+	std::vector<PakEntry> entries(items.size());
+	std::vector<char> names;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		entries[i].nameHash = items[i].nameHash;
+		entries[i].nameOffset = static_cast<uint32_t>(names.size());
+		entries[i].nameLength = static_cast<uint32_t>(items[i].name.size());
+		names.insert(names.end(), items[i].name.begin(), items[i].name.end());
+	}
+
+	PakHeader header = {};
+	header.magic = PAK_MAGIC;
+	header.version = PAK_VERSION;
+	header.numEntries = static_cast<uint32_t>(entries.size());
+	header.namesSize = static_cast<uint32_t>(names.size());
+	header.entriesOffset = sizeof(PakHeader);
+	header.namesOffset = header.entriesOffset + entries.size() * sizeof(PakEntry);
+
+	// write to a temporary file first so an interrupted pack never leaves a truncated archive behind
+	const std::string tempFilename = filename + ".tmp";
+	FILE* pFile = fopen(tempFilename.c_str(), "wb");
+	if (!pFile)
+	{
+		printf("Failed to open archive \"%s\" for writing\n", tempFilename.c_str());
+		return false;
+	}
+
+	// the entry data goes first, the header and table are filled in once every entry's location is known
+	uint64_t position = 0;
+	uint64_t offset = header.namesOffset + names.size();
+	bool bSuccess = true;
+	std::vector<unsigned char> compressed;
+	for (size_t i = 0; i < items.size() && bSuccess; ++i)
+	{
+		MappedFile source;
+		if (!source.Open(items[i].filename))
+		{
+			printf("Failed to read \"%s\"\n", items[i].filename.c_str());
+			bSuccess = false;
+			break;
+		}
+
+		PakEntry& entry = entries[i];
+		entry.contentHash = HashBytes(source.GetData(), source.GetSize());
+		entry.uncompressedSize = source.GetSize();
+		entry.compression = PC_NONE;
+
+		const unsigned char* pData = source.GetData();
+		size_t size = source.GetSize();
+		if (bCompress && size > 0)
+		{
+			CompressBlocks(source.GetData(), source.GetSize(), compressed);
+			if (compressed.size() <= size - size / 8)
+			{
+				entry.compression = PC_LZ4;
+				pData = compressed.data();
+				size = compressed.size();
+			}
+		}
+
+		offset = AlignOffset(offset);
+		entry.offset = offset;
+		entry.size = size;
+		bSuccess = WritePadded(pFile, position, offset, pData, size);
+		offset += size;
+	}
+
+	bSuccess = bSuccess
+		&& std::fseek(pFile, 0, SEEK_SET) == 0
+		&& std::fwrite(&header, sizeof(header), 1, pFile) == 1
+		&& std::fwrite(entries.data(), sizeof(PakEntry), entries.size(), pFile) == entries.size()
+		&& std::fwrite(names.data(), 1, names.size(), pFile) == names.size();
+	bSuccess = (std::fclose(pFile) == 0) && bSuccess;
+
+	if (bSuccess)
+	{
+		std::remove(filename.c_str());
+		bSuccess = std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+	}
+
+	if (!bSuccess)
+	{
+		printf("Failed to write archive \"%s\"\n", filename.c_str());
+		std::remove(tempFilename.c_str());
+	}
+	return bSuccess;
+}
+
+bool DecompressPakEntry(const PakEntry& entry, const unsigned char* pStoredData, unsigned char* pDst)
+{
+	if (entry.size < sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	const uint32_t numBlocks = ReadU32(pStoredData);
+	const uint64_t tableSize = sizeof(uint32_t) * (static_cast<uint64_t>(numBlocks) + 1);
+	if (numBlocks != (entry.uncompressedSize + PAK_BLOCK_SIZE - 1) / PAK_BLOCK_SIZE || tableSize > entry.size)
+	{
+		return false;
+	}
+
+	// blocks are stored back to back after the table
+	std::vector<uint64_t> blockOffsets(numBlocks + 1);
+	blockOffsets[0] = tableSize;
+	for (uint32_t i = 0; i < numBlocks; ++i)
+	{
+		blockOffsets[i + 1] = blockOffsets[i] + (ReadU32(pStoredData + sizeof(uint32_t) * (i + 1)) & ~PAK_BLOCK_UNCOMPRESSED);
+	}
+	if (blockOffsets[numBlocks] > entry.size)
+	{
+		return false;
+	}
+
+	std::atomic<bool> bSuccess(true);
+	JobSystem::GetInstance()->ParallelFor(numBlocks, [&](unsigned int i)
+	{
+		const unsigned char* pBlock = pStoredData + blockOffsets[i];
+		const size_t storedSize = static_cast<size_t>(blockOffsets[i + 1] - blockOffsets[i]);
+		const size_t blockSize = GetBlockSize(entry.uncompressedSize, i);
+		unsigned char* pBlockDst = pDst + static_cast<size_t>(i) * PAK_BLOCK_SIZE;
+
+		if (ReadU32(pStoredData + sizeof(uint32_t) * (i + 1)) & PAK_BLOCK_UNCOMPRESSED)
+		{
+			if (storedSize != blockSize)
+			{
+				bSuccess = false;
+				return;
+			}
+			memcpy(pBlockDst, pBlock, blockSize);
+		}
+		else if (!Lz4Decompress(pBlock, storedSize, pBlockDst, blockSize))
+		{
+			bSuccess = false;
+		}
+	});
+
+	return bSuccess;
+}
+
+PakArchive::PakArchive()
+	: m_file()
+	, m_filename()
+	, m_pEntries(nullptr)
+	, m_numEntries(0)
+	, m_pNames(nullptr)
+{
+}
+
+PakArchive::~PakArchive()
+{
+	Close();
+}
+
+bool PakArchive::Open(const std::string& filename)
+{
+	Close();
+
+	if (!m_file.Open(filename))
+	{
+		printf("Failed to open archive \"%s\"\n", filename.c_str());
+		return false;
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	const PakHeader* pHeader = reinterpret_cast<const PakHeader*>(pData);
+	if (size < sizeof(PakHeader) || pHeader->magic != PAK_MAGIC || pHeader->version != PAK_VERSION)
+	{
+		printf("\"%s\" is not a supported archive\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	if (pHeader->entriesOffset % alignof(PakEntry) != 0
+		|| pHeader->entriesOffset + static_cast<uint64_t>(pHeader->numEntries) * sizeof(PakEntry) > size
+		|| pHeader->namesOffset + pHeader->namesSize > size)
+	{
+		printf("Archive \"%s\" is corrupt\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	m_pEntries = reinterpret_cast<const PakEntry*>(pData + pHeader->entriesOffset);
+	m_numEntries = pHeader->numEntries;
+	m_pNames = reinterpret_cast<const char*>(pData + pHeader->namesOffset);
+	for (unsigned int i = 0; i < m_numEntries; ++i)
+	{
+		const PakEntry& entry = m_pEntries[i];
+		if (entry.offset + entry.size > size || static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > pHeader->namesSize
+			|| (entry.compression != PC_NONE && entry.compression != PC_LZ4) || (entry.compression == PC_NONE && entry.size != entry.uncompressedSize))
+		{
+			printf("Archive \"%s\" is corrupt\n", filename.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	m_filename = filename;
+	return true;
+}
+
+void PakArchive::Close()
+{
+	m_file.Close();
+	m_filename.clear();
+	m_pEntries = nullptr;
+	m_numEntries = 0;
+	m_pNames = nullptr;
+}
+
+const PakEntry* PakArchive::Find(const std::string& name) const
+{
+	const hash_t nameHash = HashString(name);
+	const PakEntry* pEnd = m_pEntries + m_numEntries;
+	const PakEntry* pEntry = std::lower_bound(m_pEntries, pEnd, nameHash, [](const PakEntry& entry, hash_t hash) { return entry.nameHash < hash; });
+
+	// hashes can collide, so the name still has to match
+	for (; pEntry != pEnd && pEntry->nameHash == nameHash; ++pEntry)
+	{
+		if (pEntry->nameLength == name.size() && memcmp(m_pNames + pEntry->nameOffset, name.data(), name.size()) == 0)
+		{
+			return pEntry;
+		}
+	}
+	return nullptr;
+}
\ No newline at end of file
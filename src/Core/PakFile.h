@@ -0,0 +1,102 @@
+#ifndef PAK_FILE_H
+#define PAK_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+// .opak archives bundle loose asset files into one file that is mapped once at startup. Entries are looked up by
+// hashed path through a table sorted by hash, and their data starts on a page boundary so it can be used in place.
+// Entries that compress well enough are stored as independent LZ4 blocks instead, which can be decompressed in
+// parallel.
+//
+// layout: header | entries | names | entry data, each aligned to PAK_ALIGNMENT
+// compressed entry data: block count | stored size of each block | blocks
+
+const char* const PAK_EXTENSION = ".opak";
+const uint32_t PAK_MAGIC = 0x4B41504F; // "OPAK"
+const uint32_t PAK_VERSION = 2; // 2: names keep their case
+const uint64_t PAK_ALIGNMENT = 4096;
+const uint32_t PAK_BLOCK_SIZE = 256 * 1024;
+// set on a block's stored size when the block didn't compress and is stored as is
+const uint32_t PAK_BLOCK_UNCOMPRESSED = 0x80000000;
+
+enum PakCompression
+{
+	PC_NONE,
+	PC_LZ4,
+};
+
+struct PakHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numEntries;
+	uint32_t namesSize;
+	uint64_t entriesOffset;
+	uint64_t namesOffset;
+};
+
+struct PakEntry
+{
+	hash_t nameHash;
+	// hash of the uncompressed contents, the same value HashFile gives for the source file
+	hash_t contentHash;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t uncompressedSize;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t compression;
+	uint32_t reserved;
+};
+
+struct PakSourceFile
+{
+	// the path the file is looked up by at runtime
+	std::string name;
+	// where to read it from while packing
+	std::string filename;
+};
+
+// archive paths use forward slashes with . and .. resolved, but keep their case so two files that differ only in case
+// stay distinct, the same as loose files on a case sensitive file system
+std::string NormalizePakPath(const std::string& path);
+
+// packs the files into a new archive. With bCompress, files are compressed if that saves at least an eighth.
+bool WritePak(const std::string& filename, const std::vector<PakSourceFile>& files, bool bCompress);
+
+// decompresses a PC_LZ4 entry's stored data into pDst, which must hold entry.uncompressedSize bytes
+bool DecompressPakEntry(const PakEntry& entry, const unsigned char* pStoredData, unsigned char* pDst);
+
+// read-only view of a mapped archive
+class PakArchive
+{
+public:
+	PakArchive();
+	~PakArchive();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	// name has to be normalized with NormalizePakPath
+	const PakEntry* Find(const std::string& name) const;
+	// the entry's data as stored, still compressed if the entry is
+	const unsigned char* GetEntryData(const PakEntry& entry) const { return m_file.GetData() + entry.offset; }
+	void PrefetchEntry(const PakEntry& entry) const { m_file.Prefetch(static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size)); }
+
+	unsigned int GetNumEntries() const { return m_numEntries; }
+	const std::string& GetFilename() const { return m_filename; }
+
+private:
+	MappedFile m_file;
+	std::string m_filename;
+	const PakEntry* m_pEntries;
+	unsigned int m_numEntries;
+	const char* m_pNames;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "RadixSort.h"
+
+#include <cstring>
+
+void RadixSort(SortKey* pKeys, SortKey* pTemp, size_t count)
+{
+	const unsigned int NUM_PASSES = 8;
+	const unsigned int NUM_BUCKETS = 256;
+
+	if (count < 2)
+	{
+		return;
+	}
+
+	size_t histograms[NUM_PASSES][NUM_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t key = pKeys[i].key;
+		for (unsigned int pass = 0; pass < NUM_PASSES; ++pass)
+		{
+			++histograms[pass][(key >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	SortKey* pSrc = pKeys;
+	SortKey* pDst = pTemp;
+	for (unsigned int pass = 0; pass < NUM_PASSES; ++pass)
+	{
+		size_t* pHistogram = histograms[pass];
+		const unsigned int shift = pass * 8;
+
+		// every key has the same byte here, so this pass wouldn't move anything
+		if (pHistogram[(pSrc[0].key >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// turn the counts into the first output slot for each bucket
+		size_t offset = 0;
+		for (unsigned int bucket = 0; bucket < NUM_BUCKETS; ++bucket)
+		{
+			const size_t bucketCount = pHistogram[bucket];
+			pHistogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			pDst[pHistogram[(pSrc[i].key >> shift) & 0xFF]++] = pSrc[i];
+		}
+
+		SortKey* pSwap = pSrc;
+		pSrc = pDst;
+		pDst = pSwap;
+	}
+
+	if (pSrc != pKeys)
+	{
+		memcpy(pKeys, pSrc, count * sizeof(SortKey));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct SortKey
+{
+	uint64_t key;
+	// whatever the key belongs to, usually an index into the array being sorted
+	uint32_t value;
+};
+
+// Stable LSD radix sort on the 64-bit keys, one byte per pass. All histograms are built in a single read of the
+// input, and passes where every key has the same byte are skipped, so keys that only use a few of their bits sort in
+// only a few passes. pTemp needs room for count entries. The result always ends up back in pKeys.
+void RadixSort(SortKey* pKeys, SortKey* pTemp, size_t count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// SSE2 is part of every x64 target, code using it keeps a scalar path for everything else
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ORCA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif
\ No newline at end of file
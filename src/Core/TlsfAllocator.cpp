@@ -0,0 +1,378 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// index of the highest and lowest set bits, value can't be 0
+	uint32_t FindLastSet(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index = 0;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31 - __builtin_clz(value);
+#endif
+	}
+
+	uint32_t FindFirstSet(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index = 0;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+}
+
+TlsfAllocator::TlsfAllocator(uint32_t capacity)
+	: m_nodes()
+	, m_unusedNodes()
+	, m_freeLists()
+	, m_flBitmap(0)
+	, m_slBitmaps()
+	, m_lastNode(TLSF_INVALID_NODE)
+	, m_capacity(0)
+	, m_freeSize(0)
+{
+	Reset(capacity);
+}
+
+void TlsfAllocator::Reset(uint32_t capacity)
+{
+	m_nodes.clear();
+	m_unusedNodes.clear();
+	std::fill(&m_freeLists[0][0], &m_freeLists[0][0] + FL_COUNT * SL_COUNT, TLSF_INVALID_NODE);
+	m_flBitmap = 0;
+	std::fill(m_slBitmaps, m_slBitmaps + FL_COUNT, 0u);
+	m_lastNode = TLSF_INVALID_NODE;
+	m_capacity = 0;
+	m_freeSize = 0;
+
+	Grow(capacity);
+}
+
+uint32_t TlsfAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+	{
+		return TLSF_INVALID_NODE;
+	}
+
+	const uint32_t node = FindFree(size);
+	if (node == TLSF_INVALID_NODE)
+	{
+		return TLSF_INVALID_NODE;
+	}
+	return AllocateFrom(node, size);
+}
+
+uint32_t TlsfAllocator::AllocateFrom(uint32_t node, uint32_t size)
+{
+	RemoveFree(node);
+
+	// the rest goes back as a free block of its own, straight after the allocation
+	if (m_nodes[node].size > size)
+	{
+		const uint32_t remainder = CreateNode(m_nodes[node].offset + size, m_nodes[node].size - size);
+		m_nodes[remainder].prevPhysical = node;
+		m_nodes[remainder].nextPhysical = m_nodes[node].nextPhysical;
+		if (m_nodes[node].nextPhysical != TLSF_INVALID_NODE)
+		{
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = remainder;
+		}
+		else
+		{
+			m_lastNode = remainder;
+		}
+		m_nodes[node].nextPhysical = remainder;
+		m_nodes[node].size = size;
+		InsertFree(remainder);
+	}
+
+	m_nodes[node].bUsed = true;
+	m_freeSize -= size;
+	return node;
+}
+
+void TlsfAllocator::Free(uint32_t node)
+{
+	m_nodes[node].bUsed = false;
+	m_freeSize += m_nodes[node].size;
+
+	const uint32_t next = m_nodes[node].nextPhysical;
+	if (next != TLSF_INVALID_NODE && !m_nodes[next].bUsed)
+	{
+		RemoveFree(next);
+		m_nodes[node].size += m_nodes[next].size;
+		m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+		if (m_nodes[next].nextPhysical != TLSF_INVALID_NODE)
+		{
+			m_nodes[m_nodes[next].nextPhysical].prevPhysical = node;
+		}
+		else
+		{
+			m_lastNode = node;
+		}
+		ReleaseNode(next);
+	}
+
+	const uint32_t prev = m_nodes[node].prevPhysical;
+	if (prev != TLSF_INVALID_NODE && !m_nodes[prev].bUsed)
+	{
+		RemoveFree(prev);
+		m_nodes[prev].size += m_nodes[node].size;
+		m_nodes[prev].nextPhysical = m_nodes[node].nextPhysical;
+		if (m_nodes[node].nextPhysical != TLSF_INVALID_NODE)
+		{
+			m_nodes[m_nodes[node].nextPhysical].prevPhysical = prev;
+		}
+		else
+		{
+			m_lastNode = prev;
+		}
+		ReleaseNode(node);
+		InsertFree(prev);
+	}
+	else
+	{
+		InsertFree(node);
+	}
+}
+
+uint32_t TlsfAllocator::FindLowestFreeBefore(uint32_t node, uint32_t size) const
+{
+	uint32_t lowest = TLSF_INVALID_NODE;
+	for (uint32_t prev = m_nodes[node].prevPhysical; prev != TLSF_INVALID_NODE; prev = m_nodes[prev].prevPhysical)
+	{
+		if (!m_nodes[prev].bUsed && m_nodes[prev].size >= size)
+		{
+			lowest = prev;
+		}
+	}
+	return lowest;
+}
+
+void TlsfAllocator::Grow(uint32_t newCapacity)
+{
+	if (newCapacity <= m_capacity)
+	{
+		return;
+	}
+
+	const uint32_t extra = newCapacity - m_capacity;
+	if (m_lastNode != TLSF_INVALID_NODE && !m_nodes[m_lastNode].bUsed)
+	{
+		RemoveFree(m_lastNode);
+		m_nodes[m_lastNode].size += extra;
+		InsertFree(m_lastNode);
+	}
+	else
+	{
+		const uint32_t node = CreateNode(m_capacity, extra);
+		m_nodes[node].prevPhysical = m_lastNode;
+		if (m_lastNode != TLSF_INVALID_NODE)
+		{
+			m_nodes[m_lastNode].nextPhysical = node;
+		}
+		m_lastNode = node;
+		InsertFree(node);
+	}
+
+	m_capacity = newCapacity;
+	m_freeSize += extra;
+}
+
+bool TlsfAllocator::Shrink(uint32_t newCapacity)
+{
+	if (newCapacity >= m_capacity)
+	{
+		return newCapacity == m_capacity;
+	}
+	if (GetUsedEnd() > newCapacity)
+	{
+		return false;
+	}
+
+	// everything past the used end is the last block, and it's free
+	const uint32_t removed = m_capacity - newCapacity;
+	RemoveFree(m_lastNode);
+	if (m_nodes[m_lastNode].size == removed)
+	{
+		const uint32_t prev = m_nodes[m_lastNode].prevPhysical;
+		ReleaseNode(m_lastNode);
+		m_lastNode = prev;
+		if (prev != TLSF_INVALID_NODE)
+		{
+			m_nodes[prev].nextPhysical = TLSF_INVALID_NODE;
+		}
+	}
+	else
+	{
+		m_nodes[m_lastNode].size -= removed;
+		InsertFree(m_lastNode);
+	}
+
+	m_capacity = newCapacity;
+	m_freeSize -= removed;
+	return true;
+}
+
+uint32_t TlsfAllocator::GetLargestFreeSize() const
+{
+	if (m_flBitmap == 0)
+	{
+		return 0;
+	}
+
+	// the highest non-empty list holds the largest blocks, but they're only binned, not sorted
+	const uint32_t fl = FindLastSet(m_flBitmap);
+	const uint32_t sl = FindLastSet(m_slBitmaps[fl]);
+	uint32_t largest = 0;
+	for (uint32_t node = m_freeLists[fl][sl]; node != TLSF_INVALID_NODE; node = m_nodes[node].nextFree)
+	{
+		largest = std::max(largest, m_nodes[node].size);
+	}
+	return largest;
+}
+
+uint32_t TlsfAllocator::GetUsedEnd() const
+{
+	if (m_lastNode == TLSF_INVALID_NODE)
+	{
+		return 0;
+	}
+	return m_nodes[m_lastNode].bUsed ? m_capacity : m_nodes[m_lastNode].offset;
+}
+
+float TlsfAllocator::GetFragmentation() const
+{
+	if (m_freeSize == 0)
+	{
+		return 0.0f;
+	}
+	return 1.0f - static_cast<float>(GetLargestFreeSize()) / m_freeSize;
+}
+
+void TlsfAllocator::GetListIndices(uint32_t size, uint32_t& outFl, uint32_t& outSl)
+{
+	if (size < SL_COUNT)
+	{
+		outFl = 0;
+		outSl = size;
+		return;
+	}
+
+	const uint32_t topBit = FindLastSet(size);
+	outFl = topBit - SL_BITS + 1;
+	outSl = (size >> (topBit - SL_BITS)) ^ SL_COUNT;
+}
+
+uint32_t TlsfAllocator::CreateNode(uint32_t offset, uint32_t size)
+{
+	uint32_t node = 0;
+	if (!m_unusedNodes.empty())
+	{
+		node = m_unusedNodes.back();
+		m_unusedNodes.pop_back();
+	}
+	else
+	{
+		node = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	m_nodes[node] = Node{ offset, size, TLSF_INVALID_NODE, TLSF_INVALID_NODE, TLSF_INVALID_NODE, TLSF_INVALID_NODE, false };
+	return node;
+}
+
+void TlsfAllocator::ReleaseNode(uint32_t node)
+{
+	m_unusedNodes.push_back(node);
+}
+
+void TlsfAllocator::InsertFree(uint32_t node)
+{
+	const uint32_t size = m_nodes[node].size;
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	GetListIndices(size, fl, sl);
+
+	const uint32_t head = m_freeLists[fl][sl];
+	m_nodes[node].prevFree = TLSF_INVALID_NODE;
+	m_nodes[node].nextFree = head;
+	if (head != TLSF_INVALID_NODE)
+	{
+		m_nodes[head].prevFree = node;
+	}
+	m_freeLists[fl][sl] = node;
+	m_flBitmap |= 1u << fl;
+	m_slBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t node)
+{
+	const uint32_t size = m_nodes[node].size;
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	GetListIndices(size, fl, sl);
+
+	const Node& entry = m_nodes[node];
+	if (entry.prevFree != TLSF_INVALID_NODE)
+	{
+		m_nodes[entry.prevFree].nextFree = entry.nextFree;
+	}
+	else
+	{
+		m_freeLists[fl][sl] = entry.nextFree;
+		if (entry.nextFree == TLSF_INVALID_NODE)
+		{
+			m_slBitmaps[fl] &= ~(1u << sl);
+			if (m_slBitmaps[fl] == 0)
+			{
+				m_flBitmap &= ~(1u << fl);
+			}
+		}
+	}
+	if (entry.nextFree != TLSF_INVALID_NODE)
+	{
+		m_nodes[entry.nextFree].prevFree = entry.prevFree;
+	}
+}
+
+uint32_t TlsfAllocator::FindFree(uint32_t size) const
+{
+	// rounded up to the start of the next list, so any block found is big enough
+	if (size >= SL_COUNT)
+	{
+		const uint64_t rounded = static_cast<uint64_t>(size) + (1u << (FindLastSet(size) - SL_BITS)) - 1;
+		if (rounded > 0xFFFFFFFFull)
+		{
+			return TLSF_INVALID_NODE;
+		}
+		size = static_cast<uint32_t>(rounded);
+	}
+	uint32_t fl = 0;
+	uint32_t sl = 0;
+	GetListIndices(size, fl, sl);
+
+	uint32_t slMap = m_slBitmaps[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		const uint32_t flMap = fl + 1 < FL_COUNT ? m_flBitmap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0)
+		{
+			return TLSF_INVALID_NODE;
+		}
+		fl = FindFirstSet(flMap);
+		slMap = m_slBitmaps[fl];
+	}
+	return m_freeLists[fl][FindFirstSet(slMap)];
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef TLSF_ALLOCATOR_H
+#define TLSF_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t TLSF_INVALID_NODE = 0xFFFFFFFF;
+
+// Two level segregated fit allocator over a range of offsets, with no memory of its own behind them, so it can hand
+// out ranges of a GPU buffer. Free blocks are kept in lists binned by the top bit of their size and the 4 bits below
+// it, with a bitmap of which lists are non-empty, so allocating and freeing are O(1) and neighbouring free blocks are
+// merged straight away. Requests look in the first list whose blocks are all big enough rather than searching one
+// that might have a closer fit, and the block found is split so only the requested size is used.
+//
+// Allocations are identified by node, which stays the same until the allocation is freed. Sizes and offsets are in
+// whatever unit the caller uses.
+class TlsfAllocator
+{
+public:
+	explicit TlsfAllocator(uint32_t capacity = 0);
+
+	// forgets every allocation
+	void Reset(uint32_t capacity);
+
+	// TLSF_INVALID_NODE if size is 0 or there's no free block big enough
+	uint32_t Allocate(uint32_t size);
+	// allocates from the start of a particular free block, which has to be at least size
+	uint32_t AllocateFrom(uint32_t node, uint32_t size);
+	void Free(uint32_t node);
+
+	// the free block nearest the start that's at least size and before node, TLSF_INVALID_NODE if there isn't one.
+	// Walks the blocks rather than the lists, so it's for moving ranges down rather than for every allocation.
+	uint32_t FindLowestFreeBefore(uint32_t node, uint32_t size) const;
+
+	// adds free space at the end
+	void Grow(uint32_t newCapacity);
+	// takes free space off the end, fails if anything past newCapacity is allocated
+	bool Shrink(uint32_t newCapacity);
+
+	uint32_t GetOffset(uint32_t node) const { return m_nodes[node].offset; }
+	uint32_t GetSize(uint32_t node) const { return m_nodes[node].size; }
+	bool IsUsed(uint32_t node) const { return m_nodes[node].bUsed; }
+	// walks the blocks, free and used, in offset order from the end
+	uint32_t GetLastNode() const { return m_lastNode; }
+	uint32_t GetPreviousNode(uint32_t node) const { return m_nodes[node].prevPhysical; }
+	// one past the highest node index in use, for callers keeping their own data per node
+	uint32_t GetNodeCapacity() const { return static_cast<uint32_t>(m_nodes.size()); }
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetFreeSize() const { return m_freeSize; }
+	uint32_t GetUsedSize() const { return m_capacity - m_freeSize; }
+	uint32_t GetLargestFreeSize() const;
+	// end of the last used block, everything after it is free
+	uint32_t GetUsedEnd() const;
+	// 0 when all the free space is in one block, approaching 1 as it's split into more and smaller ones
+	float GetFragmentation() const;
+
+private:
+	static const uint32_t SL_BITS = 4;
+	static const uint32_t SL_COUNT = 1 << SL_BITS;
+	// sizes below SL_COUNT all go in the first level, one list each
+	static const uint32_t FL_COUNT = 32 - SL_BITS + 1;
+
+	struct Node
+	{
+		uint32_t offset;
+		uint32_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		// only for free blocks
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool bUsed;
+	};
+
+	static void GetListIndices(uint32_t size, uint32_t& outFl, uint32_t& outSl);
+
+	uint32_t CreateNode(uint32_t offset, uint32_t size);
+	void ReleaseNode(uint32_t node);
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	// the first non-empty list whose blocks are all at least size, TLSF_INVALID_NODE if there isn't one
+	uint32_t FindFree(uint32_t size) const;
+
+	std::vector<Node> m_nodes;
+	// indices into m_nodes not in use
+	std::vector<uint32_t> m_unusedNodes;
+	uint32_t m_freeLists[FL_COUNT][SL_COUNT];
+	uint32_t m_flBitmap;
+	uint32_t m_slBitmaps[FL_COUNT];
+
+	uint32_t m_lastNode;
+	uint32_t m_capacity;
+	uint32_t m_freeSize;
+};
+
+#endif
\ No newline at end of file
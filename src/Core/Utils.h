@@ -1,8 +0,0 @@
-#ifndef UTILS_H
-#define UTILS_H
-
-#include <string>
-
-void* LoadFileContents(const std::string& filename);
-
-#endif
\ No newline at end of file
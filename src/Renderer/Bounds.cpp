@@ -0,0 +1,118 @@
+#include "Bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const glm::vec3& GetPoint(const glm::vec3* pPoints, unsigned int index, size_t stride)
+	{
+		return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const unsigned char*>(pPoints) + index * stride);
+	}
+}
+
+AABB ComputeAABB(const glm::vec3* pPoints, unsigned int numPoints, size_t stride)
+{
+	AABB aabb;
+	if (numPoints == 0)
+	{
+		return aabb;
+	}
+
+	aabb.min = GetPoint(pPoints, 0, stride);
+	aabb.max = aabb.min;
+	for (unsigned int i = 1; i < numPoints; ++i)
+	{
+		const glm::vec3& point = GetPoint(pPoints, i, stride);
+		aabb.min = glm::min(aabb.min, point);
+		aabb.max = glm::max(aabb.max, point);
+	}
+	return aabb;
+}
+
+BoundingSphere ComputeBoundingSphere(const glm::vec3* pPoints, unsigned int numPoints, const AABB& aabb, size_t stride)
+{
+	BoundingSphere sphere;
+	sphere.center = aabb.GetCenter();
+
+	float maxDistanceSquared = 0.0f;
+	for (unsigned int i = 0; i < numPoints; ++i)
+	{
+		const glm::vec3 offset = GetPoint(pPoints, i, stride) - sphere.center;
+		maxDistanceSquared = std::max(maxDistanceSquared, glm::dot(offset, offset));
+	}
+	sphere.radius = std::sqrt(maxDistanceSquared);
+	return sphere;
+}
+
+AABB MergeAABB(const AABB& a, const AABB& b)
+{
+	AABB aabb;
+	aabb.min = glm::min(a.min, b.min);
+	aabb.max = glm::max(a.max, b.max);
+	return aabb;
+}
+
+BoundingSphere MergeBoundingSphere(const BoundingSphere& a, const BoundingSphere& b)
+{
+	const glm::vec3 offset = b.center - a.center;
+	const float distance = glm::length(offset);
+	if (distance + b.radius <= a.radius)
+	{
+		return a;
+	}
+	if (distance + a.radius <= b.radius)
+	{
+		return b;
+	}
+
+	// the smallest sphere touching the far side of both
+	BoundingSphere sphere;
+	sphere.radius = (distance + a.radius + b.radius) * 0.5f;
+	sphere.center = a.center + offset * ((sphere.radius - a.radius) / distance);
+	return sphere;
+}
+
+AABB TransformAABB(const AABB& aabb, const glm::mat4& transform)
+{
+	// each world axis extent is the sum of the local extents projected onto it
+	const glm::vec3 center = glm::vec3(transform * glm::vec4(aabb.GetCenter(), 1.0f));
+	const glm::mat3 absRotation(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+	const glm::vec3 extents = absRotation * aabb.GetExtents();
+
+	AABB result;
+	result.min = center - extents;
+	result.max = center + extents;
+	return result;
+}
+
+BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform)
+{
+	// non-uniform scale stretches the sphere, so it has to grow by the largest axis scale
+	const float scaleSquared = std::max(std::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])), glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1]))), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])));
+
+	BoundingSphere result;
+	result.center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+	result.radius = sphere.radius * std::sqrt(scaleSquared);
+	return result;
+}
+
+Frustum ComputeFrustum(const glm::mat4& viewProjection)
+{
+	// glm is column major, so the rows of the matrix are spread across the columns
+	const glm::mat4 rows = glm::transpose(viewProjection);
+
+	Frustum frustum;
+	frustum.planes[FP_LEFT] = rows[3] + rows[0];
+	frustum.planes[FP_RIGHT] = rows[3] - rows[0];
+	frustum.planes[FP_BOTTOM] = rows[3] + rows[1];
+	frustum.planes[FP_TOP] = rows[3] - rows[1];
+	frustum.planes[FP_NEAR] = rows[3] + rows[2];
+	frustum.planes[FP_FAR] = rows[3] - rows[2];
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+
+	glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+	glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+enum FrustumPlane
+{
+	FP_LEFT,
+	FP_RIGHT,
+	FP_BOTTOM,
+	FP_TOP,
+	FP_NEAR,
+	FP_FAR,
+	FP_COUNT,
+};
+
+// planes as (normal, distance) with the normals pointing inwards, so a point is inside when dot(n, p) + d >= 0
+struct Frustum
+{
+	glm::vec4 planes[FP_COUNT];
+};
+
+AABB ComputeAABB(const glm::vec3* pPoints, unsigned int numPoints, size_t stride = sizeof(glm::vec3));
+// centred on the box, with the radius reaching the furthest point rather than the box corners
+BoundingSphere ComputeBoundingSphere(const glm::vec3* pPoints, unsigned int numPoints, const AABB& aabb, size_t stride = sizeof(glm::vec3));
+
+AABB MergeAABB(const AABB& a, const AABB& b);
+BoundingSphere MergeBoundingSphere(const BoundingSphere& a, const BoundingSphere& b);
+
+// bounds of the transformed box or sphere, which for a box is looser than the box of the transformed contents
+AABB TransformAABB(const AABB& aabb, const glm::mat4& transform);
+BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& transform);
+
+// extracts normalised planes from a GL style (-w..w clip space depth) view projection matrix
+Frustum ComputeFrustum(const glm::mat4& viewProjection);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,739 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace
+{
+	const unsigned int NUM_BINS = 16;
+	// ranges at least this big bin across the job system, in chunks of BINNING_CHUNK_SIZE
+	const unsigned int PARALLEL_BINNING_SIZE = 64 * 1024;
+	const unsigned int BINNING_CHUNK_SIZE = 16 * 1024;
+	// ranges at least this big build their two halves as separate jobs
+	const unsigned int PARALLEL_SUBTREE_SIZE = 4 * 1024;
+	// cost of visiting a node relative to testing a primitive
+	const float TRAVERSAL_COST = 1.0f;
+	const float INTERSECTION_COST = 1.0f;
+
+	AABB GetEmptyAABB()
+	{
+		AABB aabb;
+		aabb.min = glm::vec3(FLT_MAX);
+		aabb.max = glm::vec3(-FLT_MAX);
+		return aabb;
+	}
+
+	void GrowAABB(AABB& aabb, const AABB& other)
+	{
+		aabb.min = glm::min(aabb.min, other.min);
+		aabb.max = glm::max(aabb.max, other.max);
+	}
+
+	void GrowAABB(AABB& aabb, const glm::vec3& point)
+	{
+		aabb.min = glm::min(aabb.min, point);
+		aabb.max = glm::max(aabb.max, point);
+	}
+
+	float GetSurfaceArea(const AABB& aabb)
+	{
+		const glm::vec3 size = glm::max(aabb.max - aabb.min, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	bool Overlaps(const AABB& a, const AABB& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool IsOutside(const Frustum& frustum, const AABB& aabb)
+	{
+		const glm::vec3 center = aabb.GetCenter();
+		const glm::vec3 extents = aabb.GetExtents();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extents) < 0.0f)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct Bin
+	{
+		AABB bounds = GetEmptyAABB();
+		AABB centroidBounds = GetEmptyAABB();
+		unsigned int count = 0;
+	};
+
+	void MergeBin(Bin& bin, const Bin& other)
+	{
+		GrowAABB(bin.bounds, other.bounds);
+		GrowAABB(bin.centroidBounds, other.centroidBounds);
+		bin.count += other.count;
+	}
+
+	void SetLane(BvhNode& node, unsigned int lane, const AABB& aabb, uint32_t child, uint32_t numPrimitives)
+	{
+		node.minX[lane] = aabb.min.x;
+		node.minY[lane] = aabb.min.y;
+		node.minZ[lane] = aabb.min.z;
+		node.maxX[lane] = aabb.max.x;
+		node.maxY[lane] = aabb.max.y;
+		node.maxZ[lane] = aabb.max.z;
+		node.children[lane] = child;
+		node.numPrimitives[lane] = numPrimitives;
+	}
+
+	unsigned int GetValidLanes(const BvhNode& node)
+	{
+		unsigned int mask = 0;
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			mask |= (node.children[lane] != BVH_INVALID_CHILD) << lane;
+		}
+		return mask;
+	}
+
+	unsigned int TestAABBLanes(const BvhNode& node, const AABB& aabb)
+	{
+#ifdef ORCA_SSE2
+		const __m128 overlapX = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(aabb.max.x)), _mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(aabb.min.x)));
+		const __m128 overlapY = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(aabb.max.y)), _mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(aabb.min.y)));
+		const __m128 overlapZ = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(aabb.max.z)), _mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(aabb.min.z)));
+		return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(overlapX, overlapY), overlapZ));
+#else
+		unsigned int mask = 0;
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			const bool bOverlaps = node.minX[lane] <= aabb.max.x && node.maxX[lane] >= aabb.min.x
+				&& node.minY[lane] <= aabb.max.y && node.maxY[lane] >= aabb.min.y
+				&& node.minZ[lane] <= aabb.max.z && node.maxZ[lane] >= aabb.min.z;
+			mask |= bOverlaps << lane;
+		}
+		return mask;
+#endif
+	}
+
+	// lanes at least partly inside, and the subset of those entirely inside
+	void TestFrustumLanes(const BvhNode& node, const Frustum& frustum, unsigned int& outIntersecting, unsigned int& outInside)
+	{
+#ifdef ORCA_SSE2
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128 minX = _mm_load_ps(node.minX);
+		const __m128 minY = _mm_load_ps(node.minY);
+		const __m128 minZ = _mm_load_ps(node.minZ);
+		const __m128 maxX = _mm_load_ps(node.maxX);
+		const __m128 maxY = _mm_load_ps(node.maxY);
+		const __m128 maxZ = _mm_load_ps(node.maxZ);
+		const __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+		const __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+		const __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+		const __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+		const __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+		const __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+		__m128 outside = _mm_setzero_ps();
+		__m128 crossing = _mm_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const __m128 planeX = _mm_set1_ps(plane.x);
+			const __m128 planeY = _mm_set1_ps(plane.y);
+			const __m128 planeZ = _mm_set1_ps(plane.z);
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX, centerX), _mm_mul_ps(planeY, centerY)), _mm_add_ps(_mm_mul_ps(planeZ, centerZ), _mm_set1_ps(plane.w)));
+			const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(planeX, signMask), extentX), _mm_mul_ps(_mm_and_ps(planeY, signMask), extentY)), _mm_mul_ps(_mm_and_ps(planeZ, signMask), extentZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			crossing = _mm_or_ps(crossing, _mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+		}
+		const unsigned int outsideMask = _mm_movemask_ps(outside);
+		const unsigned int crossingMask = _mm_movemask_ps(crossing);
+#else
+		unsigned int outsideMask = 0;
+		unsigned int crossingMask = 0;
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			const glm::vec3 boundsMin(node.minX[lane], node.minY[lane], node.minZ[lane]);
+			const glm::vec3 boundsMax(node.maxX[lane], node.maxY[lane], node.maxZ[lane]);
+			const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+			const glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+				const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+				outsideMask |= (distance + radius < 0.0f) << lane;
+				crossingMask |= (distance - radius < 0.0f) << lane;
+			}
+		}
+#endif
+		// unused lanes have inverted bounds, which give garbage here
+		outIntersecting = ~outsideMask & GetValidLanes(node);
+		outInside = ~crossingMask & outIntersecting;
+	}
+
+	// slab test, with the distance each hit lane is entered at
+	unsigned int TestRayLanes(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float* pOutNear)
+	{
+#ifdef ORCA_SSE2
+		const __m128 originX = _mm_set1_ps(origin.x);
+		const __m128 originY = _mm_set1_ps(origin.y);
+		const __m128 originZ = _mm_set1_ps(origin.z);
+		const __m128 invX = _mm_set1_ps(invDirection.x);
+		const __m128 invY = _mm_set1_ps(invDirection.y);
+		const __m128 invZ = _mm_set1_ps(invDirection.z);
+		const __m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), originX), invX);
+		const __m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), originX), invX);
+		const __m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), originY), invY);
+		const __m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), originY), invY);
+		const __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), originZ), invZ);
+		const __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), originZ), invZ);
+		const __m128 nearT = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0X, t1X), _mm_min_ps(t0Y, t1Y)), _mm_max_ps(_mm_min_ps(t0Z, t1Z), _mm_setzero_ps()));
+		const __m128 farT = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0X, t1X), _mm_max_ps(t0Y, t1Y)), _mm_min_ps(_mm_max_ps(t0Z, t1Z), _mm_set1_ps(maxDistance)));
+		_mm_storeu_ps(pOutNear, nearT);
+		return _mm_movemask_ps(_mm_cmple_ps(nearT, farT));
+#else
+		unsigned int mask = 0;
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			const glm::vec3 t0 = (glm::vec3(node.minX[lane], node.minY[lane], node.minZ[lane]) - origin) * invDirection;
+			const glm::vec3 t1 = (glm::vec3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]) - origin) * invDirection;
+			const glm::vec3 nearT = glm::min(t0, t1);
+			const glm::vec3 farT = glm::max(t0, t1);
+			pOutNear[lane] = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+			const float far = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+			mask |= (pOutNear[lane] <= far) << lane;
+		}
+		return mask;
+#endif
+	}
+}
+
+// binary node, only used while building
+struct Bvh::BuildNode
+{
+	AABB bounds;
+	uint32_t left;
+	uint32_t right;
+	uint32_t first;
+	// 0 for inner nodes
+	uint32_t count;
+};
+
+// primitives are partitioned along with their bounds, so every pass over a range reads memory in order
+struct Bvh::BuildPrimitive
+{
+	AABB bounds;
+	glm::vec3 centroid;
+	uint32_t index;
+};
+
+// shared by every build job. Each job owns a disjoint range of primitives, and nodes are allocated up front.
+struct Bvh::BuildContext
+{
+	std::vector<BuildPrimitive> primitives;
+	std::vector<BuildNode> nodes;
+	std::atomic<unsigned int> numNodes;
+};
+
+Bvh::Bvh()
+	: m_nodes()
+	, m_primitives()
+	, m_primitiveBounds()
+	, m_bounds()
+{
+}
+
+Bvh::~Bvh()
+{
+}
+
+void Bvh::Build(const AABB* pBounds, unsigned int numPrimitives)
+{
+	Clear();
+	if (numPrimitives == 0)
+	{
+		return;
+	}
+
+	BuildContext context;
+	context.primitives.resize(numPrimitives);
+	// a binary tree with one primitive per leaf is as big as it gets
+	context.nodes.resize(numPrimitives * 2 - 1);
+	context.numNodes = 1;
+
+	AABB centroidBounds = GetEmptyAABB();
+	m_bounds = GetEmptyAABB();
+	for (unsigned int i = 0; i < numPrimitives; ++i)
+	{
+		BuildPrimitive& primitive = context.primitives[i];
+		primitive.bounds = pBounds[i];
+		primitive.centroid = pBounds[i].GetCenter();
+		primitive.index = i;
+		GrowAABB(centroidBounds, primitive.centroid);
+		GrowAABB(m_bounds, primitive.bounds);
+	}
+
+	context.nodes[0].bounds = m_bounds;
+	BuildRange(context, 0, 0, numPrimitives, centroidBounds);
+
+	m_primitives.resize(numPrimitives);
+	m_primitiveBounds.resize(numPrimitives);
+	for (unsigned int i = 0; i < numPrimitives; ++i)
+	{
+		m_primitives[i] = context.primitives[i].index;
+		m_primitiveBounds[i] = context.primitives[i].bounds;
+	}
+
+	// 4-wide nodes need a bit over a third as many as the binary tree had inner nodes
+	m_nodes.reserve(context.numNodes / 3 + 1);
+	CollapseNode(context.nodes, 0);
+}
+
+void Bvh::Refit(const AABB* pBounds)
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < m_primitives.size(); ++i)
+	{
+		m_primitiveBounds[i] = pBounds[m_primitives[i]];
+	}
+
+	// children always come after their parent, so walking backwards refits bottom up
+	std::vector<AABB> nodeBounds(m_nodes.size());
+	for (size_t nodeIndex = m_nodes.size(); nodeIndex-- > 0;)
+	{
+		BvhNode& node = m_nodes[nodeIndex];
+		AABB bounds = GetEmptyAABB();
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			if (node.children[lane] == BVH_INVALID_CHILD)
+			{
+				continue;
+			}
+
+			AABB laneBounds = GetEmptyAABB();
+			if (node.numPrimitives[lane] > 0)
+			{
+				for (uint32_t i = node.children[lane]; i < node.children[lane] + node.numPrimitives[lane]; ++i)
+				{
+					GrowAABB(laneBounds, m_primitiveBounds[i]);
+				}
+			}
+			else
+			{
+				laneBounds = nodeBounds[node.children[lane]];
+			}
+
+			SetLane(node, lane, laneBounds, node.children[lane], node.numPrimitives[lane]);
+			GrowAABB(bounds, laneBounds);
+		}
+		nodeBounds[nodeIndex] = bounds;
+	}
+	m_bounds = nodeBounds[0];
+}
+
+void Bvh::Clear()
+{
+	m_nodes.clear();
+	m_primitives.clear();
+	m_primitiveBounds.clear();
+	m_bounds = AABB();
+}
+
+void Bvh::QueryAABB(const AABB& aabb, std::vector<unsigned int>& outPrimitives) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		const unsigned int mask = TestAABBLanes(node, aabb) & GetValidLanes(node);
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			if (!(mask & (1 << lane)))
+			{
+				continue;
+			}
+
+			if (node.numPrimitives[lane] == 0)
+			{
+				stack.push_back(node.children[lane]);
+				continue;
+			}
+			for (uint32_t i = node.children[lane]; i < node.children[lane] + node.numPrimitives[lane]; ++i)
+			{
+				if (Overlaps(m_primitiveBounds[i], aabb))
+				{
+					outPrimitives.push_back(m_primitives[i]);
+				}
+			}
+		}
+	}
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& outPrimitives) const
+{
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> stack;
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		unsigned int intersecting = 0;
+		unsigned int inside = 0;
+		TestFrustumLanes(node, frustum, intersecting, inside);
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			if (!(intersecting & (1 << lane)))
+			{
+				continue;
+			}
+
+			const bool bInside = (inside & (1 << lane)) != 0;
+			if (node.numPrimitives[lane] == 0)
+			{
+				// nothing under a node that's entirely inside needs testing
+				if (bInside)
+				{
+					AddSubtree(node.children[lane], outPrimitives);
+				}
+				else
+				{
+					stack.push_back(node.children[lane]);
+				}
+				continue;
+			}
+			for (uint32_t i = node.children[lane]; i < node.children[lane] + node.numPrimitives[lane]; ++i)
+			{
+				if (bInside || !IsOutside(frustum, m_primitiveBounds[i]))
+				{
+					outPrimitives.push_back(m_primitives[i]);
+				}
+			}
+		}
+	}
+}
+
+bool Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const BvhRayCallback& callback, float& outDistance) const
+{
+	outDistance = maxDistance;
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	struct StackEntry
+	{
+		uint32_t node;
+		float distance;
+	};
+
+	// division by a zero component gives an infinity, which the slab test handles
+	const glm::vec3 invDirection = 1.0f / direction;
+	bool bHit = false;
+	std::vector<StackEntry> stack;
+	stack.push_back(StackEntry{ 0, 0.0f });
+	while (!stack.empty())
+	{
+		const StackEntry entry = stack.back();
+		stack.pop_back();
+		if (entry.distance > outDistance)
+		{
+			continue;
+		}
+
+		const BvhNode& node = m_nodes[entry.node];
+		float nearDistances[BVH_WIDTH];
+		const unsigned int mask = TestRayLanes(node, origin, invDirection, outDistance, nearDistances) & GetValidLanes(node);
+
+		// leaves go first, any hit in them can rule out the inner children before they're pushed
+		StackEntry children[BVH_WIDTH];
+		unsigned int numChildren = 0;
+		for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+		{
+			if (!(mask & (1 << lane)))
+			{
+				continue;
+			}
+
+			if (node.numPrimitives[lane] == 0)
+			{
+				children[numChildren++] = StackEntry{ node.children[lane], nearDistances[lane] };
+				continue;
+			}
+			for (uint32_t i = node.children[lane]; i < node.children[lane] + node.numPrimitives[lane]; ++i)
+			{
+				bHit |= callback(m_primitives[i], outDistance);
+			}
+		}
+
+		// furthest first, so the nearest is popped next
+		std::sort(children, children + numChildren, [](const StackEntry& a, const StackEntry& b) { return a.distance > b.distance; });
+		for (unsigned int i = 0; i < numChildren; ++i)
+		{
+			if (children[i].distance <= outDistance)
+			{
+				stack.push_back(children[i]);
+			}
+		}
+	}
+	return bHit;
+}
+
+void Bvh::BuildRange(BuildContext& context, unsigned int nodeIndex, unsigned int first, unsigned int count, const AABB& centroidBounds)
+{
+	BuildNode& node = context.nodes[nodeIndex];
+	node.left = BVH_INVALID_CHILD;
+	node.right = BVH_INVALID_CHILD;
+	node.first = first;
+	node.count = count;
+	if (count <= 1)
+	{
+		return;
+	}
+
+	const glm::vec3 centroidSize = centroidBounds.max - centroidBounds.min;
+	const unsigned int axis = centroidSize.x > centroidSize.y ? (centroidSize.x > centroidSize.z ? 0 : 2) : (centroidSize.y > centroidSize.z ? 1 : 2);
+
+	BuildPrimitive* pPrimitives = context.primitives.data() + first;
+	unsigned int numLeft = 0;
+	AABB leftBounds = GetEmptyAABB();
+	AABB rightBounds = GetEmptyAABB();
+	AABB leftCentroidBounds = centroidBounds;
+	AABB rightCentroidBounds = centroidBounds;
+	if (centroidSize[axis] <= 0.0f)
+	{
+		// every centroid is in the same place, so the heuristic can't separate them. Halve the range until it fits.
+		if (count <= BVH_MAX_LEAF_SIZE)
+		{
+			return;
+		}
+
+		numLeft = count / 2;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			GrowAABB(i < numLeft ? leftBounds : rightBounds, pPrimitives[i].bounds);
+		}
+	}
+	else
+	{
+		const float binScale = NUM_BINS / centroidSize[axis];
+		const float binOrigin = centroidBounds.min[axis];
+		auto GetBin = [&](const BuildPrimitive& primitive) -> unsigned int
+		{
+			const unsigned int bin = static_cast<unsigned int>((primitive.centroid[axis] - binOrigin) * binScale);
+			return std::min(bin, NUM_BINS - 1);
+		};
+		auto FillBins = [&](unsigned int begin, unsigned int end, Bin* pBins)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				Bin& bin = pBins[GetBin(pPrimitives[i])];
+				GrowAABB(bin.bounds, pPrimitives[i].bounds);
+				GrowAABB(bin.centroidBounds, pPrimitives[i].centroid);
+				++bin.count;
+			}
+		};
+
+		Bin bins[NUM_BINS];
+		if (count >= PARALLEL_BINNING_SIZE)
+		{
+			const unsigned int numChunks = (count + BINNING_CHUNK_SIZE - 1) / BINNING_CHUNK_SIZE;
+			std::vector<Bin> chunkBins(numChunks * NUM_BINS);
+			JobSystem::GetInstance()->ParallelFor(numChunks, [&](unsigned int chunk)
+			{
+				FillBins(chunk * BINNING_CHUNK_SIZE, std::min((chunk + 1) * BINNING_CHUNK_SIZE, count), &chunkBins[chunk * NUM_BINS]);
+			});
+			for (unsigned int chunk = 0; chunk < numChunks; ++chunk)
+			{
+				for (unsigned int b = 0; b < NUM_BINS; ++b)
+				{
+					MergeBin(bins[b], chunkBins[chunk * NUM_BINS + b]);
+				}
+			}
+		}
+		else
+		{
+			FillBins(0, count, bins);
+		}
+
+		// everything left of each split plane, then everything right of it
+		Bin leftBins[NUM_BINS - 1];
+		Bin rightBins[NUM_BINS - 1];
+		Bin accumulated;
+		for (unsigned int b = 0; b < NUM_BINS - 1; ++b)
+		{
+			MergeBin(accumulated, bins[b]);
+			leftBins[b] = accumulated;
+		}
+		accumulated = Bin();
+		for (unsigned int b = NUM_BINS - 1; b > 0; --b)
+		{
+			MergeBin(accumulated, bins[b]);
+			rightBins[b - 1] = accumulated;
+		}
+
+		// the lowest and highest centroids land in the first and last bins, so there's always a split with both sides used
+		unsigned int bestSplit = 0;
+		float bestCost = FLT_MAX;
+		const float invArea = 1.0f / std::max(GetSurfaceArea(node.bounds), FLT_MIN);
+		for (unsigned int split = 0; split < NUM_BINS - 1; ++split)
+		{
+			if (leftBins[split].count == 0 || rightBins[split].count == 0)
+			{
+				continue;
+			}
+
+			const float cost = TRAVERSAL_COST + INTERSECTION_COST * invArea * (GetSurfaceArea(leftBins[split].bounds) * leftBins[split].count + GetSurfaceArea(rightBins[split].bounds) * rightBins[split].count);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = split;
+			}
+		}
+
+		if (count <= BVH_MAX_LEAF_SIZE && bestCost >= INTERSECTION_COST * count)
+		{
+			return;
+		}
+
+		std::partition(pPrimitives, pPrimitives + count, [&](const BuildPrimitive& primitive) { return GetBin(primitive) <= bestSplit; });
+		numLeft = leftBins[bestSplit].count;
+		leftBounds = leftBins[bestSplit].bounds;
+		rightBounds = rightBins[bestSplit].bounds;
+		leftCentroidBounds = leftBins[bestSplit].centroidBounds;
+		rightCentroidBounds = rightBins[bestSplit].centroidBounds;
+	}
+
+	const unsigned int left = context.numNodes.fetch_add(2);
+	node.left = left;
+	node.right = left + 1;
+	node.count = 0;
+	context.nodes[left].bounds = leftBounds;
+	context.nodes[left + 1].bounds = rightBounds;
+
+	if (count >= PARALLEL_SUBTREE_SIZE)
+	{
+		JobSystem::GetInstance()->ParallelFor(2, [&](unsigned int child)
+		{
+			if (child == 0)
+			{
+				BuildRange(context, left, first, numLeft, leftCentroidBounds);
+			}
+			else
+			{
+				BuildRange(context, left + 1, first + numLeft, count - numLeft, rightCentroidBounds);
+			}
+		});
+	}
+	else
+	{
+		BuildRange(context, left, first, numLeft, leftCentroidBounds);
+		BuildRange(context, left + 1, first + numLeft, count - numLeft, rightCentroidBounds);
+	}
+}
+
+unsigned int Bvh::CollapseNode(const std::vector<BuildNode>& buildNodes, unsigned int buildIndex)
+{
+	// pull grandchildren up into the node, always opening the inner child with the most surface area, until all four
+	// lanes are used
+	uint32_t lanes[BVH_WIDTH];
+	unsigned int numLanes = 0;
+	const BuildNode& buildNode = buildNodes[buildIndex];
+	if (buildNode.count > 0)
+	{
+		// only happens for a root that's a leaf
+		lanes[numLanes++] = buildIndex;
+	}
+	else
+	{
+		lanes[numLanes++] = buildNode.left;
+		lanes[numLanes++] = buildNode.right;
+		while (numLanes < BVH_WIDTH)
+		{
+			int bestLane = -1;
+			float bestArea = -1.0f;
+			for (unsigned int lane = 0; lane < numLanes; ++lane)
+			{
+				const BuildNode& child = buildNodes[lanes[lane]];
+				if (child.count == 0 && GetSurfaceArea(child.bounds) > bestArea)
+				{
+					bestArea = GetSurfaceArea(child.bounds);
+					bestLane = static_cast<int>(lane);
+				}
+			}
+			if (bestLane < 0)
+			{
+				break;
+			}
+
+			const BuildNode& opened = buildNodes[lanes[bestLane]];
+			lanes[bestLane] = opened.left;
+			lanes[numLanes++] = opened.right;
+		}
+	}
+
+	const unsigned int nodeIndex = static_cast<unsigned int>(m_nodes.size());
+	m_nodes.emplace_back();
+	for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+	{
+		SetLane(m_nodes[nodeIndex], lane, GetEmptyAABB(), BVH_INVALID_CHILD, 0);
+	}
+
+	for (unsigned int lane = 0; lane < numLanes; ++lane)
+	{
+		const BuildNode& child = buildNodes[lanes[lane]];
+		if (child.count > 0)
+		{
+			SetLane(m_nodes[nodeIndex], lane, child.bounds, child.first, child.count);
+		}
+		else
+		{
+			// the recursion can grow m_nodes, so the node is only looked up again afterwards
+			const unsigned int childIndex = CollapseNode(buildNodes, lanes[lane]);
+			SetLane(m_nodes[nodeIndex], lane, child.bounds, childIndex, 0);
+		}
+	}
+	return nodeIndex;
+}
+
+void Bvh::AddSubtree(unsigned int nodeIndex, std::vector<unsigned int>& outPrimitives) const
+{
+	const BvhNode& node = m_nodes[nodeIndex];
+	for (unsigned int lane = 0; lane < BVH_WIDTH; ++lane)
+	{
+		if (node.children[lane] == BVH_INVALID_CHILD)
+		{
+			continue;
+		}
+
+		if (node.numPrimitives[lane] == 0)
+		{
+			AddSubtree(node.children[lane], outPrimitives);
+			continue;
+		}
+		outPrimitives.insert(outPrimitives.end(), m_primitives.begin() + node.children[lane], m_primitives.begin() + node.children[lane] + node.numPrimitives[lane]);
+	}
+}
\ No newline at end of file
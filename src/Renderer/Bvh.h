@@ -0,0 +1,81 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+const unsigned int BVH_WIDTH = 4;
+// most primitives a leaf holds, larger ranges are always split
+const unsigned int BVH_MAX_LEAF_SIZE = 4;
+const uint32_t BVH_INVALID_CHILD = 0xFFFFFFFF;
+
+// Four children to a node, with their bounds as structure of arrays so a query tests all four at once. Exactly two
+// cache lines.
+struct alignas(64) BvhNode
+{
+	float minX[BVH_WIDTH];
+	float minY[BVH_WIDTH];
+	float minZ[BVH_WIDTH];
+	float maxX[BVH_WIDTH];
+	float maxY[BVH_WIDTH];
+	float maxZ[BVH_WIDTH];
+	// node index for inner children, offset of the first primitive for leaves, BVH_INVALID_CHILD for unused lanes
+	uint32_t children[BVH_WIDTH];
+	// 0 for inner children and unused lanes
+	uint32_t numPrimitives[BVH_WIDTH];
+};
+
+// called for each primitive whose bounds the ray reaches. Returns true if the primitive itself is hit closer than
+// inOutDistance, after shortening it to the hit.
+typedef std::function<bool(unsigned int primitive, float& inOutDistance)> BvhRayCallback;
+
+// Bounding volume hierarchy over anything with a box: triangles for picking and baking, whole meshes for culling.
+// Built top down with a binned surface area heuristic, binning and recursing across the job system while ranges are
+// large, then collapsed from a binary tree into 4-wide nodes.
+class Bvh
+{
+public:
+	Bvh();
+	~Bvh();
+
+	void Build(const AABB* pBounds, unsigned int numPrimitives);
+	// updates the bounds of every node for primitives that have moved, keeping the tree's structure. Much cheaper than
+	// a build, but queries slow down the further things move from where they were built.
+	void Refit(const AABB* pBounds);
+	void Clear();
+
+	// append the primitives whose own bounds overlap
+	void QueryAABB(const AABB& aabb, std::vector<unsigned int>& outPrimitives) const;
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& outPrimitives) const;
+	// visits nodes nearest first, skipping any beyond the closest hit so far. Returns true if the callback reported a
+	// hit, with outDistance set to the closest one. The direction doesn't have to be normalised, distances are in
+	// multiples of it.
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const BvhRayCallback& callback, float& outDistance) const;
+
+	bool IsEmpty() const { return m_nodes.empty(); }
+	unsigned int GetNumNodes() const { return static_cast<unsigned int>(m_nodes.size()); }
+	unsigned int GetNumPrimitives() const { return static_cast<unsigned int>(m_primitives.size()); }
+	const AABB& GetBounds() const { return m_bounds; }
+
+private:
+	struct BuildNode;
+	struct BuildPrimitive;
+	struct BuildContext;
+
+	static void BuildRange(BuildContext& context, unsigned int nodeIndex, unsigned int first, unsigned int count, const AABB& centroidBounds);
+	unsigned int CollapseNode(const std::vector<BuildNode>& buildNodes, unsigned int buildIndex);
+	void AddSubtree(unsigned int nodeIndex, std::vector<unsigned int>& outPrimitives) const;
+
+	std::vector<BvhNode> m_nodes;
+	// primitive indices in leaf order, with their bounds alongside
+	std::vector<unsigned int> m_primitives;
+	std::vector<AABB> m_primitiveBounds;
+	AABB m_bounds;
+};
+
+#endif
\ No newline at end of file
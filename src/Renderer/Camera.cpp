@@ -22,6 +22,7 @@ namespace
 Camera::Camera(int width, int height, float fov, float near, float far)
 	: mProjectionMatrix(1.0f)
 	, mViewMatrix(glm::lookAt(WORLD_ORIGIN, WORLD_FORWARD, WORLD_UP))
+	, mFrustum()
 	, mPosition(WORLD_ORIGIN)
 	, mRight(WORLD_RIGHT)
 	, mUp(WORLD_UP)
@@ -37,6 +38,7 @@ Camera::Camera(int width, int height, float fov, float near, float far)
 	, mMovementSpeed(1.0f)
 	, mLookSensitivity(0.005f)
 	, mbDirty(false)
+	, mbFrustumDirty(true)
 	, mbFreeLookEnabled(false)
 {
 	// glm calculates the projection matrix using vertical field of view, but I find horizontal more intuitive from a player's perspective
@@ -171,7 +173,20 @@ const glm::mat4& Camera::GetViewMatrix()
 	{
 		mViewMatrix = glm::lookAt(mPosition, mPosition + mForward, mUp);
 		mbDirty = false;
+		mbFrustumDirty = true;
 	}
 
 	return mViewMatrix;
+}
+
+const Frustum& Camera::GetFrustum()
+{
+	const glm::mat4& viewMatrix = GetViewMatrix();
+	if (mbFrustumDirty)
+	{
+		mFrustum = ComputeFrustum(mProjectionMatrix * viewMatrix);
+		mbFrustumDirty = false;
+	}
+
+	return mFrustum;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <glm/mat4x4.hpp>
 #include <glm/glm.hpp>
 
+#include "Bounds.h"
+
 class Camera
 {
 public:
@@ -17,6 +19,8 @@ public:
 
 	const glm::mat4& GetProjectionMatrix() const { return mProjectionMatrix; }
 	const glm::mat4& GetViewMatrix();
+	// world space planes, only recalculated after the camera moves
+	const Frustum& GetFrustum();
 	const glm::vec3& GetPosition() const { return mPosition; }
 	void SetPosition(const glm::vec3& pos);
 	const glm::vec3& GetRight() const { return mRight; }
@@ -34,6 +38,7 @@ public:
 private:
 	glm::mat4 mProjectionMatrix;
 	glm::mat4 mViewMatrix;
+	Frustum mFrustum;
 
 	glm::vec3 mPosition;
 	glm::vec3 mRight;
@@ -54,6 +59,7 @@ private:
 	float mLookSensitivity;
 
 	bool mbDirty;
+	bool mbFrustumDirty;
 	bool mbFreeLookEnabled;
 };
 
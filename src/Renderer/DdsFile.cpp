@@ -0,0 +1,180 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const size_t DDS_HEADER_OFFSET = 4;
+	const size_t DDS_HEADER_SIZE = 124;
+	const size_t DDS_PIXEL_FORMAT_OFFSET = DDS_HEADER_OFFSET + 72;
+	const size_t DDS_DX10_HEADER_OFFSET = DDS_HEADER_OFFSET + DDS_HEADER_SIZE;
+	const size_t DDS_DX10_HEADER_SIZE = 20;
+
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+	const uint32_t DDSCAPS2_VOLUME = 0x200000;
+	const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	struct DdsFormatInfo
+	{
+		uint32_t id;
+		TextureFormat format;
+		bool bSRGB;
+	};
+
+	const DdsFormatInfo DDS_FOURCC_FORMATS[] =
+	{
+		{ MakeFourCC('D', 'X', 'T', '1'), TF_BC1, false },
+		{ MakeFourCC('D', 'X', 'T', '5'), TF_BC3, false },
+		{ MakeFourCC('A', 'T', 'I', '1'), TF_BC4, false },
+		{ MakeFourCC('B', 'C', '4', 'U'), TF_BC4, false },
+		{ MakeFourCC('A', 'T', 'I', '2'), TF_BC5, false },
+		{ MakeFourCC('B', 'C', '5', 'U'), TF_BC5, false },
+	};
+
+	const DdsFormatInfo DXGI_FORMATS[] =
+	{
+		{ 28, TF_RGBA8, false },	// DXGI_FORMAT_R8G8B8A8_UNORM
+		{ 29, TF_RGBA8, true },		// DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+		{ 49, TF_RG8, false },		// DXGI_FORMAT_R8G8_UNORM
+		{ 61, TF_R8, false },		// DXGI_FORMAT_R8_UNORM
+		{ 71, TF_BC1, false },		// DXGI_FORMAT_BC1_UNORM
+		{ 72, TF_BC1, true },		// DXGI_FORMAT_BC1_UNORM_SRGB
+		{ 77, TF_BC3, false },		// DXGI_FORMAT_BC3_UNORM
+		{ 78, TF_BC3, true },		// DXGI_FORMAT_BC3_UNORM_SRGB
+		{ 80, TF_BC4, false },		// DXGI_FORMAT_BC4_UNORM
+		{ 83, TF_BC5, false },		// DXGI_FORMAT_BC5_UNORM
+		{ 98, TF_BC7, false },		// DXGI_FORMAT_BC7_UNORM
+		{ 99, TF_BC7, true },		// DXGI_FORMAT_BC7_UNORM_SRGB
+	};
+
+	template <size_t N>
+	const DdsFormatInfo* FindFormatInfo(const DdsFormatInfo (&formats)[N], uint32_t id)
+	{
+		for (const auto& info : formats)
+		{
+			if (info.id == id)
+			{
+				return &info;
+			}
+		}
+		return nullptr;
+	}
+
+	uint32_t ReadU32(const unsigned char* pData)
+	{
+		uint32_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+}
+
+DdsFile::DdsFile()
+	: m_file()
+	, m_levels()
+	, m_format(TF_BC1)
+	, m_width(0)
+	, m_height(0)
+	, m_bSRGB(false)
+{
+}
+
+DdsFile::~DdsFile()
+{
+	Close();
+}
+
+bool DdsFile::Open(const std::string& filename)
+{
+	Close();
+
+	if (!FileSystem::GetInstance()->Open(filename, m_file))
+	{
+		return false;
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	if (size < DDS_DX10_HEADER_OFFSET || ReadU32(pData) != MakeFourCC('D', 'D', 'S', ' ') || ReadU32(pData + DDS_HEADER_OFFSET) != DDS_HEADER_SIZE)
+	{
+		printf("\"%s\" is not a DDS file\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	const uint32_t flags = ReadU32(pData + DDS_HEADER_OFFSET + 4);
+	const uint32_t mipMapCount = ReadU32(pData + DDS_HEADER_OFFSET + 24);
+	const uint32_t caps2 = ReadU32(pData + DDS_HEADER_OFFSET + 108);
+	const uint32_t pixelFormatFlags = ReadU32(pData + DDS_PIXEL_FORMAT_OFFSET + 4);
+	const uint32_t fourCC = ReadU32(pData + DDS_PIXEL_FORMAT_OFFSET + 8);
+
+	const DdsFormatInfo* pFormatInfo = nullptr;
+	size_t dataOffset = DDS_DX10_HEADER_OFFSET;
+	bool bSupported = (pixelFormatFlags & DDPF_FOURCC) != 0 && (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) == 0;
+	if (bSupported && fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		// only single 2D textures, no arrays
+		dataOffset += DDS_DX10_HEADER_SIZE;
+		bSupported = size >= dataOffset
+			&& ReadU32(pData + DDS_DX10_HEADER_OFFSET + 4) == D3D10_RESOURCE_DIMENSION_TEXTURE2D
+			&& ReadU32(pData + DDS_DX10_HEADER_OFFSET + 12) <= 1;
+		pFormatInfo = bSupported ? FindFormatInfo(DXGI_FORMATS, ReadU32(pData + DDS_DX10_HEADER_OFFSET)) : nullptr;
+	}
+	else if (bSupported)
+	{
+		pFormatInfo = FindFormatInfo(DDS_FOURCC_FORMATS, fourCC);
+	}
+
+	if (!pFormatInfo)
+	{
+		printf("Unsupported DDS texture \"%s\"\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	m_format = pFormatInfo->format;
+	m_bSRGB = pFormatInfo->bSRGB;
+	m_height = ReadU32(pData + DDS_HEADER_OFFSET + 8);
+	m_width = ReadU32(pData + DDS_HEADER_OFFSET + 12);
+
+	// levels are stored back to back, largest first
+	const unsigned int numLevels = (flags & DDSD_MIPMAPCOUNT) && mipMapCount > 0 ? std::min(mipMapCount, GetMipLevelCount(m_width, m_height)) : 1;
+	m_levels.resize(numLevels);
+	size_t offset = dataOffset;
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		TextureLevel& textureLevel = m_levels[level];
+		textureLevel.width = std::max(m_width >> level, 1u);
+		textureLevel.height = std::max(m_height >> level, 1u);
+		textureLevel.size = GetTextureLevelSize(m_format, textureLevel.width, textureLevel.height);
+		textureLevel.pData = pData + offset;
+
+		offset += textureLevel.size;
+		if (offset > size)
+		{
+			printf("DDS texture \"%s\" is corrupt\n", filename.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void DdsFile::Close()
+{
+	m_file.Close();
+	m_levels.clear();
+	m_width = 0;
+	m_height = 0;
+	m_bSRGB = false;
+}
\ No newline at end of file
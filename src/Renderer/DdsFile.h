@@ -0,0 +1,37 @@
+#ifndef DDS_FILE_H
+#define DDS_FILE_H
+
+#include <string>
+#include <vector>
+
+#include "Core/FileSystem.h"
+#include "TextureImage.h"
+
+// read-only view of a DDS file holding block compressed 2D data, either with a legacy FourCC or a DX10 header,
+// opened through FileSystem. Level data points straight into the file contents.
+class DdsFile
+{
+public:
+	DdsFile();
+	~DdsFile();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	TextureFormat GetFormat() const { return m_format; }
+	bool IsSRGB() const { return m_bSRGB; }
+	unsigned int GetWidth() const { return m_width; }
+	unsigned int GetHeight() const { return m_height; }
+	unsigned int GetNumLevels() const { return static_cast<unsigned int>(m_levels.size()); }
+	const TextureLevel& GetLevel(unsigned int level) const { return m_levels[level]; }
+
+private:
+	File m_file;
+	std::vector<TextureLevel> m_levels;
+	TextureFormat m_format;
+	unsigned int m_width;
+	unsigned int m_height;
+	bool m_bSRGB;
+};
+
+#endif
\ No newline at end of file
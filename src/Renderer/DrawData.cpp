@@ -0,0 +1,101 @@
+#include "DrawData.h"
+
+#include <algorithm>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace
+{
+	// small batches aren't worth handing to other threads
+	const size_t DRAWS_PER_JOB = 256;
+
+#ifdef ORCA_SSE2
+	__m128 Cross(__m128 a, __m128 b)
+	{
+		// (a * b.yzx - a.yzx * b).yzx, w stays a.w * b.w - a.w * b.w = 0
+		const __m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	__m128 Dot(__m128 a, __m128 b)
+	{
+		__m128 sum = _mm_mul_ps(a, b);
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	void ComputeMatrices(const __m128* pViewProjection, GpuDrawData& draw)
+	{
+		const float* pTransform = &draw.transform[0][0];
+		__m128 columns[4];
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			columns[i] = _mm_loadu_ps(pTransform + i * 4);
+		}
+
+		// a transform is affine, so its bottom row is 0 0 0 1 and the first three columns' w doesn't disturb the
+		// cross products. The inverse transpose of the 3x3 with columns a b c has columns b×c, c×a and a×b over the
+		// determinant.
+		const __m128 bc = Cross(columns[1], columns[2]);
+		const __m128 ca = Cross(columns[2], columns[0]);
+		const __m128 ab = Cross(columns[0], columns[1]);
+		const __m128 determinant = Dot(columns[0], bc);
+		const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+		float* pNormal = &draw.normalMatrix[0][0];
+		_mm_storeu_ps(pNormal, _mm_mul_ps(bc, inverseDeterminant));
+		_mm_storeu_ps(pNormal + 4, _mm_mul_ps(ca, inverseDeterminant));
+		_mm_storeu_ps(pNormal + 8, _mm_mul_ps(ab, inverseDeterminant));
+
+		float* pWorldViewProjection = &draw.worldViewProjection[0][0];
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			__m128 column = _mm_mul_ps(pViewProjection[0], _mm_shuffle_ps(columns[i], columns[i], _MM_SHUFFLE(0, 0, 0, 0)));
+			column = _mm_add_ps(column, _mm_mul_ps(pViewProjection[1], _mm_shuffle_ps(columns[i], columns[i], _MM_SHUFFLE(1, 1, 1, 1))));
+			column = _mm_add_ps(column, _mm_mul_ps(pViewProjection[2], _mm_shuffle_ps(columns[i], columns[i], _MM_SHUFFLE(2, 2, 2, 2))));
+			column = _mm_add_ps(column, _mm_mul_ps(pViewProjection[3], _mm_shuffle_ps(columns[i], columns[i], _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(pWorldViewProjection + i * 4, column);
+		}
+	}
+#endif
+
+	void ComputeMatricesRange(const glm::mat4& viewProjection, GpuDrawData* pDraws, size_t count)
+	{
+#ifdef ORCA_SSE2
+		__m128 viewProjectionColumns[4];
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			viewProjectionColumns[i] = _mm_loadu_ps(&viewProjection[i][0]);
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			ComputeMatrices(viewProjectionColumns, pDraws[i]);
+		}
+#else
+		for (size_t i = 0; i < count; ++i)
+		{
+			GpuDrawData& draw = pDraws[i];
+			draw.normalMatrix = glm::mat3x4(glm::transpose(glm::inverse(glm::mat3(draw.transform))));
+			draw.worldViewProjection = viewProjection * draw.transform;
+		}
+#endif
+	}
+}
+
+void ComputeDrawMatrices(const glm::mat4& viewProjection, GpuDrawData* pDraws, size_t count)
+{
+	if (count <= DRAWS_PER_JOB)
+	{
+		ComputeMatricesRange(viewProjection, pDraws, count);
+		return;
+	}
+
+	const size_t numJobs = (count + DRAWS_PER_JOB - 1) / DRAWS_PER_JOB;
+	JobSystem::GetInstance()->ParallelFor(static_cast<unsigned int>(numJobs), [&](unsigned int job)
+	{
+		const size_t first = job * DRAWS_PER_JOB;
+		ComputeMatricesRange(viewProjection, pDraws + first, std::min(DRAWS_PER_JOB, count - first));
+	});
+}
\ No newline at end of file
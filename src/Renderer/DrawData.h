@@ -0,0 +1,40 @@
+#ifndef DRAW_DATA_H
+#define DRAW_DATA_H
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// draws in one frame that can be told apart by the draw id attribute, see GeometryPool
+const unsigned int MAX_DRAW_IDS = 1 << 16;
+
+// matches DrawData in assets/shaders/include/draw_data.glsl, laid out std430
+struct GpuDrawData
+{
+	glm::mat4 transform;
+	// inverse transpose of the transform's upper 3x3, each column padded to a vec4 like std430's mat3
+	glm::mat3x4 normalMatrix;
+	glm::mat4 worldViewProjection;
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	unsigned int numIndices;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int group;
+};
+
+// what glMultiDrawElementsIndirect reads for each draw
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+// fills in the normal and world view projection matrices of each draw from its transform, so the vertex shader
+// doesn't invert a matrix per vertex. Large batches are split across the job system.
+void ComputeDrawMatrices(const glm::mat4& viewProjection, GpuDrawData* pDraws, size_t count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "FrameRingBuffer.h"
+
+#include <algorithm>
+
+#include "GLStateCache.h"
+
+namespace
+{
+	const GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	// how long each wait for a fence lasts before trying again, in nanoseconds
+	const GLuint64 FENCE_TIMEOUT = 1000000;
+
+	// regions are bound with glBindBufferRange, which needs offsets aligned for both kinds of buffer
+	size_t GetRegionAlignment()
+	{
+		static size_t alignment = 0;
+		if (alignment == 0)
+		{
+			GLint uniformAlignment = 0;
+			GLint storageAlignment = 0;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+			alignment = static_cast<size_t>(std::max(std::max(uniformAlignment, storageAlignment), 16));
+		}
+		return alignment;
+	}
+}
+
+RingBufferStorage::RingBufferStorage(size_t elementSize, unsigned int capacity)
+	: m_buffer(0)
+	, m_pMapped(nullptr)
+	, m_fences()
+	, m_elementSize(elementSize)
+	, m_regionSize(0)
+	, m_capacity(0)
+	, m_region(NUM_RING_BUFFER_FRAMES - 1)
+	, m_count(0)
+	, m_numStalls(0)
+{
+	Resize(std::max(capacity, 1u));
+}
+
+RingBufferStorage::~RingBufferStorage()
+{
+	for (GLsync& fence : m_fences)
+	{
+		if (fence)
+		{
+			glDeleteSync(fence);
+		}
+	}
+
+	GLStateCache::GetInstance()->OnBufferDeleted(m_buffer);
+	glUnmapNamedBuffer(m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+}
+
+void* RingBufferStorage::BeginRegion(unsigned int count)
+{
+	m_region = (m_region + 1) % NUM_RING_BUFFER_FRAMES;
+
+	GLsync& fence = m_fences[m_region];
+	if (fence)
+	{
+		// flushing on the first try makes sure the fence actually reaches the GPU rather than waiting forever
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			++m_numStalls;
+			do
+			{
+				result = glClientWaitSync(fence, 0, FENCE_TIMEOUT);
+			}
+			while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (count > m_capacity)
+	{
+		Resize(std::max(count, m_capacity * 2));
+	}
+
+	m_count = count;
+	return m_pMapped + GetOffset();
+}
+
+void RingBufferStorage::EndRegion()
+{
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RingBufferStorage::BindRange(GLenum target, unsigned int index) const
+{
+	GLStateCache::GetInstance()->BindBufferRange(target, index, m_buffer, static_cast<GLintptr>(GetOffset()), static_cast<GLsizeiptr>(std::max(m_count, 1u) * m_elementSize));
+}
+
+void RingBufferStorage::Resize(unsigned int capacity)
+{
+	// GL keeps the old buffer alive for commands still reading it, so it can go straight away, fences and all
+	if (m_buffer)
+	{
+		for (GLsync& fence : m_fences)
+		{
+			if (fence)
+			{
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+
+		GLStateCache::GetInstance()->OnBufferDeleted(m_buffer);
+		glUnmapNamedBuffer(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	const size_t alignment = GetRegionAlignment();
+	m_capacity = capacity;
+	m_regionSize = (capacity * m_elementSize + alignment - 1) / alignment * alignment;
+
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, static_cast<GLsizeiptr>(m_regionSize * NUM_RING_BUFFER_FRAMES), nullptr, MAP_FLAGS);
+	m_pMapped = static_cast<unsigned char*>(glMapNamedBufferRange(m_buffer, 0, static_cast<GLsizeiptr>(m_regionSize * NUM_RING_BUFFER_FRAMES), MAP_FLAGS));
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef FRAME_RING_BUFFER_H
+#define FRAME_RING_BUFFER_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// regions per ring buffer, so the CPU can write one while the GPU is still reading the two before it
+const unsigned int NUM_RING_BUFFER_FRAMES = 3;
+
+// Untyped storage behind FrameRingBuffer. The buffer is created with glBufferStorage and stays mapped, persistent and
+// coherent, for as long as it lives, split into NUM_RING_BUFFER_FRAMES regions used in turn. Each region gets a
+// fence once the commands reading it have been issued, and is only handed out again once the GPU has passed it, so
+// writes never have to wait on a glBufferSubData's implicit synchronisation or stomp on data still being read.
+class RingBufferStorage
+{
+public:
+	~RingBufferStorage();
+
+	// waits for the GPU to finish with the next region, growing every region to count elements if they're smaller,
+	// and returns it for writing
+	void* BeginRegion(unsigned int count);
+	// fences the current region, call once everything reading it has been issued
+	void EndRegion();
+
+	// binds the current region to an indexed GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER binding point
+	void BindRange(GLenum target, unsigned int index) const;
+
+	unsigned int GetBuffer() const { return m_buffer; }
+	// in bytes, where the current region starts
+	size_t GetOffset() const { return m_region * m_regionSize; }
+	unsigned int GetCount() const { return m_count; }
+	// times BeginRegion had to wait for the GPU, which means more regions or smaller frames are needed
+	unsigned int GetNumStalls() const { return m_numStalls; }
+
+protected:
+	RingBufferStorage(size_t elementSize, unsigned int capacity);
+
+private:
+	void Resize(unsigned int capacity);
+
+	unsigned int m_buffer;
+	unsigned char* m_pMapped;
+	GLsync m_fences[NUM_RING_BUFFER_FRAMES];
+
+	size_t m_elementSize;
+	// in bytes, rounded up so every region starts at an offset any binding point accepts
+	size_t m_regionSize;
+	unsigned int m_capacity;
+	unsigned int m_region;
+	unsigned int m_count;
+	unsigned int m_numStalls;
+};
+
+// Per frame data of type T, written straight into mapped memory. T has to match the layout the shaders read it with,
+// std140 for uniform blocks or std430 for storage buffers. Each frame, or each pass that needs its own copy, gets one
+// BeginFrame and one EndFrame around writing the data and issuing the commands that read it.
+template <typename T>
+class FrameRingBuffer : public RingBufferStorage
+{
+public:
+	// capacity is elements per frame, it grows if BeginFrame asks for more
+	explicit FrameRingBuffer(unsigned int capacity = 1)
+		: RingBufferStorage(sizeof(T), capacity)
+	{
+	}
+
+	T* BeginFrame(unsigned int count = 1) { return static_cast<T*>(BeginRegion(count)); }
+	void EndFrame() { EndRegion(); }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#include "Core/Simd.h"
+
+FrustumCuller::FrustumCuller()
+	: m_centerX()
+	, m_centerY()
+	, m_centerZ()
+	, m_extentX()
+	, m_extentY()
+	, m_extentZ()
+	, m_sphereX()
+	, m_sphereY()
+	, m_sphereZ()
+	, m_radius()
+	, m_visibility()
+	, m_numObjects(0)
+	, m_numVisible(0)
+	, m_numFrustumCulled(0)
+	, m_numSmallCulled(0)
+	, m_minScreenSize(0.0f)
+{
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
+
+void FrustumCuller::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_sphereX.clear();
+	m_sphereY.clear();
+	m_sphereZ.clear();
+	m_radius.clear();
+	m_visibility.clear();
+	m_numObjects = 0;
+}
+
+unsigned int FrustumCuller::Add(const AABB& aabb, const BoundingSphere& sphere)
+{
+	const glm::vec3 center = aabb.GetCenter();
+	const glm::vec3 extents = aabb.GetExtents();
+	m_centerX.push_back(center.x);
+	m_centerY.push_back(center.y);
+	m_centerZ.push_back(center.z);
+	m_extentX.push_back(extents.x);
+	m_extentY.push_back(extents.y);
+	m_extentZ.push_back(extents.z);
+	m_sphereX.push_back(sphere.center.x);
+	m_sphereY.push_back(sphere.center.y);
+	m_sphereZ.push_back(sphere.center.z);
+	m_radius.push_back(sphere.radius);
+	return m_numObjects++;
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, const glm::vec3& viewPosition, float projectionScale)
+{
+	// padding objects have no size at the origin, and are dropped again once the pass is done
+	const unsigned int numPadded = (m_numObjects + 3) & ~3u;
+	std::vector<float>* const arrays[] = { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_radius };
+	for (std::vector<float>* pArray : arrays)
+	{
+		pArray->resize(numPadded, 0.0f);
+	}
+	m_visibility.resize(numPadded);
+
+	// an object is too small when radius * scale / distance < minSize / 2, which squared avoids the sqrt. Objects
+	// the camera is inside have a distance under their radius, and are always big enough.
+	const float halfMinSize = m_minScreenSize * 0.5f;
+	const float minSizeSquared = halfMinSize * halfMinSize;
+	const float scaleSquared = projectionScale * projectionScale;
+
+#ifdef ORCA_SSE2
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	__m128 planeX[FP_COUNT], planeY[FP_COUNT], planeZ[FP_COUNT], planeD[FP_COUNT];
+	__m128 absPlaneX[FP_COUNT], absPlaneY[FP_COUNT], absPlaneZ[FP_COUNT];
+	for (unsigned int p = 0; p < FP_COUNT; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeD[p] = _mm_set1_ps(frustum.planes[p].w);
+		absPlaneX[p] = _mm_and_ps(planeX[p], signMask);
+		absPlaneY[p] = _mm_and_ps(planeY[p], signMask);
+		absPlaneZ[p] = _mm_and_ps(planeZ[p], signMask);
+	}
+	const __m128 viewX = _mm_set1_ps(viewPosition.x);
+	const __m128 viewY = _mm_set1_ps(viewPosition.y);
+	const __m128 viewZ = _mm_set1_ps(viewPosition.z);
+	const __m128 minSize = _mm_set1_ps(minSizeSquared);
+	const __m128 scale = _mm_set1_ps(scaleSquared);
+
+	for (unsigned int i = 0; i < numPadded; i += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&m_centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&m_centerY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&m_centerZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&m_extentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&m_extentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&m_extentZ[i]);
+
+		// outside a plane when the box's nearest corner is on the wrong side: distance + projected extent < 0
+		__m128 outside = _mm_setzero_ps();
+		for (unsigned int p = 0; p < FP_COUNT; ++p)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)), _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeD[p]));
+			const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], extentX), _mm_mul_ps(absPlaneY[p], extentY)), _mm_mul_ps(absPlaneZ[p], extentZ));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+
+		const __m128 offsetX = _mm_sub_ps(_mm_loadu_ps(&m_sphereX[i]), viewX);
+		const __m128 offsetY = _mm_sub_ps(_mm_loadu_ps(&m_sphereY[i]), viewY);
+		const __m128 offsetZ = _mm_sub_ps(_mm_loadu_ps(&m_sphereZ[i]), viewZ);
+		const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(offsetX, offsetX), _mm_mul_ps(offsetY, offsetY)), _mm_mul_ps(offsetZ, offsetZ));
+		const __m128 radius = _mm_loadu_ps(&m_radius[i]);
+		const __m128 radiusSquared = _mm_mul_ps(radius, radius);
+		const __m128 small = _mm_andnot_ps(_mm_cmple_ps(distanceSquared, radiusSquared), _mm_cmplt_ps(_mm_mul_ps(radiusSquared, scale), _mm_mul_ps(minSize, distanceSquared)));
+
+		const int outsideMask = _mm_movemask_ps(outside);
+		const int smallMask = _mm_movemask_ps(small);
+		for (unsigned int j = 0; j < 4; ++j)
+		{
+			m_visibility[i + j] = (outsideMask >> j) & 1 ? CR_FRUSTUM_CULLED : ((smallMask >> j) & 1 ? CR_SMALL_CULLED : CR_VISIBLE);
+		}
+	}
+#else
+	for (unsigned int i = 0; i < numPadded; ++i)
+	{
+		bool bOutside = false;
+		for (unsigned int p = 0; p < FP_COUNT && !bOutside; ++p)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			const float distance = plane.x * m_centerX[i] + plane.y * m_centerY[i] + plane.z * m_centerZ[i] + plane.w;
+			const float radius = std::fabs(plane.x) * m_extentX[i] + std::fabs(plane.y) * m_extentY[i] + std::fabs(plane.z) * m_extentZ[i];
+			bOutside = distance + radius < 0.0f;
+		}
+
+		const float offsetX = m_sphereX[i] - viewPosition.x;
+		const float offsetY = m_sphereY[i] - viewPosition.y;
+		const float offsetZ = m_sphereZ[i] - viewPosition.z;
+		const float distanceSquared = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ;
+		const float radiusSquared = m_radius[i] * m_radius[i];
+		const bool bSmall = !(distanceSquared <= radiusSquared) && radiusSquared * scaleSquared < minSizeSquared * distanceSquared;
+
+		m_visibility[i] = bOutside ? CR_FRUSTUM_CULLED : (bSmall ? CR_SMALL_CULLED : CR_VISIBLE);
+	}
+#endif
+
+	m_numVisible = 0;
+	m_numFrustumCulled = 0;
+	m_numSmallCulled = 0;
+	for (unsigned int i = 0; i < m_numObjects; ++i)
+	{
+		m_numVisible += m_visibility[i] == CR_VISIBLE;
+		m_numFrustumCulled += m_visibility[i] == CR_FRUSTUM_CULLED;
+		m_numSmallCulled += m_visibility[i] == CR_SMALL_CULLED;
+	}
+
+	for (std::vector<float>* pArray : arrays)
+	{
+		pArray->resize(m_numObjects);
+	}
+}
\ No newline at end of file
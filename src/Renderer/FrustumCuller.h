@@ -0,0 +1,70 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+enum CullResult
+{
+	CR_FRUSTUM_CULLED,
+	CR_VISIBLE,
+	CR_SMALL_CULLED,
+};
+
+// Tests a frame's worth of world space bounds against the view frustum in one pass. Bounds are kept as structure
+// of arrays, so four objects are tested at once against each plane. An object is culled when its box is fully
+// outside any plane, or when its bounding sphere covers fewer pixels on screen than the minimum size.
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	void Clear();
+	// returns the index to look the result up with after Cull
+	unsigned int Add(const AABB& aabb, const BoundingSphere& sphere);
+
+	// projectionScale is the projected size of one unit one unit in front of the camera, in pixels: the projection
+	// matrix's [1][1] times half the viewport height
+	void Cull(const Frustum& frustum, const glm::vec3& viewPosition, float projectionScale);
+
+	CullResult GetResult(unsigned int index) const { return static_cast<CullResult>(m_visibility[index]); }
+	bool IsVisible(unsigned int index) const { return m_visibility[index] == CR_VISIBLE; }
+
+	unsigned int GetNumObjects() const { return m_numObjects; }
+	// counts from the last Cull. Objects outside the frustum are never counted as too small.
+	unsigned int GetNumVisible() const { return m_numVisible; }
+	unsigned int GetNumFrustumCulled() const { return m_numFrustumCulled; }
+	unsigned int GetNumSmallCulled() const { return m_numSmallCulled; }
+
+	// on screen diameter in pixels an object has to reach to be drawn, 0 disables the test
+	float GetMinScreenSize() const { return m_minScreenSize; }
+	void SetMinScreenSize(float pixels) { m_minScreenSize = pixels; }
+
+private:
+	// box centres and extents, and sphere centres and radii
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+	std::vector<float> m_sphereX;
+	std::vector<float> m_sphereY;
+	std::vector<float> m_sphereZ;
+	std::vector<float> m_radius;
+	// CullResults, padded to a multiple of 4
+	std::vector<uint8_t> m_visibility;
+	unsigned int m_numObjects;
+
+	unsigned int m_numVisible;
+	unsigned int m_numFrustumCulled;
+	unsigned int m_numSmallCulled;
+	float m_minScreenSize;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "GLStateCache.h"
+
+namespace
+{
+	// never a valid name or enum, so the first call after an invalidate always goes through
+	const GLuint UNKNOWN_STATE = ~0u;
+}
+
+GLStateCache* GLStateCache::s_instance = nullptr;
+
+GLStateCache::GLStateCache()
+	: m_program(UNKNOWN_STATE)
+	, m_vertexArray(UNKNOWN_STATE)
+	, m_textures()
+	, m_samplers()
+	, m_buffers()
+	, m_uniformBuffers()
+	, m_storageBuffers()
+	, m_capabilities()
+	, m_depthMask(-1)
+	, m_colorMask(-1)
+	, m_depthFunc(UNKNOWN_STATE)
+	, m_blendSrcFactor(UNKNOWN_STATE)
+	, m_blendDstFactor(UNKNOWN_STATE)
+	, m_cullFace(UNKNOWN_STATE)
+	, m_frameStats()
+	, m_lastFrameStats()
+{
+	Invalidate();
+}
+
+GLStateCache::~GLStateCache()
+{
+}
+
+GLStateCache* GLStateCache::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new GLStateCache();
+	}
+	return s_instance;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (Filter(m_program == program))
+	{
+		return;
+	}
+
+	glUseProgram(program);
+	m_program = program;
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (Filter(m_vertexArray == vertexArray))
+	{
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	m_vertexArray = vertexArray;
+}
+
+void GLStateCache::BindTexture(unsigned int unit, GLuint texture)
+{
+	if (unit < MAX_CACHED_TEXTURE_UNITS)
+	{
+		if (Filter(m_textures[unit] == texture))
+		{
+			return;
+		}
+		m_textures[unit] = texture;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	glBindTextureUnit(unit, texture);
+}
+
+void GLStateCache::BindSampler(unsigned int unit, GLuint sampler)
+{
+	if (unit < MAX_CACHED_TEXTURE_UNITS)
+	{
+		if (Filter(m_samplers[unit] == sampler))
+		{
+			return;
+		}
+		m_samplers[unit] = sampler;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	glBindSampler(unit, sampler);
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	const int bufferTarget = GetBufferTarget(target);
+	if (bufferTarget >= 0)
+	{
+		if (Filter(m_buffers[bufferTarget] == buffer))
+		{
+			return;
+		}
+		m_buffers[bufferTarget] = buffer;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	glBindBuffer(target, buffer);
+}
+
+void GLStateCache::BindBufferRange(GLenum target, unsigned int index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	BufferRange* pBindings = GetIndexedBuffers(target);
+	if (pBindings && index < MAX_CACHED_BUFFER_BINDINGS)
+	{
+		BufferRange& binding = pBindings[index];
+		if (Filter(binding.buffer == buffer && binding.offset == offset && binding.size == size))
+		{
+			return;
+		}
+		binding.buffer = buffer;
+		binding.offset = offset;
+		binding.size = size;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	glBindBufferRange(target, index, buffer, offset, size);
+
+	// binding to an indexed point binds to the generic one too
+	const int bufferTarget = GetBufferTarget(target);
+	if (bufferTarget >= 0)
+	{
+		m_buffers[bufferTarget] = buffer;
+	}
+}
+
+void GLStateCache::BindBufferBase(GLenum target, unsigned int index, GLuint buffer)
+{
+	// a size of 0 stands for the whole buffer, which a range can never be
+	BufferRange* pBindings = GetIndexedBuffers(target);
+	if (pBindings && index < MAX_CACHED_BUFFER_BINDINGS)
+	{
+		BufferRange& binding = pBindings[index];
+		if (Filter(binding.buffer == buffer && binding.offset == 0 && binding.size == 0))
+		{
+			return;
+		}
+		binding.buffer = buffer;
+		binding.offset = 0;
+		binding.size = 0;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	glBindBufferBase(target, index, buffer);
+
+	const int bufferTarget = GetBufferTarget(target);
+	if (bufferTarget >= 0)
+	{
+		m_buffers[bufferTarget] = buffer;
+	}
+}
+
+void GLStateCache::SetEnabled(GLenum capability, bool bEnabled)
+{
+	const int cap = GetCapability(capability);
+	if (cap >= 0)
+	{
+		if (Filter(m_capabilities[cap] == static_cast<int>(bEnabled)))
+		{
+			return;
+		}
+		m_capabilities[cap] = bEnabled;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	if (bEnabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+void GLStateCache::SetDepthMask(bool bWrite)
+{
+	if (Filter(m_depthMask == static_cast<int>(bWrite)))
+	{
+		return;
+	}
+
+	glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+	m_depthMask = bWrite;
+}
+
+void GLStateCache::SetColorMask(bool bWrite)
+{
+	if (Filter(m_colorMask == static_cast<int>(bWrite)))
+	{
+		return;
+	}
+
+	const GLboolean write = bWrite ? GL_TRUE : GL_FALSE;
+	glColorMask(write, write, write, write);
+	m_colorMask = bWrite;
+}
+
+void GLStateCache::SetDepthFunc(GLenum func)
+{
+	if (Filter(m_depthFunc == func))
+	{
+		return;
+	}
+
+	glDepthFunc(func);
+	m_depthFunc = func;
+}
+
+void GLStateCache::SetBlendFunc(GLenum srcFactor, GLenum dstFactor)
+{
+	if (Filter(m_blendSrcFactor == srcFactor && m_blendDstFactor == dstFactor))
+	{
+		return;
+	}
+
+	glBlendFunc(srcFactor, dstFactor);
+	m_blendSrcFactor = srcFactor;
+	m_blendDstFactor = dstFactor;
+}
+
+void GLStateCache::SetCullFace(GLenum face)
+{
+	if (Filter(m_cullFace == face))
+	{
+		return;
+	}
+
+	glCullFace(face);
+	m_cullFace = face;
+}
+
+void GLStateCache::OnProgramDeleted(GLuint program)
+{
+	// unlike other objects, a deleted program stays in use until something else is, so only forget it
+	if (m_program == program)
+	{
+		m_program = UNKNOWN_STATE;
+	}
+}
+
+void GLStateCache::OnVertexArrayDeleted(GLuint vertexArray)
+{
+	if (m_vertexArray == vertexArray)
+	{
+		m_vertexArray = 0;
+	}
+}
+
+void GLStateCache::OnTextureDeleted(GLuint texture)
+{
+	for (GLuint& boundTexture : m_textures)
+	{
+		if (boundTexture == texture)
+		{
+			boundTexture = 0;
+		}
+	}
+}
+
+void GLStateCache::OnSamplerDeleted(GLuint sampler)
+{
+	for (GLuint& boundSampler : m_samplers)
+	{
+		if (boundSampler == sampler)
+		{
+			boundSampler = 0;
+		}
+	}
+}
+
+void GLStateCache::OnBufferDeleted(GLuint buffer)
+{
+	for (GLuint& boundBuffer : m_buffers)
+	{
+		if (boundBuffer == buffer)
+		{
+			boundBuffer = 0;
+		}
+	}
+
+	auto ResetBindings = [buffer](BufferRange* pBindings)
+	{
+		for (unsigned int i = 0; i < MAX_CACHED_BUFFER_BINDINGS; ++i)
+		{
+			if (pBindings[i].buffer == buffer)
+			{
+				pBindings[i] = BufferRange{ 0, 0, 0 };
+			}
+		}
+	};
+	ResetBindings(m_uniformBuffers);
+	ResetBindings(m_storageBuffers);
+}
+
+void GLStateCache::Invalidate()
+{
+	m_program = UNKNOWN_STATE;
+	m_vertexArray = UNKNOWN_STATE;
+	for (unsigned int i = 0; i < MAX_CACHED_TEXTURE_UNITS; ++i)
+	{
+		m_textures[i] = UNKNOWN_STATE;
+		m_samplers[i] = UNKNOWN_STATE;
+	}
+	for (GLuint& buffer : m_buffers)
+	{
+		buffer = UNKNOWN_STATE;
+	}
+	for (unsigned int i = 0; i < MAX_CACHED_BUFFER_BINDINGS; ++i)
+	{
+		m_uniformBuffers[i] = BufferRange{ UNKNOWN_STATE, 0, 0 };
+		m_storageBuffers[i] = BufferRange{ UNKNOWN_STATE, 0, 0 };
+	}
+
+	for (int& capability : m_capabilities)
+	{
+		capability = -1;
+	}
+	m_depthMask = -1;
+	m_colorMask = -1;
+	m_depthFunc = UNKNOWN_STATE;
+	m_blendSrcFactor = UNKNOWN_STATE;
+	m_blendDstFactor = UNKNOWN_STATE;
+	m_cullFace = UNKNOWN_STATE;
+}
+
+void GLStateCache::BeginFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats = GLStateStats();
+}
+
+bool GLStateCache::Filter(bool bRedundant)
+{
+	if (bRedundant)
+	{
+		++m_frameStats.numFiltered;
+	}
+	else
+	{
+		++m_frameStats.numIssued;
+	}
+	return bRedundant;
+}
+
+int GLStateCache::GetBufferTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return BT_ARRAY;
+	case GL_UNIFORM_BUFFER:
+		return BT_UNIFORM;
+	case GL_SHADER_STORAGE_BUFFER:
+		return BT_SHADER_STORAGE;
+	case GL_DRAW_INDIRECT_BUFFER:
+		return BT_DRAW_INDIRECT;
+	case GL_DISPATCH_INDIRECT_BUFFER:
+		return BT_DISPATCH_INDIRECT;
+	case GL_PARAMETER_BUFFER:
+		return BT_PARAMETER;
+	case GL_PIXEL_UNPACK_BUFFER:
+		return BT_PIXEL_UNPACK;
+	case GL_COPY_READ_BUFFER:
+		return BT_COPY_READ;
+	case GL_COPY_WRITE_BUFFER:
+		return BT_COPY_WRITE;
+	default:
+		return -1;
+	}
+}
+
+int GLStateCache::GetCapability(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST:
+		return CAP_DEPTH_TEST;
+	case GL_BLEND:
+		return CAP_BLEND;
+	case GL_CULL_FACE:
+		return CAP_CULL_FACE;
+	case GL_SCISSOR_TEST:
+		return CAP_SCISSOR_TEST;
+	case GL_STENCIL_TEST:
+		return CAP_STENCIL_TEST;
+	default:
+		return -1;
+	}
+}
+
+GLStateCache::BufferRange* GLStateCache::GetIndexedBuffers(GLenum target)
+{
+	switch (target)
+	{
+	case GL_UNIFORM_BUFFER:
+		return m_uniformBuffers;
+	case GL_SHADER_STORAGE_BUFFER:
+		return m_storageBuffers;
+	default:
+		return nullptr;
+	}
+}
\ No newline at end of file
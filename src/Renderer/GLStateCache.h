@@ -0,0 +1,132 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+// units and indexed binding points past these aren't shadowed, calls for them always go through
+const unsigned int MAX_CACHED_TEXTURE_UNITS = 32;
+const unsigned int MAX_CACHED_BUFFER_BINDINGS = 16;
+
+struct GLStateStats
+{
+	// state calls that reached GL
+	unsigned int numIssued = 0;
+	// state calls dropped because GL was already in the requested state
+	unsigned int numFiltered = 0;
+};
+
+// Shadows the GL state the renderer changes, so setting something that's already set never reaches the driver. All
+// binds and fixed-function state changes go through here rather than straight to GL, otherwise the shadow copy goes
+// stale. Anything that changes state behind its back has to call Invalidate.
+//
+// Textures are bound with glBindTextureUnit, so the active texture unit is never touched, and uniform and shader
+// storage buffers are tracked per indexed binding point along with the range bound to each.
+class GLStateCache
+{
+public:
+	~GLStateCache();
+
+	// needs a current GL context
+	static GLStateCache* GetInstance();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vertexArray);
+	void BindTexture(unsigned int unit, GLuint texture);
+	void BindSampler(unsigned int unit, GLuint sampler);
+
+	// element array buffers belong to the bound vertex array, so they're passed straight through
+	void BindBuffer(GLenum target, GLuint buffer);
+	// GL_UNIFORM_BUFFER and GL_SHADER_STORAGE_BUFFER only
+	void BindBufferRange(GLenum target, unsigned int index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void BindBufferBase(GLenum target, unsigned int index, GLuint buffer);
+
+	// GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST and GL_STENCIL_TEST are shadowed
+	void SetEnabled(GLenum capability, bool bEnabled);
+	void SetDepthMask(bool bWrite);
+	// all four channels together
+	void SetColorMask(bool bWrite);
+	void SetDepthFunc(GLenum func);
+	void SetBlendFunc(GLenum srcFactor, GLenum dstFactor);
+	void SetCullFace(GLenum face);
+
+	// GL unbinds a deleted object everywhere it was bound, and names get reused, so these have to be called whenever
+	// one is deleted
+	void OnProgramDeleted(GLuint program);
+	void OnVertexArrayDeleted(GLuint vertexArray);
+	void OnTextureDeleted(GLuint texture);
+	void OnSamplerDeleted(GLuint sampler);
+	void OnBufferDeleted(GLuint buffer);
+
+	// forgets everything, so the next call for each piece of state always goes through
+	void Invalidate();
+
+	// call at the start of each frame. Stats for the frame just finished move to GetLastFrameStats.
+	void BeginFrame();
+	const GLStateStats& GetLastFrameStats() const { return m_lastFrameStats; }
+
+private:
+	enum BufferTarget
+	{
+		BT_ARRAY,
+		BT_UNIFORM,
+		BT_SHADER_STORAGE,
+		BT_DRAW_INDIRECT,
+		BT_DISPATCH_INDIRECT,
+		BT_PARAMETER,
+		BT_PIXEL_UNPACK,
+		BT_COPY_READ,
+		BT_COPY_WRITE,
+		BT_COUNT,
+	};
+
+	enum Capability
+	{
+		CAP_DEPTH_TEST,
+		CAP_BLEND,
+		CAP_CULL_FACE,
+		CAP_SCISSOR_TEST,
+		CAP_STENCIL_TEST,
+		CAP_COUNT,
+	};
+
+	struct BufferRange
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	GLStateCache();
+
+	// counts the call and returns true if it should be dropped
+	bool Filter(bool bRedundant);
+
+	static int GetBufferTarget(GLenum target);
+	static int GetCapability(GLenum capability);
+	// m_uniformBuffers or m_storageBuffers, or null for targets without indexed binding points
+	BufferRange* GetIndexedBuffers(GLenum target);
+
+	GLuint m_program;
+	GLuint m_vertexArray;
+	GLuint m_textures[MAX_CACHED_TEXTURE_UNITS];
+	GLuint m_samplers[MAX_CACHED_TEXTURE_UNITS];
+	GLuint m_buffers[BT_COUNT];
+	BufferRange m_uniformBuffers[MAX_CACHED_BUFFER_BINDINGS];
+	BufferRange m_storageBuffers[MAX_CACHED_BUFFER_BINDINGS];
+
+	// 0 or 1, or -1 when unknown
+	int m_capabilities[CAP_COUNT];
+	int m_depthMask;
+	int m_colorMask;
+	GLenum m_depthFunc;
+	GLenum m_blendSrcFactor;
+	GLenum m_blendDstFactor;
+	GLenum m_cullFace;
+
+	GLStateStats m_frameStats;
+	GLStateStats m_lastFrameStats;
+
+	static GLStateCache* s_instance;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "GeometryPool.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "DrawData.h"
+#include "GLStateCache.h"
+#include "Mesh.h"
+
+namespace
+{
+	// enough for a few medium sized models before either pool has to grow
+	const unsigned int INITIAL_VERTEX_CAPACITY = 1 << 18;
+	const unsigned int INITIAL_INDEX_CAPACITY = 1 << 20;
+
+	// compaction starts once this much of a pool's free space is outside its largest free block
+	const float COMPACT_FRAGMENTATION = 0.25f;
+	// elements copied per frame while compacting, to keep it from causing a hitch
+	const unsigned int MAX_COMPACT_VERTICES = 1 << 16;
+	const unsigned int MAX_COMPACT_INDICES = 1 << 18;
+
+	const unsigned int VERTEX_BINDING = 0;
+	const unsigned int DRAW_ID_BINDING = 1;
+	const unsigned int DRAW_ID_ATTRIBUTE = 3;
+
+	void UpdatePool(GpuBufferPool& pool, unsigned int maxCompactElements)
+	{
+		if (pool.GetFragmentation() > COMPACT_FRAGMENTATION && pool.Compact(maxCompactElements))
+		{
+			return;
+		}
+		pool.Trim();
+	}
+}
+
+GeometryPool* GeometryPool::s_instance = nullptr;
+
+GeometryPool::GeometryPool()
+	: m_vertexPool(sizeof(Mesh::Vertex), INITIAL_VERTEX_CAPACITY)
+	, m_indexPool(sizeof(unsigned int), INITIAL_INDEX_CAPACITY)
+	, m_vao(0)
+	, m_drawIdBuffer(0)
+	, m_boundVertexBuffer(0)
+	, m_boundIndexBuffer(0)
+{
+	std::vector<unsigned int> drawIds(MAX_DRAW_IDS);
+	for (unsigned int i = 0; i < MAX_DRAW_IDS; ++i)
+	{
+		drawIds[i] = i;
+	}
+	glCreateBuffers(1, &m_drawIdBuffer);
+	glNamedBufferStorage(m_drawIdBuffer, drawIds.size() * sizeof(unsigned int), drawIds.data(), 0);
+
+	glCreateVertexArrays(1, &m_vao);
+	glVertexArrayVertexBuffer(m_vao, DRAW_ID_BINDING, m_drawIdBuffer, 0, sizeof(unsigned int));
+	glVertexArrayBindingDivisor(m_vao, DRAW_ID_BINDING, 1);
+
+	// position, normal, uvs, then the draw id
+	glEnableVertexArrayAttrib(m_vao, 0);
+	glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Mesh::Vertex, position));
+	glVertexArrayAttribBinding(m_vao, 0, VERTEX_BINDING);
+	glEnableVertexArrayAttrib(m_vao, 1);
+	glVertexArrayAttribFormat(m_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Mesh::Vertex, normal));
+	glVertexArrayAttribBinding(m_vao, 1, VERTEX_BINDING);
+	glEnableVertexArrayAttrib(m_vao, 2);
+	glVertexArrayAttribFormat(m_vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Mesh::Vertex, texCoords));
+	glVertexArrayAttribBinding(m_vao, 2, VERTEX_BINDING);
+	glEnableVertexArrayAttrib(m_vao, DRAW_ID_ATTRIBUTE);
+	glVertexArrayAttribIFormat(m_vao, DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0);
+	glVertexArrayAttribBinding(m_vao, DRAW_ID_ATTRIBUTE, DRAW_ID_BINDING);
+}
+
+GeometryPool::~GeometryPool()
+{
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	pStateCache->OnVertexArrayDeleted(m_vao);
+	pStateCache->OnBufferDeleted(m_drawIdBuffer);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_drawIdBuffer);
+}
+
+GeometryPool* GeometryPool::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new GeometryPool();
+	}
+
+	return s_instance;
+}
+
+unsigned int GeometryPool::GetVertexArray()
+{
+	if (m_boundVertexBuffer != m_vertexPool.GetBuffer())
+	{
+		m_boundVertexBuffer = m_vertexPool.GetBuffer();
+		glVertexArrayVertexBuffer(m_vao, VERTEX_BINDING, m_boundVertexBuffer, 0, sizeof(Mesh::Vertex));
+	}
+	if (m_boundIndexBuffer != m_indexPool.GetBuffer())
+	{
+		m_boundIndexBuffer = m_indexPool.GetBuffer();
+		glVertexArrayElementBuffer(m_vao, m_boundIndexBuffer);
+	}
+	return m_vao;
+}
+
+void GeometryPool::Update()
+{
+	UpdatePool(m_vertexPool, MAX_COMPACT_VERTICES);
+	UpdatePool(m_indexPool, MAX_COMPACT_INDICES);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "GpuBufferPool.h"
+
+// The vertices and indices of every MeshBuffer, suballocated from one vertex and one index buffer behind a single
+// vertex array, so draws of any two meshes can share a multi draw and loading or unloading a model never creates or
+// deletes GL buffers of its own.
+//
+// Besides the Mesh::Vertex attributes, the vertex array has an instanced uint attribute at location 3 counting up
+// from 0. A draw's base instance offsets it, which is how shaders built with SF_DRAW_DATA find their per draw data
+// without needing gl_DrawID.
+//
+// Update compacts whichever pool has grown fragmented a bit at a time, so meshes' base vertices and first indices
+// can change from one frame to the next. Anything keeping them across frames has to check GetGeneration.
+class GeometryPool
+{
+public:
+	~GeometryPool();
+
+	// needs a current GL context
+	static GeometryPool* GetInstance();
+
+	// elements are Mesh::Vertex and unsigned int indices respectively
+	GpuBufferPool& GetVertexPool() { return m_vertexPool; }
+	GpuBufferPool& GetIndexPool() { return m_indexPool; }
+
+	// rebinds the pools' buffers first if either has been reallocated
+	unsigned int GetVertexArray();
+	// changes whenever a range in either pool moves
+	unsigned int GetGeneration() const { return m_vertexPool.GetGeneration() + m_indexPool.GetGeneration(); }
+
+	// once a frame, before anything is submitted
+	void Update();
+
+private:
+	GeometryPool();
+
+	GpuBufferPool m_vertexPool;
+	GpuBufferPool m_indexPool;
+
+	unsigned int m_vao;
+	// 0..MAX_DRAW_IDS-1
+	unsigned int m_drawIdBuffer;
+	// what m_vao was last pointed at
+	unsigned int m_boundVertexBuffer;
+	unsigned int m_boundIndexBuffer;
+
+	static GeometryPool* s_instance;
+};
+
+#endif
\ No newline at end of file
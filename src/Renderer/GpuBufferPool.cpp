@@ -0,0 +1,181 @@
+#include "GpuBufferPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include <glad/glad.h>
+
+#include "GLStateCache.h"
+
+GpuBufferPool::GpuBufferPool(unsigned int elementSize, unsigned int initialCapacity)
+	: m_allocator()
+	, m_handleNodes()
+	, m_nodeHandles()
+	, m_unusedHandles()
+	, m_elementSize(elementSize)
+	, m_initialCapacity(std::max(initialCapacity, 1u))
+	, m_buffer(0)
+	, m_generation(0)
+	, m_bCompacted(false)
+{
+	Resize(m_initialCapacity);
+}
+
+GpuBufferPool::~GpuBufferPool()
+{
+	GLStateCache::GetInstance()->OnBufferDeleted(m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+}
+
+unsigned int GpuBufferPool::Allocate(const void* pData, unsigned int count)
+{
+	if (count == 0)
+	{
+		return INVALID_POOL_HANDLE;
+	}
+
+	unsigned int node = m_allocator.Allocate(count);
+	while (node == TLSF_INVALID_NODE)
+	{
+		// the largest free block could be at the end, so growing by count is always enough
+		const uint64_t newCapacity = std::max(static_cast<uint64_t>(GetCapacity()) * 2, static_cast<uint64_t>(GetCapacity()) + count);
+		if (newCapacity * m_elementSize > 0xFFFFFFFFull)
+		{
+			printf("Error. GPU buffer pool out of memory allocating %u elements of %u bytes\n", count, m_elementSize);
+			return INVALID_POOL_HANDLE;
+		}
+		Resize(static_cast<unsigned int>(newCapacity));
+		node = m_allocator.Allocate(count);
+	}
+
+	unsigned int handle = 0;
+	if (!m_unusedHandles.empty())
+	{
+		handle = m_unusedHandles.back();
+		m_unusedHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<unsigned int>(m_handleNodes.size());
+		m_handleNodes.push_back(TLSF_INVALID_NODE);
+	}
+	m_handleNodes[handle] = node;
+	m_nodeHandles.resize(m_allocator.GetNodeCapacity(), INVALID_POOL_HANDLE);
+	m_nodeHandles[node] = handle;
+	// the new range may have gone past a hole it would fit in
+	m_bCompacted = false;
+
+	if (pData)
+	{
+		glNamedBufferSubData(m_buffer, static_cast<GLintptr>(m_allocator.GetOffset(node)) * m_elementSize, static_cast<GLsizeiptr>(count) * m_elementSize, pData);
+	}
+	return handle;
+}
+
+void GpuBufferPool::Free(unsigned int handle)
+{
+	const unsigned int node = m_handleNodes[handle];
+	m_allocator.Free(node);
+	m_nodeHandles[node] = INVALID_POOL_HANDLE;
+	m_handleNodes[handle] = TLSF_INVALID_NODE;
+	m_unusedHandles.push_back(handle);
+	m_bCompacted = false;
+}
+
+bool GpuBufferPool::Compact(unsigned int maxElements)
+{
+	if (m_bCompacted)
+	{
+		return false;
+	}
+
+	unsigned int numMoved = 0;
+	unsigned int node = m_allocator.GetLastNode();
+	while (node != TLSF_INVALID_NODE && numMoved < maxElements)
+	{
+		// still valid after the move, it either stays where it is, becomes the moved range or absorbs the freed one
+		const unsigned int prev = m_allocator.GetPreviousNode(node);
+		if (!m_allocator.IsUsed(node))
+		{
+			node = prev;
+			continue;
+		}
+
+		// the destination is picked by address, a block the lists would hand out could just as well be later on. It's
+		// before the old range, so the two can't overlap.
+		const unsigned int size = m_allocator.GetSize(node);
+		const unsigned int freeNode = m_allocator.FindLowestFreeBefore(node, size);
+		if (freeNode == TLSF_INVALID_NODE)
+		{
+			node = prev;
+			continue;
+		}
+		const unsigned int newNode = m_allocator.AllocateFrom(freeNode, size);
+
+		glCopyNamedBufferSubData(m_buffer, m_buffer, static_cast<GLintptr>(m_allocator.GetOffset(node)) * m_elementSize, static_cast<GLintptr>(m_allocator.GetOffset(newNode)) * m_elementSize, static_cast<GLsizeiptr>(size) * m_elementSize);
+
+		const unsigned int handle = m_nodeHandles[node];
+		m_nodeHandles.resize(m_allocator.GetNodeCapacity(), INVALID_POOL_HANDLE);
+		m_nodeHandles[newNode] = handle;
+		m_handleNodes[handle] = newNode;
+		m_nodeHandles[node] = INVALID_POOL_HANDLE;
+		m_allocator.Free(node);
+		numMoved += size;
+		node = prev;
+	}
+
+	// a full pass that moved nothing won't move anything next time either, until something else changes
+	m_bCompacted = numMoved == 0;
+	if (numMoved > 0)
+	{
+		++m_generation;
+	}
+	return numMoved > 0;
+}
+
+bool GpuBufferPool::Trim()
+{
+	unsigned int newCapacity = GetCapacity();
+	while (newCapacity / 2 >= m_initialCapacity && m_allocator.GetUsedEnd() <= newCapacity / 4)
+	{
+		newCapacity /= 2;
+	}
+	if (newCapacity == GetCapacity())
+	{
+		return false;
+	}
+
+	Resize(newCapacity);
+	return true;
+}
+
+void GpuBufferPool::Resize(unsigned int newCapacity)
+{
+	unsigned int buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, static_cast<GLsizeiptr>(newCapacity) * m_elementSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	if (m_buffer)
+	{
+		// only up to the end of the last range, the rest is free
+		const unsigned int numCopied = std::min(m_allocator.GetUsedEnd(), newCapacity);
+		if (numCopied > 0)
+		{
+			glCopyNamedBufferSubData(m_buffer, buffer, 0, 0, static_cast<GLsizeiptr>(numCopied) * m_elementSize);
+		}
+		GLStateCache::GetInstance()->OnBufferDeleted(m_buffer);
+		glDeleteBuffers(1, &m_buffer);
+	}
+	m_buffer = buffer;
+
+	if (newCapacity > GetCapacity())
+	{
+		m_allocator.Grow(newCapacity);
+	}
+	else
+	{
+		m_allocator.Shrink(newCapacity);
+	}
+	++m_generation;
+}
\ No newline at end of file
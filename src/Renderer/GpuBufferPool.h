@@ -0,0 +1,61 @@
+#ifndef GPU_BUFFER_POOL_H
+#define GPU_BUFFER_POOL_H
+
+#include <vector>
+
+#include "Core/TlsfAllocator.h"
+
+const unsigned int INVALID_POOL_HANDLE = 0xFFFFFFFF;
+
+// Ranges of one immutable GL buffer, suballocated with a TLSF allocator in units of elementSize bytes. Running out of
+// room moves everything to a buffer twice the size, and Compact moves ranges from the end of the buffer into holes
+// nearer the start, so the free space gathers into one block at the end again and Trim can give it back.
+//
+// A range is identified by a handle that stays the same until it's freed, but its offset changes whenever it's
+// moved, so it has to be looked up again after Compact, Trim or an Allocate that grew the buffer. GetGeneration
+// changes every time that happens, as does GetBuffer when it's a new buffer.
+class GpuBufferPool
+{
+public:
+	GpuBufferPool(unsigned int elementSize, unsigned int initialCapacity);
+	~GpuBufferPool();
+
+	// copies count elements from pData, which can be null to leave them undefined
+	unsigned int Allocate(const void* pData, unsigned int count);
+	void Free(unsigned int handle);
+
+	// in elements
+	unsigned int GetOffset(unsigned int handle) const { return m_allocator.GetOffset(m_handleNodes[handle]); }
+
+	// moves ranges, last first, into the lowest hole before them that fits until maxElements have been copied or none
+	// fit. Returns whether anything moved, and doesn't look again after a pass that moved nothing until the next
+	// Allocate or Free.
+	bool Compact(unsigned int maxElements);
+	// halves the buffer while what's used fits in a quarter of it, but never below the initial capacity
+	bool Trim();
+
+	unsigned int GetBuffer() const { return m_buffer; }
+	unsigned int GetGeneration() const { return m_generation; }
+	// in elements
+	unsigned int GetCapacity() const { return m_allocator.GetCapacity(); }
+	unsigned int GetUsedSize() const { return m_allocator.GetUsedSize(); }
+	float GetFragmentation() const { return m_allocator.GetFragmentation(); }
+
+private:
+	void Resize(unsigned int newCapacity);
+
+	TlsfAllocator m_allocator;
+	// the allocator's node for each handle and the handle for each used node, as nodes change when ranges move
+	std::vector<unsigned int> m_handleNodes;
+	std::vector<unsigned int> m_nodeHandles;
+	std::vector<unsigned int> m_unusedHandles;
+
+	unsigned int m_elementSize;
+	unsigned int m_initialCapacity;
+	unsigned int m_buffer;
+	unsigned int m_generation;
+	// the last Compact found nothing to move and nothing has changed since
+	bool m_bCompacted;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+#include <glad/glad.h>
+
+#include "Camera.h"
+#include "GLStateCache.h"
+#include "GeometryPool.h"
+#include "Material.h"
+#include "ShaderManager.h"
+#include "TextureImage.h"
+
+namespace
+{
+	const char* const CULL_SHADER = "assets/shaders/gpu_cull.comp";
+	const char* const DEPTH_PYRAMID_SHADER = "assets/shaders/depth_pyramid.comp";
+
+	// local sizes of the two compute shaders
+	const unsigned int CULL_GROUP_SIZE = 64;
+	const unsigned int PYRAMID_GROUP_SIZE = 8;
+
+	// storage buffer bindings, matching the shaders
+	const unsigned int DRAWS_BINDING = 0;
+	const unsigned int COMMANDS_BINDING = 1;
+	const unsigned int COUNTS_BINDING = 2;
+	const unsigned int GROUP_OFFSETS_BINDING = 3;
+	const unsigned int OCCLUDED_BINDING = 4;
+
+	void DeleteBuffer(unsigned int& buffer)
+	{
+		if (buffer)
+		{
+			GLStateCache::GetInstance()->OnBufferDeleted(buffer);
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+	}
+
+	void DeleteTexture(unsigned int& texture)
+	{
+		if (texture)
+		{
+			GLStateCache::GetInstance()->OnTextureDeleted(texture);
+			glDeleteTextures(1, &texture);
+			texture = 0;
+		}
+	}
+}
+
+GpuDrawList::GpuDrawList()
+	: m_draws()
+	, m_groups()
+	, m_meshes()
+	, m_geometryGeneration(0)
+	, m_drawBuffer(0)
+	, m_commandBuffers()
+	, m_countBuffers()
+	, m_groupOffsetBuffer(0)
+	, m_occludedBuffer(0)
+	, m_bHasOccluded(false)
+{
+}
+
+GpuDrawList::~GpuDrawList()
+{
+	Clear();
+}
+
+void GpuDrawList::Create(const std::vector<Mesh*>& meshes)
+{
+	Clear();
+
+	std::vector<const Mesh*> sortedMeshes;
+	for (const Mesh* pMesh : meshes)
+	{
+		if (!pMesh->GetMaterial()->IsTranslucent())
+		{
+			sortedMeshes.push_back(pMesh);
+		}
+	}
+	if (sortedMeshes.empty())
+	{
+		return;
+	}
+	if (sortedMeshes.size() > MAX_DRAW_IDS)
+	{
+		printf("Error. Too many meshes (%zu) for a GPU draw list, the limit is %u\n", sortedMeshes.size(), MAX_DRAW_IDS);
+		return;
+	}
+
+	// one group per material
+	std::stable_sort(sortedMeshes.begin(), sortedMeshes.end(), [](const Mesh* pA, const Mesh* pB)
+	{
+		return pA->GetMaterial()->GetId() < pB->GetMaterial()->GetId();
+	});
+
+	m_meshes = sortedMeshes;
+	m_geometryGeneration = GeometryPool::GetInstance()->GetGeneration();
+	m_draws.resize(sortedMeshes.size());
+	for (unsigned int i = 0; i < sortedMeshes.size(); ++i)
+	{
+		const Mesh* pMesh = sortedMeshes[i];
+		if (m_groups.empty() || m_groups.back().pMaterial != pMesh->GetMaterial())
+		{
+			m_groups.push_back(Group{ pMesh->GetMaterial(), i, 0 });
+		}
+		++m_groups.back().numDraws;
+
+		GpuDrawData& draw = m_draws[i];
+		draw.transform = glm::mat4(1.0f);
+		draw.boundsMin = glm::vec4(pMesh->GetAABB().min, 0.0f);
+		draw.boundsMax = glm::vec4(pMesh->GetAABB().max, 0.0f);
+		draw.numIndices = pMesh->GetNumIndices();
+		draw.firstIndex = pMesh->GetFirstIndex();
+		draw.baseVertex = pMesh->GetBaseVertex();
+		draw.group = static_cast<unsigned int>(m_groups.size() - 1);
+	}
+
+	// every group's commands start where its draws do, so it has room for all of them surviving
+	std::vector<unsigned int> groupOffsets(m_groups.size());
+	for (size_t i = 0; i < m_groups.size(); ++i)
+	{
+		groupOffsets[i] = m_groups[i].firstCommand;
+	}
+
+	glCreateBuffers(1, &m_drawBuffer);
+	glNamedBufferStorage(m_drawBuffer, m_draws.size() * sizeof(GpuDrawData), m_draws.data(), GL_DYNAMIC_STORAGE_BIT);
+	glCreateBuffers(GCP_COUNT, m_commandBuffers);
+	glCreateBuffers(GCP_COUNT, m_countBuffers);
+	for (unsigned int pass = 0; pass < GCP_COUNT; ++pass)
+	{
+		glNamedBufferStorage(m_commandBuffers[pass], m_draws.size() * sizeof(DrawElementsIndirectCommand), nullptr, 0);
+		glNamedBufferStorage(m_countBuffers[pass], m_groups.size() * sizeof(unsigned int), nullptr, 0);
+	}
+	glCreateBuffers(1, &m_groupOffsetBuffer);
+	glNamedBufferStorage(m_groupOffsetBuffer, groupOffsets.size() * sizeof(unsigned int), groupOffsets.data(), 0);
+	glCreateBuffers(1, &m_occludedBuffer);
+	glNamedBufferStorage(m_occludedBuffer, (m_draws.size() + 1) * sizeof(unsigned int), nullptr, 0);
+}
+
+void GpuDrawList::Clear()
+{
+	m_draws.clear();
+	m_groups.clear();
+	m_meshes.clear();
+
+	DeleteBuffer(m_drawBuffer);
+	for (unsigned int pass = 0; pass < GCP_COUNT; ++pass)
+	{
+		DeleteBuffer(m_commandBuffers[pass]);
+		DeleteBuffer(m_countBuffers[pass]);
+	}
+	DeleteBuffer(m_groupOffsetBuffer);
+	DeleteBuffer(m_occludedBuffer);
+	m_bHasOccluded = false;
+}
+
+void GpuDrawList::SetTransform(const glm::mat4& transform)
+{
+	if (m_draws.empty())
+	{
+		return;
+	}
+
+	for (GpuDrawData& draw : m_draws)
+	{
+		draw.transform = transform;
+	}
+	// for the normal matrices, the culling pass writes the world view projection of each draw that survives
+	ComputeDrawMatrices(glm::mat4(1.0f), m_draws.data(), m_draws.size());
+	glNamedBufferSubData(m_drawBuffer, 0, m_draws.size() * sizeof(GpuDrawData), m_draws.data());
+}
+
+void GpuDrawList::UpdateGeometry()
+{
+	for (size_t i = 0; i < m_draws.size(); ++i)
+	{
+		m_draws[i].firstIndex = m_meshes[i]->GetFirstIndex();
+		m_draws[i].baseVertex = m_meshes[i]->GetBaseVertex();
+	}
+	glNamedBufferSubData(m_drawBuffer, 0, m_draws.size() * sizeof(GpuDrawData), m_draws.data());
+	m_geometryGeneration = GeometryPool::GetInstance()->GetGeneration();
+}
+
+GpuCuller::GpuCuller()
+	: m_pCullShader(nullptr)
+	, m_numDrawsHandle(INVALID_UNIFORM_HANDLE)
+	, m_frustumPlanesHandle(INVALID_UNIFORM_HANDLE)
+	, m_viewProjectionHandle(INVALID_UNIFORM_HANDLE)
+	, m_secondPassHandle(INVALID_UNIFORM_HANDLE)
+	, m_useDepthPyramidHandle(INVALID_UNIFORM_HANDLE)
+	, m_pyramidViewProjectionHandle(INVALID_UNIFORM_HANDLE)
+	, m_depthPyramidHandle(INVALID_UNIFORM_HANDLE)
+	, m_numPyramidLevelsHandle(INVALID_UNIFORM_HANDLE)
+	, m_pPyramidShader(nullptr)
+	, m_sourceDepthHandle(INVALID_UNIFORM_HANDLE)
+	, m_sourceLevelHandle(INVALID_UNIFORM_HANDLE)
+	, m_viewProjection(1.0f)
+	, m_frustum()
+	, m_pyramidViewProjection(1.0f)
+	, m_depthTexture(0)
+	, m_pyramidTexture(0)
+	, m_depthWidth(0)
+	, m_depthHeight(0)
+	, m_numPyramidLevels(0)
+	, m_bPyramidValid(false)
+	, m_numDispatches(0)
+	, m_numMultiDraws(0)
+{
+}
+
+GpuCuller::~GpuCuller()
+{
+	if (m_pCullShader)
+	{
+		ShaderManager::GetInstance()->DeleteShader(m_pCullShader);
+		ShaderManager::GetInstance()->DeleteShader(m_pPyramidShader);
+	}
+	DeleteDepthPyramid();
+}
+
+bool GpuCuller::IsSupported()
+{
+	return GLAD_GL_VERSION_4_6 != 0;
+}
+
+void GpuCuller::Begin(Camera& camera)
+{
+	m_viewProjection = camera.GetProjectionMatrix() * camera.GetViewMatrix();
+	m_frustum = camera.GetFrustum();
+	m_numDispatches = 0;
+	m_numMultiDraws = 0;
+}
+
+void GpuCuller::Draw(GpuDrawList& list, GpuCullPass pass)
+{
+	if (list.IsEmpty())
+	{
+		return;
+	}
+	// the second pass needs something the first pass rejected and a pyramid built since
+	if (pass == GCP_SECOND && (!list.m_bHasOccluded || !m_bPyramidValid))
+	{
+		return;
+	}
+
+	if (!m_pCullShader)
+	{
+		CreateShaders();
+	}
+
+	GeometryPool* pGeometryPool = GeometryPool::GetInstance();
+	if (list.m_geometryGeneration != pGeometryPool->GetGeneration())
+	{
+		list.UpdateGeometry();
+	}
+
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	const unsigned int zero = 0;
+	glClearNamedBufferData(list.m_countBuffers[pass], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (pass == GCP_FIRST)
+	{
+		glClearNamedBufferSubData(list.m_occludedBuffer, GL_R32UI, 0, sizeof(unsigned int), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		list.m_bHasOccluded = m_bPyramidValid;
+	}
+
+	pStateCache->BindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, list.m_drawBuffer);
+	pStateCache->BindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, list.m_commandBuffers[pass]);
+	pStateCache->BindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, list.m_countBuffers[pass]);
+	pStateCache->BindBufferBase(GL_SHADER_STORAGE_BUFFER, GROUP_OFFSETS_BINDING, list.m_groupOffsetBuffer);
+	pStateCache->BindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUDED_BINDING, list.m_occludedBuffer);
+
+	m_pCullShader->Bind();
+	m_pCullShader->SetUniform(m_numDrawsHandle, list.GetNumDraws());
+	m_pCullShader->SetUniform(m_frustumPlanesHandle, m_frustum.planes, FP_COUNT);
+	m_pCullShader->SetUniform(m_viewProjectionHandle, m_viewProjection);
+	m_pCullShader->SetUniform(m_secondPassHandle, pass == GCP_SECOND ? 1 : 0);
+	m_pCullShader->SetUniform(m_useDepthPyramidHandle, m_bPyramidValid ? 1 : 0);
+	if (m_bPyramidValid)
+	{
+		m_pCullShader->SetUniform(m_pyramidViewProjectionHandle, m_pyramidViewProjection);
+		m_pCullShader->SetUniform(m_depthPyramidHandle, 0);
+		m_pCullShader->SetUniform(m_numPyramidLevelsHandle, static_cast<int>(m_numPyramidLevels));
+		pStateCache->BindTexture(0, m_pyramidTexture);
+	}
+	// the second pass only needs as many threads as the first rejected, but that count is only on the GPU
+	glDispatchCompute((list.GetNumDraws() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	++m_numDispatches;
+
+	// the commands and counts are read as indirect draw parameters, and the draws' matrices by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	pStateCache->BindVertexArray(pGeometryPool->GetVertexArray());
+	pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, list.m_commandBuffers[pass]);
+	pStateCache->BindBuffer(GL_PARAMETER_BUFFER, list.m_countBuffers[pass]);
+
+	for (size_t i = 0; i < list.m_groups.size(); ++i)
+	{
+		const GpuDrawList::Group& group = list.m_groups[i];
+		group.pMaterial->ApplyParams();
+		const uintptr_t commandOffset = group.firstCommand * sizeof(DrawElementsIndirectCommand);
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(commandOffset), static_cast<GLintptr>(i * sizeof(unsigned int)), group.numDraws, 0);
+		++m_numMultiDraws;
+	}
+}
+
+void GpuCuller::UpdateDepthPyramid(int width, int height)
+{
+	if (width <= 0 || height <= 0)
+	{
+		return;
+	}
+
+	if (!m_pCullShader)
+	{
+		CreateShaders();
+	}
+
+	if (width != m_depthWidth || height != m_depthHeight)
+	{
+		CreateDepthPyramid(width, height);
+	}
+
+	glCopyTextureSubImage2D(m_depthTexture, 0, 0, 0, 0, 0, width, height);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	m_pPyramidShader->Bind();
+	m_pPyramidShader->SetUniform(m_sourceDepthHandle, 0);
+	for (unsigned int level = 0; level < m_numPyramidLevels; ++level)
+	{
+		const int levelWidth = std::max(width >> (level + 1), 1);
+		const int levelHeight = std::max(height >> (level + 1), 1);
+
+		// level 0 reduces the depth buffer itself, the rest the level before them
+		pStateCache->BindTexture(0, level == 0 ? m_depthTexture : m_pyramidTexture);
+		m_pPyramidShader->SetUniform(m_sourceLevelHandle, level == 0 ? 0 : static_cast<int>(level - 1));
+		glBindImageTexture(0, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		++m_numDispatches;
+
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	m_pyramidViewProjection = m_viewProjection;
+	m_bPyramidValid = true;
+}
+
+void GpuCuller::CreateShaders()
+{
+	ShaderManager* pShaderManager = ShaderManager::GetInstance();
+
+	m_pCullShader = pShaderManager->CreateComputeShader(CULL_SHADER);
+	m_numDrawsHandle = m_pCullShader->GetUniformHandle(HashLiteral("numDraws"));
+	m_frustumPlanesHandle = m_pCullShader->GetUniformHandle(HashLiteral("frustumPlanes"));
+	m_viewProjectionHandle = m_pCullShader->GetUniformHandle(HashLiteral("viewProjection"));
+	m_secondPassHandle = m_pCullShader->GetUniformHandle(HashLiteral("secondPass"));
+	m_useDepthPyramidHandle = m_pCullShader->GetUniformHandle(HashLiteral("useDepthPyramid"));
+	m_pyramidViewProjectionHandle = m_pCullShader->GetUniformHandle(HashLiteral("pyramidViewProjection"));
+	m_depthPyramidHandle = m_pCullShader->GetUniformHandle(HashLiteral("depthPyramid"));
+	m_numPyramidLevelsHandle = m_pCullShader->GetUniformHandle(HashLiteral("numPyramidLevels"));
+
+	m_pPyramidShader = pShaderManager->CreateComputeShader(DEPTH_PYRAMID_SHADER);
+	m_sourceDepthHandle = m_pPyramidShader->GetUniformHandle(HashLiteral("sourceDepth"));
+	m_sourceLevelHandle = m_pPyramidShader->GetUniformHandle(HashLiteral("sourceLevel"));
+}
+
+void GpuCuller::CreateDepthPyramid(int width, int height)
+{
+	DeleteDepthPyramid();
+
+	m_depthWidth = width;
+	m_depthHeight = height;
+
+	// only ever read with texelFetch, the filters just have to make the textures complete
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTexture);
+	glTextureStorage2D(m_depthTexture, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// the first level is half the depth buffer's size
+	const unsigned int pyramidWidth = std::max(width >> 1, 1);
+	const unsigned int pyramidHeight = std::max(height >> 1, 1);
+	m_numPyramidLevels = GetMipLevelCount(pyramidWidth, pyramidHeight);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_pyramidTexture);
+	glTextureStorage2D(m_pyramidTexture, m_numPyramidLevels, GL_R32F, pyramidWidth, pyramidHeight);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(m_pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void GpuCuller::DeleteDepthPyramid()
+{
+	DeleteTexture(m_depthTexture);
+	DeleteTexture(m_pyramidTexture);
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_numPyramidLevels = 0;
+	m_bPyramidValid = false;
+}
\ No newline at end of file
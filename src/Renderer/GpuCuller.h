@@ -0,0 +1,139 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Mesh.h"
+#include "DrawData.h"
+#include "Shader.h"
+
+class Camera;
+class Material;
+
+enum GpuCullPass
+{
+	// every draw, against the depth pyramid from last frame
+	GCP_FIRST,
+	// only the draws the first pass found occluded, against the pyramid rebuilt from this frame's depth
+	GCP_SECOND,
+	GCP_COUNT,
+};
+
+// One model's opaque meshes for the GPU driven path. The meshes all draw from the GeometryPool, and their transforms
+// and bounds live in a storage buffer the culling pass reads. Draws are grouped by material, so
+// the survivors of each group are a contiguous range of the indirect command buffer and can be drawn with one call.
+// Translucent meshes are left out, they have to be sorted back to front so they go through the RenderQueue.
+class GpuDrawList
+{
+	friend class GpuCuller;
+
+public:
+	GpuDrawList();
+	~GpuDrawList();
+
+	// at most MAX_DRAW_IDS meshes, which have to outlive the list. Translucent ones are skipped.
+	void Create(const std::vector<Mesh*>& meshes);
+	void Clear();
+
+	// every draw gets the same transform, uploaded straight away
+	void SetTransform(const glm::mat4& transform);
+
+	bool IsEmpty() const { return m_draws.empty(); }
+	unsigned int GetNumDraws() const { return static_cast<unsigned int>(m_draws.size()); }
+	unsigned int GetNumGroups() const { return static_cast<unsigned int>(m_groups.size()); }
+
+private:
+	struct Group
+	{
+		Material* pMaterial;
+		unsigned int firstCommand;
+		unsigned int numDraws;
+	};
+
+	std::vector<GpuDrawData> m_draws;
+	std::vector<Group> m_groups;
+
+	// re-reads the meshes' index ranges after the GeometryPool has moved them
+	void UpdateGeometry();
+
+	// in the same order as m_draws
+	std::vector<const Mesh*> m_meshes;
+	unsigned int m_geometryGeneration;
+	unsigned int m_drawBuffer;
+	// each pass has its own commands and counts, so the second draws only what it adds
+	unsigned int m_commandBuffers[GCP_COUNT];
+	// one survivor count per group, read by glMultiDrawElementsIndirectCount
+	unsigned int m_countBuffers[GCP_COUNT];
+	unsigned int m_groupOffsetBuffer;
+	// a count then the index of each draw the first pass found occluded
+	unsigned int m_occludedBuffer;
+	// the first pass tested against a pyramid, so there's something for the second to do
+	bool m_bHasOccluded;
+};
+
+// Culls and draws GpuDrawLists without the CPU looking at their meshes. A compute pass tests each draw against the
+// frustum and against a depth pyramid built from the previous frame's depth buffer, and appends the survivors to the
+// list's indirect command buffer. They're then drawn with one glMultiDrawElementsIndirectCount per material, so the
+// CPU cost of a model only grows with its number of materials. The pyramid is then rebuilt from what was drawn, and
+// a second pass tests the draws the first one rejected against it, so nothing that has just come into view is
+// missing for a frame.
+//
+// Each frame: Begin, Draw every list with GCP_FIRST, UpdateDepthPyramid, then Draw every list with GCP_SECOND.
+class GpuCuller
+{
+public:
+	GpuCuller();
+	~GpuCuller();
+
+	// glMultiDrawElementsIndirectCount needs GL 4.6
+	static bool IsSupported();
+
+	void Begin(Camera& camera);
+	void Draw(GpuDrawList& list, GpuCullPass pass);
+	// copies the bound framebuffer's depth and builds the pyramid the second pass and the next frame's first pass are
+	// culled against. Call between the passes.
+	void UpdateDepthPyramid(int width, int height);
+
+	// since Begin
+	unsigned int GetNumDispatches() const { return m_numDispatches; }
+	unsigned int GetNumMultiDraws() const { return m_numMultiDraws; }
+
+private:
+	void CreateShaders();
+	void CreateDepthPyramid(int width, int height);
+	void DeleteDepthPyramid();
+
+	Shader* m_pCullShader;
+	uniformHandle_t m_numDrawsHandle;
+	uniformHandle_t m_frustumPlanesHandle;
+	uniformHandle_t m_viewProjectionHandle;
+	uniformHandle_t m_secondPassHandle;
+	uniformHandle_t m_useDepthPyramidHandle;
+	uniformHandle_t m_pyramidViewProjectionHandle;
+	uniformHandle_t m_depthPyramidHandle;
+	uniformHandle_t m_numPyramidLevelsHandle;
+
+	Shader* m_pPyramidShader;
+	uniformHandle_t m_sourceDepthHandle;
+	uniformHandle_t m_sourceLevelHandle;
+
+	glm::mat4 m_viewProjection;
+	Frustum m_frustum;
+	// the camera the depth pyramid was built from
+	glm::mat4 m_pyramidViewProjection;
+
+	unsigned int m_depthTexture;
+	unsigned int m_pyramidTexture;
+	int m_depthWidth;
+	int m_depthHeight;
+	unsigned int m_numPyramidLevels;
+	bool m_bPyramidValid;
+
+	unsigned int m_numDispatches;
+	unsigned int m_numMultiDraws;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,426 @@
+#include "Ktx2File.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	const size_t KTX2_HEADER_SIZE = 80;
+	const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+	const char* const KEY_ORIENTATION = "KTXorientation";
+	const char* const KEY_WRITER = "KTXwriter";
+	const char* const KEY_SOURCE_HASH = "OrcaSourceHash";
+
+	// data format descriptor constants, see the Khronos Data Format Specification
+	const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC3 = 130;
+	const uint32_t KHR_DF_MODEL_BC4 = 131;
+	const uint32_t KHR_DF_MODEL_BC5 = 132;
+	const uint32_t KHR_DF_MODEL_BC7 = 134;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+	const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+	const uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+	const uint32_t KHR_DF_VERSION = 2;
+
+	struct Ktx2FormatInfo
+	{
+		TextureFormat format;
+		bool bSRGB;
+		uint32_t vkFormat;
+	};
+
+	const Ktx2FormatInfo KTX2_FORMATS[] =
+	{
+		{ TF_R8,	false,	9 },	// VK_FORMAT_R8_UNORM
+		{ TF_RG8,	false,	16 },	// VK_FORMAT_R8G8_UNORM
+		{ TF_RGB8,	false,	23 },	// VK_FORMAT_R8G8B8_UNORM
+		{ TF_RGB8,	true,	29 },	// VK_FORMAT_R8G8B8_SRGB
+		{ TF_RGBA8,	false,	37 },	// VK_FORMAT_R8G8B8A8_UNORM
+		{ TF_RGBA8,	true,	43 },	// VK_FORMAT_R8G8B8A8_SRGB
+		{ TF_BC1,	false,	131 },	// VK_FORMAT_BC1_RGB_UNORM_BLOCK
+		{ TF_BC1,	true,	132 },	// VK_FORMAT_BC1_RGB_SRGB_BLOCK
+		{ TF_BC3,	false,	137 },	// VK_FORMAT_BC3_UNORM_BLOCK
+		{ TF_BC3,	true,	138 },	// VK_FORMAT_BC3_SRGB_BLOCK
+		{ TF_BC4,	false,	139 },	// VK_FORMAT_BC4_UNORM_BLOCK
+		{ TF_BC5,	false,	141 },	// VK_FORMAT_BC5_UNORM_BLOCK
+		{ TF_BC7,	false,	145 },	// VK_FORMAT_BC7_UNORM_BLOCK
+		{ TF_BC7,	true,	146 },	// VK_FORMAT_BC7_SRGB_BLOCK
+	};
+
+	const Ktx2FormatInfo* FindFormatInfo(TextureFormat format, bool bSRGB)
+	{
+		for (const auto& info : KTX2_FORMATS)
+		{
+			if (info.format == format && info.bSRGB == bSRGB)
+			{
+				return &info;
+			}
+		}
+		return nullptr;
+	}
+
+	const Ktx2FormatInfo* FindFormatInfo(uint32_t vkFormat)
+	{
+		for (const auto& info : KTX2_FORMATS)
+		{
+			if (info.vkFormat == vkFormat)
+			{
+				return &info;
+			}
+		}
+		return nullptr;
+	}
+
+	uint32_t ReadU32(const unsigned char* pData)
+	{
+		uint32_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadU64(const unsigned char* pData)
+	{
+		uint64_t value;
+		memcpy(&value, pData, sizeof(value));
+		return value;
+	}
+
+	void WriteU32(std::vector<unsigned char>& buffer, size_t offset, uint32_t value)
+	{
+		memcpy(buffer.data() + offset, &value, sizeof(value));
+	}
+
+	void WriteU64(std::vector<unsigned char>& buffer, size_t offset, uint64_t value)
+	{
+		memcpy(buffer.data() + offset, &value, sizeof(value));
+	}
+
+	size_t AlignTo(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	struct DfdSample
+	{
+		uint32_t channelType;
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t upper;
+	};
+
+	std::vector<uint32_t> BuildDataFormatDescriptor(TextureFormat format, bool bSRGB)
+	{
+		const uint32_t blockSize = GetTextureFormatBlockSize(format);
+		uint32_t colorModel = KHR_DF_MODEL_RGBSDA;
+		std::vector<DfdSample> samples;
+
+		switch (format)
+		{
+		case TF_BC1:
+			colorModel = KHR_DF_MODEL_BC1A;
+			samples.push_back({ 0, 0, 64, 0xFFFFFFFF });
+			break;
+		case TF_BC3:
+			colorModel = KHR_DF_MODEL_BC3;
+			samples.push_back({ KHR_DF_CHANNEL_ALPHA | (bSRGB ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0), 0, 64, 0xFFFFFFFF });
+			samples.push_back({ 0, 64, 64, 0xFFFFFFFF });
+			break;
+		case TF_BC4:
+			colorModel = KHR_DF_MODEL_BC4;
+			samples.push_back({ 0, 0, 64, 0xFFFFFFFF });
+			break;
+		case TF_BC5:
+			colorModel = KHR_DF_MODEL_BC5;
+			samples.push_back({ 0, 0, 64, 0xFFFFFFFF });
+			samples.push_back({ 1, 64, 64, 0xFFFFFFFF });
+			break;
+		case TF_BC7:
+			colorModel = KHR_DF_MODEL_BC7;
+			samples.push_back({ 0, 0, 128, 0xFFFFFFFF });
+			break;
+		default:
+			// one 8 bit sample per channel
+			for (uint32_t c = 0; c < blockSize; ++c)
+			{
+				const bool bAlpha = blockSize == 4 && c == 3;
+				uint32_t channelType = bAlpha ? KHR_DF_CHANNEL_ALPHA : c;
+				if (bAlpha && bSRGB)
+				{
+					// alpha is never sRGB encoded
+					channelType |= KHR_DF_SAMPLE_DATATYPE_LINEAR;
+				}
+				samples.push_back({ channelType, c * 8, 8, 255 });
+			}
+			break;
+		}
+
+		const uint32_t texelBlockDimensions = IsCompressedFormat(format) ? (3 | (3 << 8)) : 0;
+		const uint32_t descriptorBlockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+		std::vector<uint32_t> dfd;
+		dfd.push_back(4 + descriptorBlockSize);
+		dfd.push_back(0); // vendor id and descriptor type
+		dfd.push_back(KHR_DF_VERSION | (descriptorBlockSize << 16));
+		dfd.push_back(colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | ((bSRGB ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+		dfd.push_back(texelBlockDimensions);
+		dfd.push_back(blockSize); // bytes in plane 0
+		dfd.push_back(0);
+
+		for (const auto& sample : samples)
+		{
+			dfd.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channelType << 24));
+			dfd.push_back(0);
+			dfd.push_back(0);
+			dfd.push_back(sample.upper);
+		}
+
+		return dfd;
+	}
+
+	void AppendKeyValue(std::vector<unsigned char>& kvd, const char* key, const std::string& value)
+	{
+		const uint32_t length = static_cast<uint32_t>(strlen(key) + 1 + value.size() + 1);
+		const size_t offset = kvd.size();
+		kvd.resize(AlignTo(offset + sizeof(uint32_t) + length, 4), 0);
+		memcpy(kvd.data() + offset, &length, sizeof(length));
+		memcpy(kvd.data() + offset + sizeof(uint32_t), key, strlen(key) + 1);
+		memcpy(kvd.data() + offset + sizeof(uint32_t) + strlen(key) + 1, value.c_str(), value.size() + 1);
+	}
+}
+
+bool WriteKtx2(const std::string& filename, const TextureImage& image, hash_t sourceHash)
+{
+	const Ktx2FormatInfo* pFormatInfo = FindFormatInfo(image.format, image.bSRGB);
+	if (!pFormatInfo || image.levels.empty())
+	{
+		printf("Failed to write \"%s\". Unsupported texture format\n", filename.c_str());
+		return false;
+	}
+
+	const std::vector<uint32_t> dfd = BuildDataFormatDescriptor(image.format, image.bSRGB);
+
+	// keys must be sorted by their byte values
+	char hashString[17];
+	snprintf(hashString, sizeof(hashString), "%016" PRIx64, static_cast<uint64_t>(sourceHash));
+	std::vector<unsigned char> kvd;
+	AppendKeyValue(kvd, KEY_ORIENTATION, image.bFlippedVertically ? "ru" : "rd");
+	AppendKeyValue(kvd, KEY_WRITER, "Orca");
+	AppendKeyValue(kvd, KEY_SOURCE_HASH, hashString);
+
+	const size_t numLevels = image.levels.size();
+	const size_t levelIndexOffset = KTX2_HEADER_SIZE;
+	const size_t dfdOffset = levelIndexOffset + numLevels * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+	const size_t kvdOffset = dfdOffset + dfd.size() * sizeof(uint32_t);
+
+	// level data is stored smallest level first, each aligned to lcm(texel block size, 4)
+	const size_t texelSize = GetTextureFormatBlockSize(image.format);
+	const size_t levelAlignment = texelSize % 4 == 0 ? texelSize : (texelSize % 2 == 0 ? texelSize * 2 : texelSize * 4);
+	std::vector<size_t> levelOffsets(numLevels);
+	size_t fileSize = kvdOffset + kvd.size();
+	for (size_t level = numLevels; level-- > 0;)
+	{
+		fileSize = AlignTo(fileSize, levelAlignment);
+		levelOffsets[level] = fileSize;
+		fileSize += image.levels[level].size();
+	}
+
+	std::vector<unsigned char> buffer(fileSize, 0);
+	memcpy(buffer.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	WriteU32(buffer, 12, pFormatInfo->vkFormat);
+	WriteU32(buffer, 16, 1); // typeSize
+	WriteU32(buffer, 20, image.width);
+	WriteU32(buffer, 24, image.height);
+	WriteU32(buffer, 28, 0); // pixelDepth
+	WriteU32(buffer, 32, 0); // layerCount
+	WriteU32(buffer, 36, 1); // faceCount
+	WriteU32(buffer, 40, static_cast<uint32_t>(numLevels));
+	WriteU32(buffer, 44, 0); // supercompressionScheme
+	WriteU32(buffer, 48, static_cast<uint32_t>(dfdOffset));
+	WriteU32(buffer, 52, static_cast<uint32_t>(dfd.size() * sizeof(uint32_t)));
+	WriteU32(buffer, 56, static_cast<uint32_t>(kvdOffset));
+	WriteU32(buffer, 60, static_cast<uint32_t>(kvd.size()));
+	WriteU64(buffer, 64, 0); // sgdByteOffset
+	WriteU64(buffer, 72, 0); // sgdByteLength
+
+	for (size_t level = 0; level < numLevels; ++level)
+	{
+		const size_t entryOffset = levelIndexOffset + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		WriteU64(buffer, entryOffset, levelOffsets[level]);
+		WriteU64(buffer, entryOffset + 8, image.levels[level].size());
+		WriteU64(buffer, entryOffset + 16, image.levels[level].size());
+		memcpy(buffer.data() + levelOffsets[level], image.levels[level].data(), image.levels[level].size());
+	}
+	memcpy(buffer.data() + dfdOffset, dfd.data(), dfd.size() * sizeof(uint32_t));
+	memcpy(buffer.data() + kvdOffset, kvd.data(), kvd.size());
+
+	// write to a temporary file first so an interrupted bake never leaves a truncated texture behind
+	const std::string tempFilename = filename + ".tmp";
+	FILE* pFile = fopen(tempFilename.c_str(), "wb");
+	if (!pFile)
+	{
+		printf("Failed to open \"%s\" for writing\n", tempFilename.c_str());
+		return false;
+	}
+
+	bool bSuccess = std::fwrite(buffer.data(), 1, buffer.size(), pFile) == buffer.size();
+	bSuccess = (std::fclose(pFile) == 0) && bSuccess;
+	if (bSuccess)
+	{
+		std::remove(filename.c_str());
+		bSuccess = std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+	}
+
+	if (!bSuccess)
+	{
+		printf("Failed to write \"%s\"\n", filename.c_str());
+		std::remove(tempFilename.c_str());
+	}
+	return bSuccess;
+}
+
+Ktx2File::Ktx2File()
+	: m_file()
+	, m_levels()
+	, m_format(TF_RGBA8)
+	, m_width(0)
+	, m_height(0)
+	, m_sourceHash(0)
+	, m_bHasSourceHash(false)
+	, m_bSRGB(false)
+	, m_bFlippedVertically(false)
+{
+}
+
+Ktx2File::~Ktx2File()
+{
+	Close();
+}
+
+bool Ktx2File::Open(const std::string& filename)
+{
+	Close();
+
+	if (!FileSystem::GetInstance()->Open(filename, m_file))
+	{
+		return false;
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	if (size < KTX2_HEADER_SIZE || memcmp(pData, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+	{
+		printf("\"%s\" is not a KTX2 file\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	const uint32_t vkFormat = ReadU32(pData + 12);
+	const uint32_t pixelDepth = ReadU32(pData + 28);
+	const uint32_t layerCount = ReadU32(pData + 32);
+	const uint32_t faceCount = ReadU32(pData + 36);
+	const uint32_t levelCount = ReadU32(pData + 40);
+	const uint32_t supercompressionScheme = ReadU32(pData + 44);
+	const uint32_t kvdOffset = ReadU32(pData + 56);
+	const uint32_t kvdLength = ReadU32(pData + 60);
+
+	// only plain 2D textures without supercompression are supported
+	const Ktx2FormatInfo* pFormatInfo = FindFormatInfo(vkFormat);
+	if (!pFormatInfo || pixelDepth != 0 || layerCount != 0 || faceCount != 1 || supercompressionScheme != 0)
+	{
+		printf("Unsupported KTX2 texture \"%s\"\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	m_format = pFormatInfo->format;
+	m_bSRGB = pFormatInfo->bSRGB;
+	m_width = ReadU32(pData + 20);
+	m_height = ReadU32(pData + 24);
+
+	const unsigned int numLevels = levelCount == 0 ? 1 : levelCount;
+	if (KTX2_HEADER_SIZE + static_cast<uint64_t>(numLevels) * KTX2_LEVEL_INDEX_ENTRY_SIZE > size
+		|| static_cast<uint64_t>(kvdOffset) + kvdLength > size
+		|| !ParseKeyValueData(pData + kvdOffset, kvdLength))
+	{
+		printf("KTX2 texture \"%s\" is corrupt\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	m_levels.resize(numLevels);
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		const unsigned char* pEntry = pData + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		const uint64_t offset = ReadU64(pEntry);
+		const uint64_t length = ReadU64(pEntry + 8);
+
+		TextureLevel& textureLevel = m_levels[level];
+		textureLevel.width = std::max(m_width >> level, 1u);
+		textureLevel.height = std::max(m_height >> level, 1u);
+		textureLevel.pData = pData + offset;
+		textureLevel.size = static_cast<size_t>(length);
+
+		if (offset + length > size || length != GetTextureLevelSize(m_format, textureLevel.width, textureLevel.height))
+		{
+			printf("KTX2 texture \"%s\" is corrupt\n", filename.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Ktx2File::Close()
+{
+	m_file.Close();
+	m_levels.clear();
+	m_width = 0;
+	m_height = 0;
+	m_sourceHash = 0;
+	m_bHasSourceHash = false;
+	m_bSRGB = false;
+	m_bFlippedVertically = false;
+}
+
+bool Ktx2File::ParseKeyValueData(const unsigned char* pData, size_t size)
+{
+	size_t offset = 0;
+	while (offset + sizeof(uint32_t) <= size)
+	{
+		const uint32_t length = ReadU32(pData + offset);
+		offset += sizeof(uint32_t);
+		if (offset + length > size)
+		{
+			return false;
+		}
+
+		// key and value are both NUL terminated strings as far as we're concerned
+		const char* pKey = reinterpret_cast<const char*>(pData + offset);
+		const size_t keyLength = strnlen(pKey, length);
+		if (keyLength < length)
+		{
+			const char* pValue = pKey + keyLength + 1;
+			const std::string value(pValue, strnlen(pValue, length - keyLength - 1));
+			if (strcmp(pKey, KEY_ORIENTATION) == 0)
+			{
+				m_bFlippedVertically = value.size() >= 2 && value[1] == 'u';
+			}
+			else if (strcmp(pKey, KEY_SOURCE_HASH) == 0)
+			{
+				m_bHasSourceHash = sscanf(value.c_str(), "%" SCNx64, &m_sourceHash) == 1;
+			}
+		}
+
+		offset = AlignTo(offset + length, 4);
+	}
+
+	return true;
+}
\ No newline at end of file
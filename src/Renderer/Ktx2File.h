@@ -0,0 +1,51 @@
+#ifndef KTX2_FILE_H
+#define KTX2_FILE_H
+
+#include <string>
+#include <vector>
+
+#include "Core/Hash.h"
+#include "Core/FileSystem.h"
+#include "TextureImage.h"
+
+// Baked textures are stored as KTX2 next to their source image. Besides the standard KTXorientation key, the
+// key/value data carries the hash of the source image so stale bakes can be detected at load time.
+const char* const BAKED_TEXTURE_EXTENSION = ".ktx2";
+
+bool WriteKtx2(const std::string& filename, const TextureImage& image, hash_t sourceHash);
+
+// read-only view of a KTX2 file opened through FileSystem. Level data points straight into the file contents.
+class Ktx2File
+{
+public:
+	Ktx2File();
+	~Ktx2File();
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	TextureFormat GetFormat() const { return m_format; }
+	bool IsSRGB() const { return m_bSRGB; }
+	bool IsFlippedVertically() const { return m_bFlippedVertically; }
+	bool HasSourceHash() const { return m_bHasSourceHash; }
+	hash_t GetSourceHash() const { return m_sourceHash; }
+	unsigned int GetWidth() const { return m_width; }
+	unsigned int GetHeight() const { return m_height; }
+	unsigned int GetNumLevels() const { return static_cast<unsigned int>(m_levels.size()); }
+	const TextureLevel& GetLevel(unsigned int level) const { return m_levels[level]; }
+
+private:
+	bool ParseKeyValueData(const unsigned char* pData, size_t size);
+
+	File m_file;
+	std::vector<TextureLevel> m_levels;
+	TextureFormat m_format;
+	unsigned int m_width;
+	unsigned int m_height;
+	hash_t m_sourceHash;
+	bool m_bHasSourceHash;
+	bool m_bSRGB;
+	bool m_bFlippedVertically;
+};
+
+#endif
\ No newline at end of file
@@ -1,99 +1,269 @@
 #include "Material.h"
 
+#include <cstring>
+
 #include <glad/glad.h>
 
-#include "Shader.h"
+#include "GLStateCache.h"
+#include "ShaderManager.h"
 #include "TextureManager.h"
 
 Material::Material()
-	: m_shader(nullptr)
+	: m_name()
+	, m_id(0)
+	, m_shader(nullptr)
+	, m_vertexShader()
+	, m_fragmentShader()
+	, m_shaderPermutation(0)
+	, m_bShaderDirty(false)
+	, m_bHandlesDirty(false)
+	, m_bTranslucent(false)
+	, m_bAlphaTested(false)
 	, m_textures()
+	, m_mat4Params()
 	, m_vec4Params()
 	, m_vec3Params()
 	, m_floatParams()
 	, m_integerParams()
+	, m_blockData()
+	, m_blockBuffer(0)
+	, m_blockBinding(0)
+	, m_bBlockDirty(false)
+	, m_bUniformsDirty(false)
 {
 }
 
 Material::~Material()
 {
-	delete m_shader;
+	ReleaseShader();
+	GLStateCache::GetInstance()->OnBufferDeleted(m_blockBuffer);
+	glDeleteBuffers(1, &m_blockBuffer);
 }
 
 void Material::ApplyParams()
 {
+	if (m_bShaderDirty)
+	{
+		UpdateShader();
+	}
+	if (m_bHandlesDirty)
+	{
+		ResolveHandles();
+	}
 	m_shader->Bind();
 
-	for (const auto& textureIt : m_textures)
+	for (const TextureParam& texture : m_textures)
+	{
+		const int textureUnit = texture.unitParam >= 0 ? m_integerParams[texture.unitParam].value : 0;
+		texture.pTexture->Bind(textureUnit);
+	}
+
+	if (m_blockBuffer != 0)
+	{
+		if (m_bBlockDirty)
+		{
+			glNamedBufferSubData(m_blockBuffer, 0, static_cast<GLsizeiptr>(m_blockData.size()), m_blockData.data());
+			m_bBlockDirty = false;
+		}
+		GLStateCache::GetInstance()->BindBufferRange(GL_UNIFORM_BUFFER, m_blockBinding, m_blockBuffer, 0, static_cast<GLsizeiptr>(m_blockData.size()));
+	}
+
+	if (!m_shader->AcquireUniforms(this) && !m_bUniformsDirty)
+	{
+		return;
+	}
+	m_bUniformsDirty = false;
+
+	auto Apply = [this](const auto& params)
+	{
+		for (const auto& param : params)
+		{
+			if (param.handle != INVALID_UNIFORM_HANDLE)
+			{
+				m_shader->SetUniform(param.handle, param.value);
+			}
+		}
+	};
+	Apply(m_mat4Params);
+	Apply(m_vec4Params);
+	Apply(m_vec3Params);
+	Apply(m_floatParams);
+	Apply(m_integerParams);
+}
+
+void Material::SetShader(const std::string& vertexShader, const std::string& fragmentShader)
+{
+	m_vertexShader = vertexShader;
+	m_fragmentShader = fragmentShader;
+	m_bShaderDirty = true;
+}
+
+void Material::SetShaderFeature(ShaderFeature feature, bool bEnabled)
+{
+	const shaderPermutation_t permutation = bEnabled ? (m_shaderPermutation | feature) : (m_shaderPermutation & ~feature);
+	if (permutation != m_shaderPermutation)
 	{
-		int textureUnit = m_integerParams[textureIt.first];
-		glActiveTexture(GL_TEXTURE0 + textureUnit);
-		textureIt.second->Bind();
+		m_shaderPermutation = permutation;
+		m_bShaderDirty = true;
 	}
+}
 
-	for (const auto& mat4It : m_mat4Params)
+Shader* Material::GetShader()
+{
+	if (m_bShaderDirty)
 	{
-		m_shader->SetUniform(mat4It.first, mat4It.second);
+		UpdateShader();
 	}
+	return m_shader;
+}
 
-	for (const auto& vec4It : m_vec4Params)
+void Material::UpdateShader()
+{
+	// take the new reference first, so switching to the same shader never drops it to zero
+	Shader* pShader = ShaderManager::GetInstance()->CreateShader(m_vertexShader, m_fragmentShader, m_shaderPermutation);
+	ReleaseShader();
+	m_shader = pShader;
+	m_bShaderDirty = false;
+	m_bHandlesDirty = true;
+}
+
+void Material::ReleaseShader()
+{
+	if (m_shader)
 	{
-		m_shader->SetUniform(vec4It.first, vec4It.second);
+		m_shader->ReleaseUniforms(this);
+		ShaderManager::GetInstance()->DeleteShader(m_shader);
+		m_shader = nullptr;
 	}
+}
 
-	for (const auto& vec3It : m_vec3Params)
+void Material::ResolveHandles()
+{
+	const ShaderUniformBlock* pBlock = m_shader->FindUniformBlock(HashLiteral(MATERIAL_BLOCK_NAME));
+	const size_t blockSize = pBlock ? pBlock->dataSize : 0;
+	if (blockSize != m_blockData.size())
 	{
-		m_shader->SetUniform(vec3It.first, vec3It.second);
+		GLStateCache::GetInstance()->OnBufferDeleted(m_blockBuffer);
+		glDeleteBuffers(1, &m_blockBuffer);
+		m_blockBuffer = 0;
+		if (blockSize > 0)
+		{
+			glCreateBuffers(1, &m_blockBuffer);
+			glNamedBufferStorage(m_blockBuffer, static_cast<GLsizeiptr>(blockSize), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
 	}
+	m_blockData.assign(blockSize, 0);
+	m_blockBinding = pBlock ? pBlock->binding : 0;
+
+	auto Resolve = [this, pBlock](auto& params)
+	{
+		for (auto& param : params)
+		{
+			const ShaderUniform* pUniform = m_shader->FindUniform(param.nameHash);
+			const bool bInBlock = pUniform && pBlock && pUniform->blockIndex == static_cast<int>(pBlock->index);
+			param.handle = pUniform ? pUniform->location : INVALID_UNIFORM_HANDLE;
+			param.blockOffset = bInBlock ? pUniform->offset : -1;
+			WriteBlockParam(param);
+		}
+	};
+	Resolve(m_mat4Params);
+	Resolve(m_vec4Params);
+	Resolve(m_vec3Params);
+	Resolve(m_floatParams);
+	Resolve(m_integerParams);
 
-	for (const auto& floatIt : m_floatParams)
+	for (TextureParam& texture : m_textures)
 	{
-		m_shader->SetUniform(floatIt.first, floatIt.second);
+		texture.unitParam = -1;
+		for (size_t i = 0; i < m_integerParams.size(); ++i)
+		{
+			if (m_integerParams[i].nameHash == texture.nameHash)
+			{
+				texture.unitParam = static_cast<int>(i);
+				break;
+			}
+		}
 	}
 
-	for (const auto& integerIt : m_integerParams)
+	m_bHandlesDirty = false;
+	m_bBlockDirty = blockSize > 0;
+	m_bUniformsDirty = true;
+}
+
+template<typename T>
+void Material::SetParam(std::vector<Param<T>>& params, const std::string& name, const T& value)
+{
+	const hash_t nameHash = HashString(name);
+	for (Param<T>& param : params)
 	{
-		m_shader->SetUniform(integerIt.first, integerIt.second);
+		if (param.nameHash == nameHash)
+		{
+			param.value = value;
+			if (param.blockOffset >= 0)
+			{
+				WriteBlockParam(param);
+				m_bBlockDirty = true;
+			}
+			else
+			{
+				m_bUniformsDirty = true;
+			}
+			return;
+		}
 	}
+
+	params.push_back(Param<T>{ nameHash, INVALID_UNIFORM_HANDLE, -1, value });
+	m_bHandlesDirty = true;
 }
 
-void Material::SetShader(const std::string& vertexShader, const std::string& fragmentShader)
+template<typename T>
+void Material::WriteBlockParam(const Param<T>& param)
 {
-	m_shader = new Shader(vertexShader, fragmentShader);
+	// scalars, vectors and column major mat4s all have the same layout in std140 as in memory
+	if (param.blockOffset >= 0 && param.blockOffset + sizeof(T) <= m_blockData.size())
+	{
+		memcpy(m_blockData.data() + param.blockOffset, &param.value, sizeof(T));
+	}
 }
 
 void Material::SetMat4(const std::string& name, const glm::mat4& mat4)
 {
-	m_mat4Params[name] = mat4;
+	SetParam(m_mat4Params, name, mat4);
 }
 
 void Material::SetTexture(const std::string& name, Texture* pTexture)
 {
-	auto it = m_textures.find(name);
-	if (it != m_textures.end())
+	const hash_t nameHash = HashString(name);
+	for (TextureParam& texture : m_textures)
 	{
-		TextureManager::GetInstance()->DeleteTexture(it->second);
+		if (texture.nameHash == nameHash)
+		{
+			TextureManager::GetInstance()->DeleteTexture(texture.pTexture);
+			texture.pTexture = pTexture;
+			return;
+		}
 	}
 
-	m_textures[name] = pTexture;
+	m_textures.push_back(TextureParam{ nameHash, pTexture, -1 });
+	m_bHandlesDirty = true;
 }
 
 void Material::SetVec4(const std::string& name, const glm::vec4& vec4)
 {
-	m_vec4Params[name] = vec4;
+	SetParam(m_vec4Params, name, vec4);
 }
 
 void Material::SetVec3(const std::string& name, const glm::vec3& vec3)
 {
-	m_vec3Params[name] = vec3;
+	SetParam(m_vec3Params, name, vec3);
 }
 
 void Material::SetFloat(const std::string& name, float f)
 {
-	m_floatParams[name] = f;
+	SetParam(m_floatParams, name, f);
 }
 
 void Material::SetInteger(const std::string& name, int i)
 {
-	m_integerParams[name] = i;
+	SetParam(m_integerParams, name, i);
 }
\ No newline at end of file
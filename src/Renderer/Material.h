@@ -2,22 +2,47 @@
 #define MATERIAL_H
 
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 
-class Shader;
+#include "Shader.h"
+
 class Texture;
 
+// name of the std140 block a shader declares its per-material parameters in
+const char* const MATERIAL_BLOCK_NAME = "MaterialParams";
+
+// Shader parameters for a mesh. Names are only hashed when set, and their place in the shader is resolved once
+// whenever the shader or the set of parameters changes. Parameters that live in the shader's MaterialParams block are
+// packed into a std140 copy of it, which is uploaded to the material's own uniform buffer only when a value changes,
+// so applying them is a single buffer bind. Anything else is set as a plain uniform, and only when another material
+// has used the shader since or a value changed.
 class Material
 {
-public:
-	Material();
-	~Material();
+	friend class MaterialLibrary;
 
+public:
 	void ApplyParams();
 
+	const std::string& GetName() const { return m_name; }
+	// unique for the lifetime of the MaterialLibrary, 0 is never used
+	unsigned int GetId() const { return m_id; }
+
+	// the shader is only built on first use, once the features have been settled
 	void SetShader(const std::string& vertexShader, const std::string& fragmentShader);
+	void SetShaderFeature(ShaderFeature feature, bool bEnabled);
+	shaderPermutation_t GetShaderPermutation() const { return m_shaderPermutation; }
+	// builds the shader if it hasn't been yet
+	Shader* GetShader();
+
+	// translucent materials are drawn blended, back to front, after everything opaque
+	void SetTranslucent(bool bTranslucent) { m_bTranslucent = bTranslucent; }
+	bool IsTranslucent() const { return m_bTranslucent; }
+	// alpha tested materials discard fragments, so their meshes can have holes and can't be used as occluders
+	void SetAlphaTested(bool bAlphaTested) { m_bAlphaTested = bAlphaTested; }
+	bool IsAlphaTested() const { return m_bAlphaTested; }
+
 	void SetTexture(const std::string& name, Texture* pTexture);
 	void SetMat4(const std::string& name, const glm::mat4& mat4);
 	void SetVec4(const std::string& name, const glm::vec4& vec4);
@@ -26,13 +51,58 @@ public:
 	void SetInteger(const std::string& name, int i);
 
 private:
+	template<typename T>
+	struct Param
+	{
+		hash_t nameHash;
+		uniformHandle_t handle;
+		// offset in the material block, -1 if the param is a plain uniform (or not in the shader at all)
+		int blockOffset;
+		T value;
+	};
+
+	struct TextureParam
+	{
+		hash_t nameHash;
+		Texture* pTexture;
+		// index of the integer param holding the texture unit, -1 for unit 0
+		int unitParam;
+	};
+
+	Material();
+	~Material();
+
+	void UpdateShader();
+	void ResolveHandles();
+
+	template<typename T>
+	void SetParam(std::vector<Param<T>>& params, const std::string& name, const T& value);
+	template<typename T>
+	void WriteBlockParam(const Param<T>& param);
+	void ReleaseShader();
+
+	std::string m_name;
+	unsigned int m_id;
 	Shader* m_shader;
-	std::unordered_map<std::string, Texture*> m_textures;
-	std::unordered_map<std::string, glm::mat4> m_mat4Params;
-	std::unordered_map<std::string, glm::vec4> m_vec4Params;
-	std::unordered_map<std::string, glm::vec3> m_vec3Params;
-	std::unordered_map<std::string, float> m_floatParams;
-	std::unordered_map<std::string, int> m_integerParams;
+	std::string m_vertexShader;
+	std::string m_fragmentShader;
+	shaderPermutation_t m_shaderPermutation;
+	bool m_bShaderDirty;
+	bool m_bHandlesDirty;
+	bool m_bTranslucent;
+	bool m_bAlphaTested;
+	std::vector<TextureParam> m_textures;
+	std::vector<Param<glm::mat4>> m_mat4Params;
+	std::vector<Param<glm::vec4>> m_vec4Params;
+	std::vector<Param<glm::vec3>> m_vec3Params;
+	std::vector<Param<float>> m_floatParams;
+	std::vector<Param<int>> m_integerParams;
+
+	std::vector<unsigned char> m_blockData;
+	unsigned int m_blockBuffer;
+	unsigned int m_blockBinding;
+	bool m_bBlockDirty;
+	bool m_bUniformsDirty;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "MaterialLibrary.h"
+
+#include <cstdio>
+
+MaterialLibrary* MaterialLibrary::s_instance = nullptr;
+
+MaterialLibrary::MaterialLibrary()
+	: m_materials()
+	, m_nextId(1)
+{
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (auto& it : m_materials)
+	{
+		delete it.second.pMaterial;
+	}
+	m_materials.clear();
+}
+
+MaterialLibrary* MaterialLibrary::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new MaterialLibrary();
+	}
+
+	return s_instance;
+}
+
+Material* MaterialLibrary::CreateMaterial(const std::string& name, bool* pOutCreated)
+{
+	auto it = m_materials.find(name);
+	if (it != m_materials.end())
+	{
+		++it->second.refCount;
+		if (pOutCreated)
+		{
+			*pOutCreated = false;
+		}
+		return it->second.pMaterial;
+	}
+
+	Material* pMaterial = new Material();
+	pMaterial->m_name = name;
+	pMaterial->m_id = m_nextId++;
+	m_materials.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple(pMaterial, 1));
+	if (pOutCreated)
+	{
+		*pOutCreated = true;
+	}
+	return pMaterial;
+}
+
+void MaterialLibrary::DeleteMaterial(Material* pMaterial)
+{
+	auto it = m_materials.find(pMaterial->m_name);
+	if (it == m_materials.end())
+	{
+		printf("No material \"%s\" found in MaterialLibrary\n", pMaterial->m_name.c_str());
+		return;
+	}
+
+	if (--it->second.refCount == 0)
+	{
+		delete it->second.pMaterial;
+		m_materials.erase(it);
+	}
+}
+
+Material* MaterialLibrary::FindMaterial(const std::string& name) const
+{
+	auto it = m_materials.find(name);
+	return it != m_materials.end() ? it->second.pMaterial : nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef MATERIAL_LIBRARY_H
+#define MATERIAL_LIBRARY_H
+
+#include <string>
+#include <unordered_map>
+
+#include "Material.h"
+
+// Owns every Material, registered by name, so meshes that use the same source material share one instance (and
+// with it one parameter buffer and one set of texture references). Material ids are unique for the library's
+// lifetime, which makes them usable for sorting and batching draws.
+class MaterialLibrary
+{
+public:
+	~MaterialLibrary();
+
+	static MaterialLibrary* GetInstance();
+
+	// returns the material registered under name, creating an empty one if there isn't one yet. pOutCreated says
+	// whether it's new and still needs its shader and params set up. Every call needs a matching DeleteMaterial.
+	Material* CreateMaterial(const std::string& name, bool* pOutCreated = nullptr);
+	void DeleteMaterial(Material* pMaterial);
+
+	// doesn't add a reference
+	Material* FindMaterial(const std::string& name) const;
+
+	unsigned int GetNumMaterials() const { return static_cast<unsigned int>(m_materials.size()); }
+
+private:
+	struct Entry
+	{
+		Material* pMaterial = nullptr;
+		unsigned int refCount = 0;
+
+		Entry(Material* pMaterial, int refCount) : pMaterial(pMaterial), refCount(refCount) {}
+	};
+
+	MaterialLibrary();
+
+	std::unordered_map<std::string, Entry> m_materials;
+	unsigned int m_nextId;
+
+	static MaterialLibrary* s_instance;
+};
+
+#endif
\ No newline at end of file
@@ -2,70 +2,98 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstdint>
 #include <cstdio>
 #include <map>
 #include <unordered_map>
 
+#include "GLStateCache.h"
+#include "MeshBuffer.h"
+
 Mesh::Mesh()
-	: m_material()
-	, m_vertices()
-	, m_indices()
-	, m_vao(0)
-	, m_vbo(0)
-	, m_ebo(0)
+	: m_pMaterial(nullptr)
+	, m_aabb()
+	, m_boundingSphere()
+	, m_occlusionQuery()
+	, m_pBuffer(nullptr)
+	, m_bOwnsBuffer(false)
+	, m_numVertices(0)
+	, m_numIndices(0)
+	, m_firstIndex(0)
+	, m_baseVertex(0)
 {
-	m_material.SetShader("assets/shaders/blinnPhong.vert", "assets/shaders/blinnPhong.frag");
 }
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int> indices)
-	: m_vertices(vertices)
-	, m_indices(indices)
-	, m_vao(0)
-	, m_vbo(0)
-	, m_ebo(0)
+Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int> indices, Material* pMaterial)
+	: Mesh(vertices.data(), static_cast<unsigned int>(vertices.size()), indices.data(), static_cast<unsigned int>(indices.size()), pMaterial)
 {
-	GenerateBuffers();
-	m_material.SetShader("assets/shaders/blinnPhong.vert", "assets/shaders/blinnPhong.frag");
 }
 
-Mesh::~Mesh()
+// vertex and index data is uploaded straight from the given pointers (which may point into a mapped mesh cache)
+// and isn't retained on the CPU
+Mesh::Mesh(const Vertex* pVertices, unsigned int numVertices, const unsigned int* pIndices, unsigned int numIndices, Material* pMaterial)
+	: m_pMaterial(pMaterial)
+	, m_aabb()
+	, m_boundingSphere()
+	, m_occlusionQuery()
+	, m_pBuffer(new MeshBuffer(pVertices, numVertices, pIndices, numIndices))
+	, m_bOwnsBuffer(true)
+	, m_numVertices(numVertices)
+	, m_numIndices(numIndices)
+	, m_firstIndex(0)
+	, m_baseVertex(0)
 {
+	ComputeBounds(pVertices);
 }
 
-void Mesh::GenerateBuffers()
+Mesh::Mesh(MeshBuffer* pBuffer, const Vertex* pVertices, unsigned int numVertices, int baseVertex, unsigned int firstIndex, unsigned int numIndices, Material* pMaterial)
+	: m_pMaterial(pMaterial)
+	, m_aabb()
+	, m_boundingSphere()
+	, m_occlusionQuery()
+	, m_pBuffer(pBuffer)
+	, m_bOwnsBuffer(false)
+	, m_numVertices(numVertices)
+	, m_numIndices(numIndices)
+	, m_firstIndex(firstIndex)
+	, m_baseVertex(baseVertex)
 {
-	// generate buffers
-	glGenVertexArrays(1, &m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ebo);
+	ComputeBounds(pVertices);
+}
 
-	glBindVertexArray(m_vao);
+Mesh::~Mesh()
+{
+	if (m_bOwnsBuffer)
+	{
+		delete m_pBuffer;
+	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(), GL_STATIC_DRAW);
+unsigned int Mesh::GetVertexArray() const
+{
+	return m_pBuffer ? m_pBuffer->GetVertexArray() : 0;
+}
 
-	// NOTE: VAO stores any EBO bound, so don't unbind EBO until VAO is unbound
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+unsigned int Mesh::GetFirstIndex() const
+{
+	return m_pBuffer ? m_pBuffer->GetFirstIndex() + m_firstIndex : m_firstIndex;
+}
 
-	// position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-	glEnableVertexAttribArray(0);
-	// normals
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
-	// uvs
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(2);
+int Mesh::GetBaseVertex() const
+{
+	return m_pBuffer ? static_cast<int>(m_pBuffer->GetBaseVertex()) + m_baseVertex : m_baseVertex;
+}
 
-	// unbind buffers
-	glBindVertexArray(0);
+void Mesh::ComputeBounds(const Vertex* pVertices)
+{
+	m_aabb = ComputeAABB(&pVertices->position, m_numVertices, sizeof(Vertex));
+	m_boundingSphere = ComputeBoundingSphere(&pVertices->position, m_numVertices, m_aabb, sizeof(Vertex));
 }
 
 void Mesh::Draw()
 {
-	m_material.ApplyParams();
+	m_pMaterial->ApplyParams();
 
-	glBindVertexArray(m_vao);
-	glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, 0);
+	GLStateCache::GetInstance()->BindVertexArray(GetVertexArray());
+	glDrawElementsBaseVertex(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, reinterpret_cast<const void*>(static_cast<uintptr_t>(GetFirstIndex()) * sizeof(unsigned int)), GetBaseVertex());
 }
\ No newline at end of file
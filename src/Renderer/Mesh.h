@@ -6,9 +6,15 @@
 
 #include <glm/glm.hpp>
 
+#include "Bounds.h"
 #include "Material.h"
+#include "OcclusionQuery.h"
 #include "Texture.h"
 
+class MeshBuffer;
+
+// A range of a MeshBuffer's indices drawn with one material. Meshes created from their own vertices and indices get a
+// MeshBuffer of their own, while a model's meshes all share one.
 class Mesh
 {
 public:
@@ -22,23 +28,44 @@ public:
 	};
 
 	Mesh();
-	Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int> indices);
+	Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int> indices, Material* pMaterial);
+	Mesh(const Vertex* pVertices, unsigned int numVertices, const unsigned int* pIndices, unsigned int numIndices, Material* pMaterial);
+	// pVertices are the mesh's own vertices within the buffer, only read for the bounds
+	Mesh(MeshBuffer* pBuffer, const Vertex* pVertices, unsigned int numVertices, int baseVertex, unsigned int firstIndex, unsigned int numIndices, Material* pMaterial);
 	~Mesh();
 
-	Material& GetMaterial() { return m_material; }
+	// shared with other meshes and owned by MaterialLibrary, whoever created the mesh holds the reference
+	Material* GetMaterial() const { return m_pMaterial; }
+
+	MeshBuffer* GetBuffer() const { return m_pBuffer; }
+	unsigned int GetVertexArray() const;
+	unsigned int GetNumIndices() const { return m_numIndices; }
+	// into the GeometryPool, so they can change from frame to frame as it's compacted
+	unsigned int GetFirstIndex() const;
+	int GetBaseVertex() const;
+	// local space bounds, computed from the vertices when the mesh is created
+	const AABB& GetAABB() const { return m_aabb; }
+	const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+	// only used by meshes of models with occlusion queries turned on
+	OcclusionQuery& GetOcclusionQuery() { return m_occlusionQuery; }
 
 	void Draw();
 
 private:
-	void GenerateBuffers();
+	void ComputeBounds(const Vertex* pVertices);
 
-	Material m_material;
-	std::vector<Vertex> m_vertices;
-	std::vector<unsigned int> m_indices;
+	Material* m_pMaterial;
+	AABB m_aabb;
+	BoundingSphere m_boundingSphere;
+	OcclusionQuery m_occlusionQuery;
 
-	unsigned int m_vao;
-	unsigned int m_vbo;
-	unsigned int m_ebo;
+	MeshBuffer* m_pBuffer;
+	bool m_bOwnsBuffer;
+	unsigned int m_numVertices;
+	unsigned int m_numIndices;
+	// relative to the start of m_pBuffer's ranges
+	unsigned int m_firstIndex;
+	int m_baseVertex;
 };
 
 #endif
\ No newline at end of file
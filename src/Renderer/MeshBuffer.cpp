@@ -0,0 +1,42 @@
+#include "MeshBuffer.h"
+
+#include "GeometryPool.h"
+
+MeshBuffer::MeshBuffer(const Mesh::Vertex* pVertices, unsigned int numVertices, const unsigned int* pIndices, unsigned int numIndices)
+	: m_vertexHandle(INVALID_POOL_HANDLE)
+	, m_indexHandle(INVALID_POOL_HANDLE)
+	, m_numVertices(numVertices)
+	, m_numIndices(numIndices)
+{
+	GeometryPool* pPool = GeometryPool::GetInstance();
+	m_vertexHandle = pPool->GetVertexPool().Allocate(pVertices, numVertices);
+	m_indexHandle = pPool->GetIndexPool().Allocate(pIndices, numIndices);
+}
+
+MeshBuffer::~MeshBuffer()
+{
+	GeometryPool* pPool = GeometryPool::GetInstance();
+	if (m_vertexHandle != INVALID_POOL_HANDLE)
+	{
+		pPool->GetVertexPool().Free(m_vertexHandle);
+	}
+	if (m_indexHandle != INVALID_POOL_HANDLE)
+	{
+		pPool->GetIndexPool().Free(m_indexHandle);
+	}
+}
+
+unsigned int MeshBuffer::GetVertexArray() const
+{
+	return GeometryPool::GetInstance()->GetVertexArray();
+}
+
+unsigned int MeshBuffer::GetBaseVertex() const
+{
+	return m_vertexHandle != INVALID_POOL_HANDLE ? GeometryPool::GetInstance()->GetVertexPool().GetOffset(m_vertexHandle) : 0;
+}
+
+unsigned int MeshBuffer::GetFirstIndex() const
+{
+	return m_indexHandle != INVALID_POOL_HANDLE ? GeometryPool::GetInstance()->GetIndexPool().GetOffset(m_indexHandle) : 0;
+}
\ No newline at end of file
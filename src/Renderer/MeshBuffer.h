@@ -0,0 +1,30 @@
+#ifndef MESH_BUFFER_H
+#define MESH_BUFFER_H
+
+#include "Mesh.h"
+
+// Vertices and indices of any number of meshes, each in one range of the GeometryPool, so draws of different meshes
+// need no rebinding between them and can be issued together with a multi draw. Each mesh's indices are relative to
+// its base vertex. The ranges are freed along with the MeshBuffer.
+class MeshBuffer
+{
+public:
+	MeshBuffer(const Mesh::Vertex* pVertices, unsigned int numVertices, const unsigned int* pIndices, unsigned int numIndices);
+	~MeshBuffer();
+
+	// the GeometryPool's, shared by every MeshBuffer
+	unsigned int GetVertexArray() const;
+	// where the ranges currently are in the pool, which changes when it's compacted
+	unsigned int GetBaseVertex() const;
+	unsigned int GetFirstIndex() const;
+	unsigned int GetNumVertices() const { return m_numVertices; }
+	unsigned int GetNumIndices() const { return m_numIndices; }
+
+private:
+	unsigned int m_vertexHandle;
+	unsigned int m_indexHandle;
+	unsigned int m_numVertices;
+	unsigned int m_numIndices;
+};
+
+#endif
\ No newline at end of file
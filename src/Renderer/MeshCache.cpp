@@ -0,0 +1,259 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <sstream>
+
+namespace
+{
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~static_cast<uint64_t>(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	uint32_t AppendString(std::vector<char>& stringTable, const std::string& str)
+	{
+		if (str.empty())
+		{
+			return MESH_CACHE_INVALID_STRING;
+		}
+
+		uint32_t offset = static_cast<uint32_t>(stringTable.size());
+		stringTable.insert(stringTable.end(), str.begin(), str.end());
+		stringTable.push_back('\0');
+		return offset;
+	}
+
+	bool WriteSection(FILE* pFile, uint64_t offset, const void* pData, size_t size)
+	{
+		static const char padding[MESH_CACHE_ALIGNMENT] = {};
+
+		long position = std::ftell(pFile);
+		if (position < 0 || static_cast<uint64_t>(position) > offset)
+		{
+			return false;
+		}
+
+		size_t paddingSize = static_cast<size_t>(offset - position);
+		return std::fwrite(padding, 1, paddingSize, pFile) == paddingSize && std::fwrite(pData, 1, size, pFile) == size;
+	}
+}
+
+bool WriteMeshCache(const std::string& filename, hash_t sourceHash, const ModelData& data)
+{
+	std::vector<MeshCacheMaterial> materials(data.materials.size());
+	std::vector<char> stringTable;
+	for (size_t i = 0; i < data.materials.size(); ++i)
+	{
+		materials[i].shininess = data.materials[i].shininess;
+		materials[i].diffuseTexture = AppendString(stringTable, data.materials[i].diffuseTexture);
+		materials[i].specularTexture = AppendString(stringTable, data.materials[i].specularTexture);
+		materials[i].opacityTexture = AppendString(stringTable, data.materials[i].opacityTexture);
+	}
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.numSubmeshes = static_cast<uint32_t>(data.submeshes.size());
+	header.numMaterials = static_cast<uint32_t>(materials.size());
+	header.numVertices = static_cast<uint32_t>(data.vertices.size());
+	header.numIndices = static_cast<uint32_t>(data.indices.size());
+	header.stringTableSize = static_cast<uint32_t>(stringTable.size());
+
+	const size_t submeshesSize = data.submeshes.size() * sizeof(ModelData::Submesh);
+	const size_t materialsSize = materials.size() * sizeof(MeshCacheMaterial);
+	const size_t verticesSize = data.vertices.size() * sizeof(Mesh::Vertex);
+	const size_t indicesSize = data.indices.size() * sizeof(unsigned int);
+
+	header.submeshesOffset = static_cast<uint32_t>(AlignOffset(sizeof(MeshCacheHeader)));
+	header.materialsOffset = static_cast<uint32_t>(AlignOffset(header.submeshesOffset + submeshesSize));
+	header.stringTableOffset = static_cast<uint32_t>(AlignOffset(header.materialsOffset + materialsSize));
+	header.verticesOffset = AlignOffset(header.stringTableOffset + stringTable.size());
+	header.indicesOffset = AlignOffset(header.verticesOffset + verticesSize);
+
+	// write to a temporary file first so an interrupted bake never leaves a truncated cache behind
+	const std::string tempFilename = filename + ".tmp";
+	FILE* pFile = fopen(tempFilename.c_str(), "wb");
+	if (!pFile)
+	{
+		printf("Failed to open mesh cache \"%s\" for writing\n", tempFilename.c_str());
+		return false;
+	}
+
+	bool bSuccess = WriteSection(pFile, 0, &header, sizeof(header))
+		&& WriteSection(pFile, header.submeshesOffset, data.submeshes.data(), submeshesSize)
+		&& WriteSection(pFile, header.materialsOffset, materials.data(), materialsSize)
+		&& WriteSection(pFile, header.stringTableOffset, stringTable.data(), stringTable.size())
+		&& WriteSection(pFile, header.verticesOffset, data.vertices.data(), verticesSize)
+		&& WriteSection(pFile, header.indicesOffset, data.indices.data(), indicesSize);
+	bSuccess = (std::fclose(pFile) == 0) && bSuccess;
+
+	if (bSuccess)
+	{
+		std::remove(filename.c_str());
+		bSuccess = std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+	}
+
+	if (!bSuccess)
+	{
+		printf("Failed to write mesh cache \"%s\"\n", filename.c_str());
+		std::remove(tempFilename.c_str());
+	}
+	return bSuccess;
+}
+
+std::vector<std::string> GetModelDependencies(const std::string& filename)
+{
+	std::vector<std::string> dependencies;
+	const size_t extensionPos = filename.find_last_of('.');
+	File file;
+	if (extensionPos == filename.npos || filename.compare(extensionPos, filename.npos, ".obj") != 0 || !FileSystem::GetInstance()->Open(filename, file))
+	{
+		return dependencies;
+	}
+
+	const size_t directoryEnd = filename.find_last_of("/\\");
+	const std::string directory = directoryEnd == filename.npos ? "" : filename.substr(0, directoryEnd + 1);
+	std::istringstream lines(std::string(reinterpret_cast<const char*>(file.GetData()), file.GetSize()));
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		if (line.compare(0, 7, "mtllib ") != 0)
+		{
+			continue;
+		}
+
+		std::istringstream libraries(line.substr(7));
+		std::string library;
+		while (libraries >> library)
+		{
+			dependencies.push_back(directory + library);
+		}
+	}
+
+	return dependencies;
+}
+
+bool GetModelSourceHash(const std::string& filename, hash_t& outHash)
+{
+	FileSystem* pFileSystem = FileSystem::GetInstance();
+	if (!pFileSystem->GetFileHash(filename, outHash))
+	{
+		return false;
+	}
+
+	for (const std::string& dependency : GetModelDependencies(filename))
+	{
+		hash_t dependencyHash = 0;
+		pFileSystem->GetFileHash(dependency, dependencyHash);
+		outHash = HashBytes(&dependencyHash, sizeof(dependencyHash), outHash);
+	}
+	return true;
+}
+
+MeshCache::MeshCache()
+	: m_file()
+	, m_pHeader(nullptr)
+	, m_pSubmeshes(nullptr)
+	, m_pMaterials(nullptr)
+	, m_pStringTable(nullptr)
+	, m_pVertices(nullptr)
+	, m_pIndices(nullptr)
+{
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+bool MeshCache::Open(const std::string& filename, hash_t sourceHash)
+{
+	Close();
+
+	if (!FileSystem::GetInstance()->Open(filename, m_file))
+	{
+		return false;
+	}
+
+	const unsigned char* pData = m_file.GetData();
+	const size_t size = m_file.GetSize();
+	if (size < sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	const MeshCacheHeader* pHeader = reinterpret_cast<const MeshCacheHeader*>(pData);
+	if (pHeader->magic != MESH_CACHE_MAGIC || pHeader->version != MESH_CACHE_VERSION || pHeader->sourceHash != sourceHash)
+	{
+		Close();
+		return false;
+	}
+
+	// make sure a truncated or corrupt file can't send us reading past the end of the mapping
+	const bool bValidLayout = pHeader->submeshesOffset + static_cast<uint64_t>(pHeader->numSubmeshes) * sizeof(ModelData::Submesh) <= size
+		&& pHeader->materialsOffset + static_cast<uint64_t>(pHeader->numMaterials) * sizeof(MeshCacheMaterial) <= size
+		&& pHeader->stringTableOffset + static_cast<uint64_t>(pHeader->stringTableSize) <= size
+		&& pHeader->verticesOffset + static_cast<uint64_t>(pHeader->numVertices) * sizeof(Mesh::Vertex) <= size
+		&& pHeader->indicesOffset + static_cast<uint64_t>(pHeader->numIndices) * sizeof(unsigned int) <= size
+		&& (pHeader->stringTableSize == 0 || pData[pHeader->stringTableOffset + pHeader->stringTableSize - 1] == '\0');
+	if (!bValidLayout)
+	{
+		printf("Mesh cache \"%s\" is corrupt\n", filename.c_str());
+		Close();
+		return false;
+	}
+
+	// the submeshes are handed straight to Mesh, so their ranges have to be inside the arrays too
+	const ModelData::Submesh* pSubmeshes = reinterpret_cast<const ModelData::Submesh*>(pData + pHeader->submeshesOffset);
+	for (uint32_t i = 0; i < pHeader->numSubmeshes; ++i)
+	{
+		const ModelData::Submesh& submesh = pSubmeshes[i];
+		if (static_cast<uint64_t>(submesh.firstVertex) + submesh.numVertices > pHeader->numVertices
+			|| static_cast<uint64_t>(submesh.firstIndex) + submesh.numIndices > pHeader->numIndices)
+		{
+			printf("Mesh cache \"%s\" is corrupt\n", filename.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	m_pHeader = pHeader;
+	m_pSubmeshes = pSubmeshes;
+	m_pMaterials = reinterpret_cast<const MeshCacheMaterial*>(pData + pHeader->materialsOffset);
+	m_pStringTable = reinterpret_cast<const char*>(pData + pHeader->stringTableOffset);
+	m_pVertices = reinterpret_cast<const Mesh::Vertex*>(pData + pHeader->verticesOffset);
+	m_pIndices = reinterpret_cast<const unsigned int*>(pData + pHeader->indicesOffset);
+	return true;
+}
+
+void MeshCache::Close()
+{
+	m_file.Close();
+	m_pHeader = nullptr;
+	m_pSubmeshes = nullptr;
+	m_pMaterials = nullptr;
+	m_pStringTable = nullptr;
+	m_pVertices = nullptr;
+	m_pIndices = nullptr;
+}
+
+void MeshCache::GetMaterial(unsigned int index, ModelData::MaterialDesc& outMaterial) const
+{
+	const MeshCacheMaterial& material = m_pMaterials[index];
+	outMaterial.shininess = material.shininess;
+	outMaterial.diffuseTexture = GetString(material.diffuseTexture);
+	outMaterial.specularTexture = GetString(material.specularTexture);
+	outMaterial.opacityTexture = GetString(material.opacityTexture);
+}
+
+const char* MeshCache::GetString(uint32_t offset) const
+{
+	if (offset == MESH_CACHE_INVALID_STRING || offset >= m_pHeader->stringTableSize)
+	{
+		return "";
+	}
+
+	return m_pStringTable + offset;
+}
\ No newline at end of file
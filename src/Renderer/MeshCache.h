@@ -0,0 +1,92 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Core/Hash.h"
+#include "Core/FileSystem.h"
+#include "ModelImporter.h"
+
+// Baked binary form of ModelData, written next to the source model the first time it's imported. The file is
+// laid out so that it can be mapped and its vertex/index ranges handed straight to Mesh without any parsing.
+//
+// layout: header | submeshes | materials | string table | vertices | indices
+// every section starts on a MESH_CACHE_ALIGNMENT boundary
+
+const char* const MESH_CACHE_EXTENSION = ".omesh";
+const uint32_t MESH_CACHE_MAGIC = 0x48534D4F; // "OMSH"
+// bump whenever the layout or the import settings in ImportModelData change
+const uint32_t MESH_CACHE_VERSION = 2;
+const uint32_t MESH_CACHE_ALIGNMENT = 16;
+const uint32_t MESH_CACHE_INVALID_STRING = 0xFFFFFFFF;
+
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	hash_t sourceHash;
+	uint32_t numSubmeshes;
+	uint32_t numMaterials;
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint32_t stringTableSize;
+	uint32_t submeshesOffset;
+	uint32_t materialsOffset;
+	uint32_t stringTableOffset;
+	uint64_t verticesOffset;
+	uint64_t indicesOffset;
+};
+
+struct MeshCacheMaterial
+{
+	float shininess;
+	// offsets into the string table, MESH_CACHE_INVALID_STRING if unused
+	uint32_t diffuseTexture;
+	uint32_t specularTexture;
+	uint32_t opacityTexture;
+};
+
+bool WriteMeshCache(const std::string& filename, hash_t sourceHash, const ModelData& data);
+
+// other files a model pulls in while importing, in the same form as filename. Only .obj material libraries for now.
+std::vector<std::string> GetModelDependencies(const std::string& filename);
+// the hash a cache is built against, covering the model and everything it depends on so editing a material
+// library rebuilds it too. A missing dependency still counts, so the cache is rebuilt once it shows up.
+bool GetModelSourceHash(const std::string& filename, hash_t& outHash);
+
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	// maps the cache file and validates it against the hash of the model it was baked from
+	bool Open(const std::string& filename, hash_t sourceHash);
+	void Close();
+
+	unsigned int GetNumSubmeshes() const { return m_pHeader->numSubmeshes; }
+	unsigned int GetNumMaterials() const { return m_pHeader->numMaterials; }
+	unsigned int GetNumVertices() const { return m_pHeader->numVertices; }
+	unsigned int GetNumIndices() const { return m_pHeader->numIndices; }
+
+	const ModelData::Submesh* GetSubmeshes() const { return m_pSubmeshes; }
+	const Mesh::Vertex* GetVertices() const { return m_pVertices; }
+	const unsigned int* GetIndices() const { return m_pIndices; }
+
+	void GetMaterial(unsigned int index, ModelData::MaterialDesc& outMaterial) const;
+
+private:
+	const char* GetString(uint32_t offset) const;
+
+	File m_file;
+	const MeshCacheHeader* m_pHeader;
+	const ModelData::Submesh* m_pSubmeshes;
+	const MeshCacheMaterial* m_pMaterials;
+	const char* m_pStringTable;
+	const Mesh::Vertex* m_pVertices;
+	const unsigned int* m_pIndices;
+};
+
+#endif
\ No newline at end of file
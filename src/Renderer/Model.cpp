@@ -1,28 +1,55 @@
 #include "Model.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
+#include <algorithm>
+#include <cmath>
+
 #include <glm/glm.hpp>
 
+#include "MaterialLibrary.h"
+#include "MeshBuffer.h"
+#include "MeshCache.h"
 #include "TextureManager.h"
 
-// TEMP
-#include "Core/InputManager.h"
+namespace
+{
+	const char* const DEFAULT_VERTEX_SHADER = "assets/shaders/blinnPhong.vert";
+	const char* const DEFAULT_FRAGMENT_SHADER = "assets/shaders/blinnPhong.frag";
+
+	// meshes smaller than this fraction of the model's radius hide too little to be worth rasterizing as occluders
+	const float MIN_OCCLUDER_RADIUS = 0.1f;
+	// occluder triangles with edges shorter than about this fraction of the model's diagonal are too small to matter
+	const float MIN_OCCLUDER_TRIANGLE_SIZE = 1.0f / 200.0f;
+}
 
 Model::Model()
 	: m_meshes()
+	, m_pMeshBuffer(nullptr)
+	, m_materials()
 	, m_directory("")
+	, m_aabb()
+	, m_boundingSphere()
+	, m_positions()
+	, m_indices()
+	, m_meshFirstTriangles()
+	, m_triangleBvh()
+	, m_meshBounds()
+	, m_meshBvh()
+	, m_occluder()
+	, m_bOcclusionQueries(false)
+	, m_gpuDrawList()
+	, m_bGpuDriven(false)
+	, m_transform(1.0f)
 {
 }
 
 Model::~Model()
 {
+	Clear();
 }
 
 void Model::LoadModel(const std::string& filename)
 {
-	m_meshes.clear();
+	Clear();
 
 	size_t directorySeperatorPos = filename.find_last_of('/');
 	if (directorySeperatorPos == filename.npos)
@@ -35,133 +62,365 @@ void Model::LoadModel(const std::string& filename)
 	}
 	m_directory = filename.substr(0, directorySeperatorPos + 1);
 
-	Assimp::Importer importer;
-	unsigned int postProcessFlags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes;
-	const aiScene* pScene = importer.ReadFile(filename, postProcessFlags);
-	if (!pScene || !pScene->mRootNode || pScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)
+	hash_t sourceHash = 0;
+	if (!GetModelSourceHash(filename, sourceHash))
+	{
+		printf("Error loading model \"%s\": failed to read file\n", filename.c_str());
+		return;
+	}
+
+	// use the baked mesh cache when it was built from this exact source file and material libraries, otherwise go
+	// through assimp and (re)write the cache for next time
+	const std::string cacheFilename = filename + MESH_CACHE_EXTENSION;
+	MeshCache cache;
+	if (cache.Open(cacheFilename, sourceHash))
+	{
+		std::vector<ModelData::MaterialDesc> materials(cache.GetNumMaterials());
+		for (unsigned int i = 0; i < cache.GetNumMaterials(); ++i)
+		{
+			cache.GetMaterial(i, materials[i]);
+		}
+
+		CreateMaterials(filename, materials);
+		CreateMeshes(cache.GetVertices(), cache.GetIndices(), cache.GetSubmeshes(), cache.GetNumSubmeshes());
+		return;
+	}
+
+	ModelData data;
+	if (!ImportModelData(filename, data))
 	{
-		printf("Error loading model \"%s\": %s\n", filename.c_str(), importer.GetErrorString());
 		return;
 	}
 
-	m_meshes.reserve(pScene->mNumMeshes);
-	ProcessAssimpNode(pScene->mRootNode, pScene);
+	WriteMeshCache(cacheFilename, sourceHash, data);
+	CreateMaterials(filename, data.materials);
+	CreateMeshes(data.vertices.data(), data.indices.data(), data.submeshes.data(), static_cast<unsigned int>(data.submeshes.size()));
 }
 
-void Model::Draw() const
+void Model::Submit(RenderQueue& queue) const
 {
 	for (const auto it : m_meshes)
 	{
-		it->Draw();
+		// the GPU driven path only draws opaque meshes, translucent ones still need sorting back to front
+		if (m_bGpuDriven && !it->GetMaterial()->IsTranslucent())
+		{
+			continue;
+		}
+		queue.Submit(it, m_transform, RP_MAIN, m_bOcclusionQueries);
 	}
+}
 
-	//static int i = 0;
-	//static bool bWaitForUp = false;
-	//if (bWaitForUp)
-	//{
-	//	bWaitForUp = InputManager::GetInstance()->GetKeyState(Key::KEY_ENTER) == KeyState::KS_DOWN;
-	//}
-	//else if (InputManager::GetInstance()->GetKeyState(Key::KEY_ENTER) == KeyState::KS_DOWN)
-	//{
-	//	i = (i + 1) % m_meshes.size();
-	//	bWaitForUp = true;
-	//}
+void Model::SubmitOccluders(OcclusionCuller& culler) const
+{
+	if (!m_occluder.indices.empty())
+	{
+		culler.AddOccluder(m_occluder, m_transform);
+	}
+}
 
-	//m_meshes[i].Draw();
+void Model::SetGpuDriven(bool bEnabled)
+{
+	if (bEnabled && m_gpuDrawList.IsEmpty())
+	{
+		printf("Error. GPU driven drawing isn't available for this model\n");
+		return;
+	}
+
+	m_bGpuDriven = bEnabled;
+}
+
+void Model::DrawGpuDriven(GpuCuller& culler, GpuCullPass pass)
+{
+	if (m_bGpuDriven)
+	{
+		culler.Draw(m_gpuDrawList, pass);
+	}
+}
+
+bool Model::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ModelRaycastHit& outHit) const
+{
+	// an affine transform keeps distances along the ray in the same multiples of its direction, so the ray goes into
+	// model space rather than every triangle out of it
+	const glm::mat4 invTransform = glm::inverse(m_transform);
+	const glm::vec3 localOrigin = glm::vec3(invTransform * glm::vec4(origin, 1.0f));
+	const glm::vec3 localDirection = glm::vec3(invTransform * glm::vec4(direction, 0.0f));
+
+	unsigned int hitTriangle = 0;
+	auto IntersectTriangle = [&](unsigned int triangle, float& inOutDistance) -> bool
+	{
+		// Moller-Trumbore
+		const glm::vec3& p0 = m_positions[m_indices[triangle * 3 + 0]];
+		const glm::vec3 edge1 = m_positions[m_indices[triangle * 3 + 1]] - p0;
+		const glm::vec3 edge2 = m_positions[m_indices[triangle * 3 + 2]] - p0;
+		const glm::vec3 p = glm::cross(localDirection, edge2);
+		const float determinant = glm::dot(edge1, p);
+		if (std::fabs(determinant) < 1e-12f)
+		{
+			return false;
+		}
+
+		const float invDeterminant = 1.0f / determinant;
+		const glm::vec3 toOrigin = localOrigin - p0;
+		const float u = glm::dot(toOrigin, p) * invDeterminant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+		const glm::vec3 q = glm::cross(toOrigin, edge1);
+		const float v = glm::dot(localDirection, q) * invDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+		const float distance = glm::dot(edge2, q) * invDeterminant;
+		if (distance < 0.0f || distance >= inOutDistance)
+		{
+			return false;
+		}
+
+		inOutDistance = distance;
+		hitTriangle = triangle;
+		return true;
+	};
+
+	float distance = maxDistance;
+	if (!m_triangleBvh.Raycast(localOrigin, localDirection, maxDistance, IntersectTriangle, distance))
+	{
+		return false;
+	}
+
+	const size_t meshIndex = std::upper_bound(m_meshFirstTriangles.begin(), m_meshFirstTriangles.end(), hitTriangle) - m_meshFirstTriangles.begin() - 1;
+	outHit.distance = distance;
+	outHit.position = origin + direction * distance;
+	outHit.pMesh = m_meshes[meshIndex];
+	outHit.triangle = hitTriangle;
+	return true;
+}
+
+void Model::QueryMeshes(const AABB& aabb, std::vector<Mesh*>& outMeshes) const
+{
+	std::vector<unsigned int> meshIndices;
+	m_meshBvh.QueryAABB(aabb, meshIndices);
+	for (unsigned int meshIndex : meshIndices)
+	{
+		outMeshes.push_back(m_meshes[meshIndex]);
+	}
+}
+
+void Model::QueryMeshes(const Frustum& frustum, std::vector<Mesh*>& outMeshes) const
+{
+	std::vector<unsigned int> meshIndices;
+	m_meshBvh.QueryFrustum(frustum, meshIndices);
+	for (unsigned int meshIndex : meshIndices)
+	{
+		outMeshes.push_back(m_meshes[meshIndex]);
+	}
 }
 
 // TEMP
 void Model::SetTransform(const glm::mat4& transform)
 {
 	m_transform = transform;
+	UpdateMeshBvh();
+	m_gpuDrawList.SetTransform(m_transform);
+}
 
+void Model::Clear()
+{
 	for (auto it : m_meshes)
 	{
-		it->GetMaterial().SetMat4("model", m_transform);
+		delete it;
+	}
+	m_meshes.clear();
+	m_gpuDrawList.Clear();
+	m_bGpuDriven = false;
+	delete m_pMeshBuffer;
+	m_pMeshBuffer = nullptr;
+
+	for (auto it : m_materials)
+	{
+		MaterialLibrary::GetInstance()->DeleteMaterial(it);
+	}
+	m_materials.clear();
+
+	m_aabb = AABB();
+	m_boundingSphere = BoundingSphere();
+
+	m_positions.clear();
+	m_indices.clear();
+	m_meshFirstTriangles.clear();
+	m_triangleBvh.Clear();
+	m_meshBounds.clear();
+	m_meshBvh.Clear();
+	m_occluder = OccluderMesh();
+}
+
+void Model::CreateMaterials(const std::string& filename, const std::vector<ModelData::MaterialDesc>& materials)
+{
+	// named after the model and the material's index in it, so loading the same model again shares them too
+	MaterialLibrary* pLibrary = MaterialLibrary::GetInstance();
+	m_materials.reserve(materials.size() + 1);
+	for (size_t i = 0; i <= materials.size(); ++i)
+	{
+		const bool bDefault = i == materials.size();
+		bool bCreated = false;
+		Material* pMaterial = pLibrary->CreateMaterial(bDefault ? filename + "#default" : filename + "#" + std::to_string(i), &bCreated);
+		if (bCreated)
+		{
+			pMaterial->SetShader(DEFAULT_VERTEX_SHADER, DEFAULT_FRAGMENT_SHADER);
+			// every mesh is drawn through the render queue's multi draws or the GPU culler, both of which supply
+			// the model matrix as per draw data
+			pMaterial->SetShaderFeature(SF_DRAW_DATA, true);
+			if (!bDefault)
+			{
+				ApplyMaterialDesc(*pMaterial, materials[i]);
+			}
+		}
+		m_materials.push_back(pMaterial);
+	}
+}
+
+void Model::CreateMeshes(const Mesh::Vertex* pVertices, const unsigned int* pIndices, const ModelData::Submesh* pSubmeshes, unsigned int numSubmeshes)
+{
+	// the submeshes already share one vertex and index array, with indices relative to each one's first vertex, so
+	// they go into one buffer as they are
+	unsigned int numVertices = 0;
+	unsigned int numIndices = 0;
+	for (unsigned int i = 0; i < numSubmeshes; ++i)
+	{
+		numVertices = std::max(numVertices, pSubmeshes[i].firstVertex + pSubmeshes[i].numVertices);
+		numIndices = std::max(numIndices, pSubmeshes[i].firstIndex + pSubmeshes[i].numIndices);
+	}
+	m_pMeshBuffer = new MeshBuffer(pVertices, numVertices, pIndices, numIndices);
+
+	m_meshes.reserve(numSubmeshes);
+	for (unsigned int i = 0; i < numSubmeshes; ++i)
+	{
+		const ModelData::Submesh& submesh = pSubmeshes[i];
+		Material* pMaterial = submesh.materialIndex < m_materials.size() - 1 ? m_materials[submesh.materialIndex] : m_materials.back();
+		Mesh* mesh = new Mesh(m_pMeshBuffer, pVertices + submesh.firstVertex, submesh.numVertices, static_cast<int>(submesh.firstVertex), submesh.firstIndex, submesh.numIndices, pMaterial);
+		m_meshes.push_back(mesh);
+
+		m_aabb = i == 0 ? mesh->GetAABB() : MergeAABB(m_aabb, mesh->GetAABB());
+		m_boundingSphere = i == 0 ? mesh->GetBoundingSphere() : MergeBoundingSphere(m_boundingSphere, mesh->GetBoundingSphere());
+	}
+
+	BuildTriangleBvh(pVertices, pIndices, pSubmeshes, numSubmeshes);
+	UpdateMeshBvh();
+	CreateOccluder();
+
+	if (GpuCuller::IsSupported())
+	{
+		m_gpuDrawList.Create(m_meshes);
+		m_gpuDrawList.SetTransform(m_transform);
 	}
 }
 
-void Model::ProcessAssimpNode(const aiNode* pNode, const aiScene* pScene)
+void Model::ApplyMaterialDesc(Material& material, const ModelData::MaterialDesc& materialDesc)
 {
-	for (unsigned int i = 0; i < pNode->mNumMeshes; ++i)
+	material.SetFloat("shininess", materialDesc.shininess);
+
+	if (!materialDesc.diffuseTexture.empty())
 	{
-		m_meshes.push_back(ProcessAssimpMesh(pScene->mMeshes[pNode->mMeshes[i]], pScene));
+		TextureParams params;
+		bool isSRGB = false;
+		GetMaterialTextureParams(MTS_DIFFUSE, params, isSRGB);
+		Texture* pDiffuse = TextureManager::GetInstance()->CreateTextureAsync(m_directory + materialDesc.diffuseTexture, params, isSRGB);
+		material.SetInteger("diffuseMap", 0);
+		material.SetTexture("diffuseMap", pDiffuse);
+		material.SetShaderFeature(SF_DIFFUSE_MAP, true);
+		// the shader discards on the diffuse map's alpha, which only has holes cut into it where there's an opacity mask
+		material.SetAlphaTested(!materialDesc.opacityTexture.empty());
 	}
 
-	for (unsigned int i = 0; i < pNode->mNumChildren; ++i)
+	if (!materialDesc.specularTexture.empty())
 	{
-		ProcessAssimpNode(pNode->mChildren[i], pScene);
+		TextureParams params;
+		bool isSRGB = false;
+		GetMaterialTextureParams(MTS_SPECULAR, params, isSRGB);
+		Texture* pSpecular = TextureManager::GetInstance()->CreateTextureAsync(m_directory + materialDesc.specularTexture, params, isSRGB);
+		material.SetInteger("specularMap", 1);
+		material.SetTexture("specularMap", pSpecular);
+		material.SetShaderFeature(SF_SPECULAR_MAP, true);
 	}
 }
 
-Mesh* Model::ProcessAssimpMesh(const aiMesh* pMesh, const aiScene* pScene)
+void Model::BuildTriangleBvh(const Mesh::Vertex* pVertices, const unsigned int* pIndices, const ModelData::Submesh* pSubmeshes, unsigned int numSubmeshes)
 {
-	std::vector<Mesh::Vertex> vertices;
-	vertices.reserve(pMesh->mNumVertices);
-	for (unsigned int i = 0; i < pMesh->mNumVertices; ++i)
+	unsigned int numVertices = 0;
+	unsigned int numIndices = 0;
+	for (unsigned int i = 0; i < numSubmeshes; ++i)
 	{
-		glm::vec3 pos(0.0f);
-		pos.x = pMesh->mVertices[i].x;
-		pos.y = pMesh->mVertices[i].y;
-		pos.z = pMesh->mVertices[i].z;
+		numVertices = std::max(numVertices, pSubmeshes[i].firstVertex + pSubmeshes[i].numVertices);
+		numIndices += pSubmeshes[i].numIndices;
+	}
 
-		glm::vec3 norm(0.0f, 0.0f, 1.0f);
-		norm.x = pMesh->mNormals[i].x;
-		norm.y = pMesh->mNormals[i].y;
-		norm.z = pMesh->mNormals[i].z;
+	m_positions.resize(numVertices);
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		m_positions[i] = pVertices[i].position;
+	}
 
-		glm::vec2 texCoords(0.0f);
-		if (pMesh->mTextureCoords[0])
+	// submesh indices are relative to the submesh's first vertex, the kept ones index m_positions directly
+	m_indices.reserve(numIndices);
+	m_meshFirstTriangles.resize(numSubmeshes);
+	for (unsigned int i = 0; i < numSubmeshes; ++i)
+	{
+		const ModelData::Submesh& submesh = pSubmeshes[i];
+		m_meshFirstTriangles[i] = static_cast<unsigned int>(m_indices.size() / 3);
+		for (unsigned int index = 0; index < submesh.numIndices; ++index)
 		{
-			texCoords.x = pMesh->mTextureCoords[0][i].x;
-			texCoords.y = pMesh->mTextureCoords[0][i].y;
+			m_indices.push_back(submesh.firstVertex + pIndices[submesh.firstIndex + index]);
 		}
+	}
 
-		vertices.emplace_back(pos, norm, texCoords);
+	const unsigned int numTriangles = static_cast<unsigned int>(m_indices.size() / 3);
+	std::vector<AABB> triangleBounds(numTriangles);
+	for (unsigned int i = 0; i < numTriangles; ++i)
+	{
+		AABB& bounds = triangleBounds[i];
+		bounds.min = glm::min(glm::min(m_positions[m_indices[i * 3]], m_positions[m_indices[i * 3 + 1]]), m_positions[m_indices[i * 3 + 2]]);
+		bounds.max = glm::max(glm::max(m_positions[m_indices[i * 3]], m_positions[m_indices[i * 3 + 1]]), m_positions[m_indices[i * 3 + 2]]);
 	}
+	m_triangleBvh.Build(triangleBounds.data(), numTriangles);
+}
 
-	std::vector<unsigned int> indices(pMesh->mNumFaces * 3);
-	unsigned int* pIndex = indices.data();
-	for (unsigned int i = 0; i < pMesh->mNumFaces; ++i)
+void Model::UpdateMeshBvh()
+{
+	m_meshBounds.resize(m_meshes.size());
+	for (size_t i = 0; i < m_meshes.size(); ++i)
 	{
-		*(pIndex++) = pMesh->mFaces[i].mIndices[0];
-		*(pIndex++) = pMesh->mFaces[i].mIndices[1];
-		*(pIndex++) = pMesh->mFaces[i].mIndices[2];
+		m_meshBounds[i] = TransformAABB(m_meshes[i]->GetAABB(), m_transform);
 	}
 
-	Mesh* mesh = new Mesh(vertices, indices);
-	if (pMesh->mMaterialIndex >= 0)
+	// the meshes only ever move together, so the tree built at load stays a good fit and only needs its bounds updated
+	if (m_meshBvh.GetNumPrimitives() == m_meshBounds.size())
 	{
-		aiMaterial* aiMat = pScene->mMaterials[pMesh->mMaterialIndex];
-		Material& material = mesh->GetMaterial();
+		m_meshBvh.Refit(m_meshBounds.data());
+	}
+	else
+	{
+		m_meshBvh.Build(m_meshBounds.data(), static_cast<unsigned int>(m_meshBounds.size()));
+	}
+}
 
-		float shininess = 0.0f;
-		aiMat->Get(AI_MATKEY_SHININESS, shininess);
-		material.SetFloat("material.shininess", shininess);
+void Model::CreateOccluder()
+{
+	const float minRadius = m_boundingSphere.radius * MIN_OCCLUDER_RADIUS;
+	const float minTriangleSize = glm::length(m_aabb.max - m_aabb.min) * MIN_OCCLUDER_TRIANGLE_SIZE;
+	const float minTriangleArea = 0.5f * minTriangleSize * minTriangleSize;
 
-		if (aiMat->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+	for (size_t i = 0; i < m_meshes.size(); ++i)
+	{
+		const Mesh* pMesh = m_meshes[i];
+		const Material* pMaterial = pMesh->GetMaterial();
+		if (pMaterial->IsTranslucent() || pMaterial->IsAlphaTested() || pMesh->GetBoundingSphere().radius < minRadius)
 		{
-			aiString diffuseTexture;
-			aiMat->GetTexture(aiTextureType_DIFFUSE, 0, &diffuseTexture);
-			TextureParams params;
-			params.filterMode = FM_TRILINEAR;
-			Texture* pDiffuse = TextureManager::GetInstance()->CreateTexture(m_directory + diffuseTexture.C_Str(), params, true);
-			material.SetInteger("material.diffuse", 0);
-			material.SetTexture("material.diffuse", pDiffuse);
+			continue;
 		}
 
-		if (aiMat->GetTextureCount(aiTextureType_SPECULAR) > 0)
-		{
-			aiString specularTexture;
-			aiMat->GetTexture(aiTextureType_SPECULAR, 0, &specularTexture);
-			TextureParams params;
-			params.filterMode = FM_TRILINEAR;
-			params.forceComponents = 3;
-			Texture* pSpecular = TextureManager::GetInstance()->CreateTexture(m_directory + specularTexture.C_Str(), params, true);
-			material.SetInteger("material.specular", 1);
-			material.SetTexture("material.specular", pSpecular);
-		}
+		const unsigned int firstIndex = m_meshFirstTriangles[i] * 3;
+		const unsigned int endIndex = i + 1 < m_meshFirstTriangles.size() ? m_meshFirstTriangles[i + 1] * 3 : static_cast<unsigned int>(m_indices.size());
+		SimplifyOccluderMesh(m_positions.data(), m_indices.data() + firstIndex, endIndex - firstIndex, minTriangleArea, m_occluder);
 	}
-
-	return mesh;
 }
\ No newline at end of file
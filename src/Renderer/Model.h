@@ -7,11 +7,21 @@
 // TEMP
 #include <glm/glm.hpp>
 
+#include "Bvh.h"
+#include "GpuCuller.h"
 #include "Mesh.h"
+#include "ModelImporter.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
 
-struct aiMesh;
-struct aiNode;
-struct aiScene;
+struct ModelRaycastHit
+{
+	float distance = 0.0f;
+	glm::vec3 position = glm::vec3(0.0f);
+	Mesh* pMesh = nullptr;
+	// index of the triangle in the whole model
+	unsigned int triangle = 0;
+};
 
 class Model
 {
@@ -20,17 +30,65 @@ public:
 	~Model();
 
 	void LoadModel(const std::string& filename);
-	void Draw() const;
+	void Submit(RenderQueue& queue) const;
+	// adds the model's simplified occluder, built at load from its biggest opaque meshes
+	void SubmitOccluders(OcclusionCuller& culler) const;
+
+	// hardware occlusion queries on each mesh's bounds, worth it for models with many meshes that hide each other
+	void SetOcclusionQueries(bool bEnabled) { m_bOcclusionQueries = bEnabled; }
+	bool IsUsingOcclusionQueries() const { return m_bOcclusionQueries; }
+
+	// culls and draws every opaque mesh on the GPU through DrawGpuDriven, Submit then only queues the translucent
+	// ones. Only possible where GpuCuller is supported, and only after loading.
+	void SetGpuDriven(bool bEnabled);
+	bool IsGpuDriven() const { return m_bGpuDriven; }
+	void DrawGpuDriven(GpuCuller& culler, GpuCullPass pass);
+
+	// local space bounds of every mesh together
+	const AABB& GetAABB() const { return m_aabb; }
+	const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+
+	// world space queries. Triangles are kept in a BVH built once at load, in model space, while meshes are kept in
+	// one over their world space bounds which is refit whenever the transform changes.
+
+	// the distance is in multiples of direction, and hits on either side of a triangle count
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, ModelRaycastHit& outHit) const;
+	void QueryMeshes(const AABB& aabb, std::vector<Mesh*>& outMeshes) const;
+	void QueryMeshes(const Frustum& frustum, std::vector<Mesh*>& outMeshes) const;
 
 	// TEMP
 	void SetTransform(const glm::mat4& transform);
 
 private:
-	void ProcessAssimpNode(const aiNode* pNode, const aiScene* pScene);
-	Mesh* ProcessAssimpMesh(const aiMesh* pMesh, const aiScene* pScene);
+	void Clear();
+	void CreateMaterials(const std::string& filename, const std::vector<ModelData::MaterialDesc>& materials);
+	void CreateMeshes(const Mesh::Vertex* pVertices, const unsigned int* pIndices, const ModelData::Submesh* pSubmeshes, unsigned int numSubmeshes);
+	void ApplyMaterialDesc(Material& material, const ModelData::MaterialDesc& materialDesc);
+	void BuildTriangleBvh(const Mesh::Vertex* pVertices, const unsigned int* pIndices, const ModelData::Submesh* pSubmeshes, unsigned int numSubmeshes);
+	void UpdateMeshBvh();
+	void CreateOccluder();
 
 	std::vector<Mesh*> m_meshes;
+	// every mesh's vertices and indices, shared between them
+	MeshBuffer* m_pMeshBuffer;
+	// one per source material, shared by every mesh using it. The last one is for meshes without a material.
+	std::vector<Material*> m_materials;
 	std::string m_directory;
+	AABB m_aabb;
+	BoundingSphere m_boundingSphere;
+
+	// model space positions and model wide indices, kept for ray queries
+	std::vector<glm::vec3> m_positions;
+	std::vector<unsigned int> m_indices;
+	// first triangle of each mesh, to find the mesh a triangle belongs to
+	std::vector<unsigned int> m_meshFirstTriangles;
+	Bvh m_triangleBvh;
+	std::vector<AABB> m_meshBounds;
+	Bvh m_meshBvh;
+	OccluderMesh m_occluder;
+	bool m_bOcclusionQueries;
+	GpuDrawList m_gpuDrawList;
+	bool m_bGpuDriven;
 
 	// TEMP
 	glm::mat4 m_transform;
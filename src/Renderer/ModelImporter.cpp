@@ -0,0 +1,279 @@
+#include "ModelImporter.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "Core/FileSystem.h"
+#include "Core/JobSystem.h"
+
+namespace
+{
+	// read-only stream over a File's contents, so assimp never copies or reopens anything itself
+	class FileIOStream : public Assimp::IOStream
+	{
+	public:
+		FileIOStream()
+			: m_file()
+			, m_position(0)
+		{
+		}
+
+		File& GetFile() { return m_file; }
+
+		size_t Read(void* pBuffer, size_t size, size_t count) override
+		{
+			if (size == 0)
+			{
+				return 0;
+			}
+
+			const size_t numItems = std::min(count, (m_file.GetSize() - m_position) / size);
+			memcpy(pBuffer, m_file.GetData() + m_position, numItems * size);
+			m_position += numItems * size;
+			return numItems;
+		}
+
+		size_t Write(const void*, size_t, size_t) override
+		{
+			return 0;
+		}
+
+		aiReturn Seek(size_t offset, aiOrigin origin) override
+		{
+			// same semantics as fseek, so a "negative" offset wraps around to a position before the origin
+			size_t position = offset;
+			if (origin == aiOrigin_CUR)
+			{
+				position = m_position + offset;
+			}
+			else if (origin == aiOrigin_END)
+			{
+				position = m_file.GetSize() + offset;
+			}
+
+			if (position > m_file.GetSize())
+			{
+				return aiReturn_FAILURE;
+			}
+
+			m_position = position;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t Tell() const override
+		{
+			return m_position;
+		}
+
+		size_t FileSize() const override
+		{
+			return m_file.GetSize();
+		}
+
+		void Flush() override
+		{
+		}
+
+	private:
+		File m_file;
+		size_t m_position;
+	};
+
+	// routes assimp's file access (the model and anything it references, like .mtl files) through FileSystem
+	class FileSystemIOSystem : public Assimp::IOSystem
+	{
+	public:
+		bool Exists(const char* pFilename) const override
+		{
+			return FileSystem::GetInstance()->Exists(pFilename);
+		}
+
+		char getOsSeparator() const override
+		{
+			return '/';
+		}
+
+		Assimp::IOStream* Open(const char* pFilename, const char* pMode) override
+		{
+			// assets are read-only
+			if (strchr(pMode, 'w') || strchr(pMode, 'a') || strchr(pMode, '+'))
+			{
+				return nullptr;
+			}
+
+			FileIOStream* pStream = new FileIOStream();
+			if (!FileSystem::GetInstance()->Open(pFilename, pStream->GetFile()))
+			{
+				delete pStream;
+				return nullptr;
+			}
+			return pStream;
+		}
+
+		void Close(Assimp::IOStream* pStream) override
+		{
+			delete pStream;
+		}
+	};
+
+	void GatherNodeMeshes(const aiNode* pNode, std::vector<unsigned int>& meshIndices)
+	{
+		for (unsigned int i = 0; i < pNode->mNumMeshes; ++i)
+		{
+			meshIndices.push_back(pNode->mMeshes[i]);
+		}
+
+		for (unsigned int i = 0; i < pNode->mNumChildren; ++i)
+		{
+			GatherNodeMeshes(pNode->mChildren[i], meshIndices);
+		}
+	}
+
+	void ConvertMesh(const aiMesh* pMesh, ModelData::Submesh& submesh, Mesh::Vertex* pVertex, unsigned int* pIndex)
+	{
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		for (unsigned int i = 0; i < pMesh->mNumVertices; ++i)
+		{
+			glm::vec3 pos(0.0f);
+			pos.x = pMesh->mVertices[i].x;
+			pos.y = pMesh->mVertices[i].y;
+			pos.z = pMesh->mVertices[i].z;
+
+			glm::vec3 norm(0.0f, 0.0f, 1.0f);
+			norm.x = pMesh->mNormals[i].x;
+			norm.y = pMesh->mNormals[i].y;
+			norm.z = pMesh->mNormals[i].z;
+
+			glm::vec2 texCoords(0.0f);
+			if (pMesh->mTextureCoords[0])
+			{
+				texCoords.x = pMesh->mTextureCoords[0][i].x;
+				texCoords.y = pMesh->mTextureCoords[0][i].y;
+			}
+
+			*(pVertex++) = Mesh::Vertex(pos, norm, texCoords);
+			boundsMin = glm::min(boundsMin, pos);
+			boundsMax = glm::max(boundsMax, pos);
+		}
+
+		for (unsigned int i = 0; i < pMesh->mNumFaces; ++i)
+		{
+			*(pIndex++) = pMesh->mFaces[i].mIndices[0];
+			*(pIndex++) = pMesh->mFaces[i].mIndices[1];
+			*(pIndex++) = pMesh->mFaces[i].mIndices[2];
+		}
+
+		submesh.materialIndex = pMesh->mMaterialIndex;
+		submesh.boundsMin = boundsMin;
+		submesh.boundsMax = boundsMax;
+	}
+
+	void ConvertMaterial(const aiMaterial* pMaterial, ModelData::MaterialDesc& material)
+	{
+		pMaterial->Get(AI_MATKEY_SHININESS, material.shininess);
+
+		if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+		{
+			aiString diffuseTexture;
+			pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &diffuseTexture);
+			material.diffuseTexture = diffuseTexture.C_Str();
+		}
+
+		if (pMaterial->GetTextureCount(aiTextureType_SPECULAR) > 0)
+		{
+			aiString specularTexture;
+			pMaterial->GetTexture(aiTextureType_SPECULAR, 0, &specularTexture);
+			material.specularTexture = specularTexture.C_Str();
+		}
+
+		if (pMaterial->GetTextureCount(aiTextureType_OPACITY) > 0)
+		{
+			aiString opacityTexture;
+			pMaterial->GetTexture(aiTextureType_OPACITY, 0, &opacityTexture);
+			material.opacityTexture = opacityTexture.C_Str();
+		}
+	}
+}
+
+void GetMaterialTextureParams(MaterialTextureSlot slot, TextureParams& outParams, bool& outIsSRGB)
+{
+	outParams = TextureParams();
+	outParams.filterMode = FM_TRILINEAR;
+
+	switch (slot)
+	{
+	case MTS_DIFFUSE:
+		outParams.compression = TC_BC7;
+		outIsSRGB = true;
+		break;
+	case MTS_SPECULAR:
+		// specular maps are greyscale intensities, the GPU swizzles the single channel back out to RGB
+		outParams.compression = TC_BC4;
+		outParams.forceComponents = 1;
+		outIsSRGB = false;
+		break;
+	default:
+		outIsSRGB = false;
+		break;
+	}
+}
+
+bool ImportModelData(const std::string& filename, ModelData& outData)
+{
+	Assimp::Importer importer;
+	// the importer takes ownership of the IO handler
+	importer.SetIOHandler(new FileSystemIOSystem());
+	unsigned int postProcessFlags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes;
+	const aiScene* pScene = importer.ReadFile(filename, postProcessFlags);
+	if (!pScene || !pScene->mRootNode || pScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)
+	{
+		printf("Error loading model \"%s\": %s\n", filename.c_str(), importer.GetErrorString());
+		return false;
+	}
+
+	// flatten the node hierarchy into a list of meshes so the shared vertex/index arrays can be sized up front
+	std::vector<unsigned int> meshIndices;
+	meshIndices.reserve(pScene->mNumMeshes);
+	GatherNodeMeshes(pScene->mRootNode, meshIndices);
+
+	outData.submeshes.resize(meshIndices.size());
+	unsigned int numVertices = 0;
+	unsigned int numIndices = 0;
+	for (size_t i = 0; i < meshIndices.size(); ++i)
+	{
+		const aiMesh* pMesh = pScene->mMeshes[meshIndices[i]];
+		ModelData::Submesh& submesh = outData.submeshes[i];
+		submesh.firstVertex = numVertices;
+		submesh.numVertices = pMesh->mNumVertices;
+		submesh.firstIndex = numIndices;
+		submesh.numIndices = pMesh->mNumFaces * 3;
+		numVertices += submesh.numVertices;
+		numIndices += submesh.numIndices;
+	}
+
+	// every mesh writes to its own range of the shared arrays, so they can all be converted in parallel
+	outData.vertices.resize(numVertices, Mesh::Vertex(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f)));
+	outData.indices.resize(numIndices);
+	JobSystem::GetInstance()->ParallelFor(static_cast<unsigned int>(meshIndices.size()), [&](unsigned int i)
+	{
+		ModelData::Submesh& submesh = outData.submeshes[i];
+		ConvertMesh(pScene->mMeshes[meshIndices[i]], submesh, outData.vertices.data() + submesh.firstVertex, outData.indices.data() + submesh.firstIndex);
+	});
+
+	outData.materials.resize(pScene->mNumMaterials);
+	for (unsigned int i = 0; i < pScene->mNumMaterials; ++i)
+	{
+		ConvertMaterial(pScene->mMaterials[i], outData.materials[i]);
+	}
+
+	return true;
+}
\ No newline at end of file
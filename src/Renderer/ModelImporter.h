@@ -0,0 +1,54 @@
+#ifndef MODEL_IMPORTER_H
+#define MODEL_IMPORTER_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+// CPU-side result of importing a model through Assimp. Vertex and index data for every submesh is packed into
+// shared arrays, and submesh indices are relative to the submesh's first vertex.
+struct ModelData
+{
+	struct Submesh
+	{
+		unsigned int firstVertex;
+		unsigned int numVertices;
+		unsigned int firstIndex;
+		unsigned int numIndices;
+		unsigned int materialIndex;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	struct MaterialDesc
+	{
+		float shininess = 0.0f;
+		// texture paths are relative to the model's directory, empty if the material has no such texture
+		std::string diffuseTexture;
+		std::string specularTexture;
+		// the mask the diffuse map's alpha was cut from, only used to tell that the material has holes
+		std::string opacityTexture;
+	};
+
+	std::vector<Mesh::Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Submesh> submeshes;
+	std::vector<MaterialDesc> materials;
+};
+
+enum MaterialTextureSlot
+{
+	MTS_DIFFUSE,
+	MTS_SPECULAR,
+};
+
+// settings the textures in each material slot are loaded with. orca-bake uses the same settings so that its baked
+// textures match what Model asks for at runtime.
+void GetMaterialTextureParams(MaterialTextureSlot slot, TextureParams& outParams, bool& outIsSRGB);
+
+bool ImportModelData(const std::string& filename, ModelData& outData);
+
+#endif
\ No newline at end of file
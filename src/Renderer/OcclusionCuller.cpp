@@ -0,0 +1,440 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+namespace
+{
+	const unsigned int NUM_TILES_X = (OCCLUSION_BUFFER_WIDTH + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	const unsigned int NUM_TILES_Y = (OCCLUSION_BUFFER_HEIGHT + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+
+	// clip space outcodes, a triangle with all three vertices outside the same plane can't be on screen
+	const unsigned int OUTSIDE_LEFT = 1 << 0;
+	const unsigned int OUTSIDE_RIGHT = 1 << 1;
+	const unsigned int OUTSIDE_BOTTOM = 1 << 2;
+	const unsigned int OUTSIDE_TOP = 1 << 3;
+	const unsigned int OUTSIDE_NEAR = 1 << 4;
+	const unsigned int OUTSIDE_FAR = 1 << 5;
+
+	unsigned int GetOutcode(const glm::vec4& clip)
+	{
+		unsigned int outcode = 0;
+		outcode |= clip.x < -clip.w ? OUTSIDE_LEFT : 0;
+		outcode |= clip.x > clip.w ? OUTSIDE_RIGHT : 0;
+		outcode |= clip.y < -clip.w ? OUTSIDE_BOTTOM : 0;
+		outcode |= clip.y > clip.w ? OUTSIDE_TOP : 0;
+		outcode |= clip.z < -clip.w ? OUTSIDE_NEAR : 0;
+		outcode |= clip.z > clip.w ? OUTSIDE_FAR : 0;
+		return outcode;
+	}
+
+	glm::vec3 ClipToScreen(const glm::vec4& clip)
+	{
+		const float invW = 1.0f / clip.w;
+		return glm::vec3((clip.x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH, (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	float GetScreenArea(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+	{
+		return (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			// adding zero folds -0 into 0, which compare equal and so have to hash the same
+			const glm::vec3 folded = position + glm::vec3(0.0f);
+			uint32_t bits[3];
+			std::memcpy(bits, &folded, sizeof(bits));
+			return static_cast<size_t>(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+		}
+	};
+}
+
+void SimplifyOccluderMesh(const glm::vec3* pPositions, const unsigned int* pIndices, unsigned int numIndices, float minArea, OccluderMesh& outMesh)
+{
+	// triangles are kept exactly as they are so the occluder never reaches past the real surface, only the vertices
+	// the kept ones use are copied
+	const unsigned int firstTriangle = static_cast<unsigned int>(outMesh.indices.size() / 3);
+	std::unordered_map<glm::vec3, unsigned int, PositionHash> remap;
+	for (unsigned int i = 0; i + 2 < numIndices; i += 3)
+	{
+		const glm::vec3& p0 = pPositions[pIndices[i]];
+		const glm::vec3& p1 = pPositions[pIndices[i + 1]];
+		const glm::vec3& p2 = pPositions[pIndices[i + 2]];
+		if (0.5f * glm::length(glm::cross(p1 - p0, p2 - p0)) < minArea)
+		{
+			continue;
+		}
+
+		for (unsigned int v = 0; v < 3; ++v)
+		{
+			const glm::vec3& position = pPositions[pIndices[i + v]];
+			auto result = remap.emplace(position, static_cast<unsigned int>(outMesh.positions.size()));
+			if (result.second)
+			{
+				outMesh.positions.push_back(position);
+			}
+			outMesh.indices.push_back(result.first->second);
+		}
+	}
+
+	// an edge is only inner if exactly two triangles share it with consistent winding, anything else stays open
+	const unsigned int numTriangles = static_cast<unsigned int>(outMesh.indices.size() / 3);
+	outMesh.neighbours.resize(numTriangles * 3, OCCLUDER_OPEN_EDGE);
+	std::unordered_map<uint64_t, unsigned int> edges;
+	for (unsigned int triangle = firstTriangle; triangle < numTriangles; ++triangle)
+	{
+		for (unsigned int edge = 0; edge < 3; ++edge)
+		{
+			const uint64_t start = outMesh.indices[triangle * 3 + edge];
+			const uint64_t end = outMesh.indices[triangle * 3 + (edge + 1) % 3];
+			auto result = edges.emplace(start | (end << 32), triangle * 3 + edge);
+			if (!result.second)
+			{
+				// the same edge the same way round is either flipped winding or non manifold
+				result.first->second = OCCLUDER_OPEN_EDGE;
+			}
+		}
+	}
+	for (const auto& edge : edges)
+	{
+		auto reverse = edges.find((edge.first >> 32) | (edge.first << 32));
+		if (edge.second != OCCLUDER_OPEN_EDGE && reverse != edges.end() && reverse->second != OCCLUDER_OPEN_EDGE)
+		{
+			outMesh.neighbours[edge.second] = reverse->second / 3;
+		}
+	}
+}
+
+OcclusionCuller::OcclusionCuller()
+	: m_viewProjection(1.0f)
+	, m_depthBuffer(OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT, 1.0f)
+	, m_triangles()
+	, m_tileBins(NUM_TILES_X * NUM_TILES_Y)
+	, m_clipPositions()
+	, m_facings()
+	, m_numTested(0)
+	, m_numOccluded(0)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), 1.0f);
+	m_triangles.clear();
+	for (std::vector<uint32_t>& bin : m_tileBins)
+	{
+		bin.clear();
+	}
+	m_numTested = 0;
+	m_numOccluded = 0;
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const glm::mat4& transform)
+{
+	const glm::mat4 modelViewProjection = m_viewProjection * transform;
+	m_clipPositions.resize(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); ++i)
+	{
+		m_clipPositions[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+	}
+
+	// an edge can only be left where it is if the triangle across it is drawn and continues on the other side of it
+	// on screen, otherwise pixels straddling it are only partly covered
+	const size_t numTriangles = mesh.indices.size() / 3;
+	m_facings.resize(numTriangles);
+	for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		const glm::vec4& clip0 = m_clipPositions[mesh.indices[triangle * 3]];
+		const glm::vec4& clip1 = m_clipPositions[mesh.indices[triangle * 3 + 1]];
+		const glm::vec4& clip2 = m_clipPositions[mesh.indices[triangle * 3 + 2]];
+		const unsigned int outcode0 = GetOutcode(clip0);
+		const unsigned int outcode1 = GetOutcode(clip1);
+		const unsigned int outcode2 = GetOutcode(clip2);
+		m_facings[triangle] = 0;
+		if (!(outcode0 & outcode1 & outcode2) && !((outcode0 | outcode1 | outcode2) & OUTSIDE_NEAR))
+		{
+			const float area = GetScreenArea(ClipToScreen(clip0), ClipToScreen(clip1), ClipToScreen(clip2));
+			m_facings[triangle] = area >= 1e-6f ? 1 : (area <= -1e-6f ? -1 : 0);
+		}
+	}
+
+	for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		const size_t i = triangle * 3;
+		const glm::vec4& clip0 = m_clipPositions[mesh.indices[i]];
+		const glm::vec4& clip1 = m_clipPositions[mesh.indices[i + 1]];
+		const glm::vec4& clip2 = m_clipPositions[mesh.indices[i + 2]];
+		const unsigned int outcode0 = GetOutcode(clip0);
+		const unsigned int outcode1 = GetOutcode(clip1);
+		const unsigned int outcode2 = GetOutcode(clip2);
+		if (outcode0 & outcode1 & outcode2)
+		{
+			continue;
+		}
+
+		unsigned int innerEdges = 0;
+		for (unsigned int edge = 0; edge < 3; ++edge)
+		{
+			const unsigned int neighbour = mesh.neighbours[i + edge];
+			if (m_facings[triangle] != 0 && neighbour != OCCLUDER_OPEN_EDGE && m_facings[neighbour] == m_facings[triangle])
+			{
+				innerEdges |= 1 << edge;
+			}
+		}
+
+		if (!((outcode0 | outcode1 | outcode2) & OUTSIDE_NEAR))
+		{
+			SetupTriangle(clip0, clip1, clip2, innerEdges);
+			continue;
+		}
+
+		// only the near plane needs real clipping, w is positive past it and the other planes are handled by
+		// clamping to the buffer. Each polygon edge remembers whether it's inner, the new one along the near plane
+		// never is
+		const glm::vec4* pInput[3] = { &clip0, &clip1, &clip2 };
+		glm::vec4 polygon[4];
+		bool polygonInner[4];
+		unsigned int numVertices = 0;
+		for (unsigned int v = 0; v < 3; ++v)
+		{
+			const glm::vec4& current = *pInput[v];
+			const glm::vec4& next = *pInput[(v + 1) % 3];
+			const float currentDistance = current.z + current.w;
+			const float nextDistance = next.z + next.w;
+			const bool bInner = (innerEdges & (1 << v)) != 0;
+			if (currentDistance >= 0.0f)
+			{
+				polygonInner[numVertices] = bInner;
+				polygon[numVertices++] = current;
+			}
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				polygonInner[numVertices] = currentDistance < 0.0f && bInner;
+				polygon[numVertices++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+			}
+		}
+		// the fan's own diagonals are always covered from both sides
+		for (unsigned int v = 2; v < numVertices; ++v)
+		{
+			const bool bFirstInner = v - 1 > 1 || polygonInner[0];
+			const bool bLastInner = v + 1 < numVertices || polygonInner[v];
+			SetupTriangle(polygon[0], polygon[v - 1], polygon[v], (bFirstInner ? 1 : 0) | (polygonInner[v - 1] ? 2 : 0) | (bLastInner ? 4 : 0));
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	JobSystem::GetInstance()->ParallelFor(NUM_TILES_X * NUM_TILES_Y, [this](unsigned int tile)
+	{
+		RasterizeTile(tile);
+	});
+}
+
+bool OcclusionCuller::IsVisible(const AABB& aabb)
+{
+	++m_numTested;
+
+	glm::vec2 screenMin(FLT_MAX);
+	glm::vec2 screenMax(-FLT_MAX);
+	float minDepth = FLT_MAX;
+	for (unsigned int corner = 0; corner < 8; ++corner)
+	{
+		const glm::vec3 position((corner & 1) ? aabb.max.x : aabb.min.x, (corner & 2) ? aabb.max.y : aabb.min.y, (corner & 4) ? aabb.max.z : aabb.min.z);
+		const glm::vec4 clip = m_viewProjection * glm::vec4(position, 1.0f);
+		// boxes reaching past the near plane are around the camera, nothing can be in front of them
+		if (clip.z < -clip.w)
+		{
+			return true;
+		}
+
+		const glm::vec3 screen = ClipToScreen(clip);
+		screenMin = glm::min(screenMin, glm::vec2(screen));
+		screenMax = glm::max(screenMax, glm::vec2(screen));
+		minDepth = std::min(minDepth, screen.z);
+	}
+
+	// every pixel the rectangle touches, not just those whose centres it covers
+	const int minX = std::max(static_cast<int>(std::floor(screenMin.x)), 0);
+	const int minY = std::max(static_cast<int>(std::floor(screenMin.y)), 0);
+	const int maxX = std::min(static_cast<int>(std::ceil(screenMax.x)), static_cast<int>(OCCLUSION_BUFFER_WIDTH)) - 1;
+	const int maxY = std::min(static_cast<int>(std::ceil(screenMax.y)), static_cast<int>(OCCLUSION_BUFFER_HEIGHT)) - 1;
+	if (minX > maxX || minY > maxY)
+	{
+		// off screen, which is for the frustum test to decide
+		return true;
+	}
+
+	for (int y = minY; y <= maxY; ++y)
+	{
+		const float* pRow = m_depthBuffer.data() + y * OCCLUSION_BUFFER_WIDTH;
+		int x = minX;
+#ifdef ORCA_SSE2
+		const __m128 depth = _mm_set1_ps(minDepth);
+		for (; x + 3 <= maxX; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + x), depth)))
+			{
+				return true;
+			}
+		}
+#endif
+		for (; x <= maxX; ++x)
+		{
+			if (pRow[x] >= minDepth)
+			{
+				return true;
+			}
+		}
+	}
+
+	++m_numOccluded;
+	return false;
+}
+
+void OcclusionCuller::SetupTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2, unsigned int innerEdges)
+{
+	glm::vec3 v0 = ClipToScreen(clip0);
+	glm::vec3 v1 = ClipToScreen(clip1);
+	glm::vec3 v2 = ClipToScreen(clip2);
+
+	// occluders count from both sides, so back facing triangles are just flipped round
+	float area = GetScreenArea(v0, v1, v2);
+	if (std::fabs(area) < 1e-6f)
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		// the first and last edges swap over as well as running the other way
+		std::swap(v1, v2);
+		area = -area;
+		innerEdges = (innerEdges & 2) | ((innerEdges & 1) << 2) | ((innerEdges & 4) >> 2);
+	}
+
+	// pixels whose centres are within the triangle's bounds
+	RasterTriangle triangle;
+	triangle.minX = std::max(static_cast<int>(std::ceil(std::min(std::min(v0.x, v1.x), v2.x) - 0.5f)), 0);
+	triangle.minY = std::max(static_cast<int>(std::ceil(std::min(std::min(v0.y, v1.y), v2.y) - 0.5f)), 0);
+	triangle.maxX = std::min(static_cast<int>(std::floor(std::max(std::max(v0.x, v1.x), v2.x) - 0.5f)), static_cast<int>(OCCLUSION_BUFFER_WIDTH) - 1);
+	triangle.maxY = std::min(static_cast<int>(std::floor(std::max(std::max(v0.y, v1.y), v2.y) - 0.5f)), static_cast<int>(OCCLUSION_BUFFER_HEIGHT) - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	// each edge is positive on the inside of the counter clockwise triangle. Occludees count a pixel as fully covered,
+	// so outer edges are pulled in by half a pixel's extent along their normal and only pixels whose whole square is
+	// inside pass at their centre
+	const glm::vec3* pVertices[3] = { &v0, &v1, &v2 };
+	for (unsigned int edge = 0; edge < 3; ++edge)
+	{
+		const glm::vec3& start = *pVertices[edge];
+		const glm::vec3& end = *pVertices[(edge + 1) % 3];
+		triangle.edgeA[edge] = start.y - end.y;
+		triangle.edgeB[edge] = end.x - start.x;
+		triangle.edgeC[edge] = start.x * end.y - start.y * end.x;
+		if (!(innerEdges & (1 << edge)))
+		{
+			triangle.edgeC[edge] -= 0.5f * (std::fabs(triangle.edgeA[edge]) + std::fabs(triangle.edgeB[edge]));
+		}
+	}
+
+	// screen space depth is linear, so it's a plane through the three vertices
+	const float invArea = 1.0f / area;
+	const float depth1 = v1.z - v0.z;
+	const float depth2 = v2.z - v0.z;
+	triangle.depthA = (depth1 * (v2.y - v0.y) - depth2 * (v1.y - v0.y)) * invArea;
+	triangle.depthB = (depth2 * (v1.x - v0.x) - depth1 * (v2.x - v0.x)) * invArea;
+	// offset to the farthest depth anywhere in the pixel rather than the one at its centre
+	triangle.depthC = v0.z - triangle.depthA * v0.x - triangle.depthB * v0.y + 0.5f * (std::fabs(triangle.depthA) + std::fabs(triangle.depthB));
+
+	const uint32_t triangleIndex = static_cast<uint32_t>(m_triangles.size());
+	m_triangles.push_back(triangle);
+	for (unsigned int tileY = triangle.minY / OCCLUSION_TILE_HEIGHT; tileY <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ++tileY)
+	{
+		for (unsigned int tileX = triangle.minX / OCCLUSION_TILE_WIDTH; tileX <= triangle.maxX / OCCLUSION_TILE_WIDTH; ++tileX)
+		{
+			m_tileBins[tileY * NUM_TILES_X + tileX].push_back(triangleIndex);
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	const int tileMinX = static_cast<int>((tile % NUM_TILES_X) * OCCLUSION_TILE_WIDTH);
+	const int tileMinY = static_cast<int>((tile / NUM_TILES_X) * OCCLUSION_TILE_HEIGHT);
+	const int tileMaxX = std::min(tileMinX + static_cast<int>(OCCLUSION_TILE_WIDTH), static_cast<int>(OCCLUSION_BUFFER_WIDTH)) - 1;
+	const int tileMaxY = std::min(tileMinY + static_cast<int>(OCCLUSION_TILE_HEIGHT), static_cast<int>(OCCLUSION_BUFFER_HEIGHT)) - 1;
+
+	for (uint32_t triangleIndex : m_tileBins[tile])
+	{
+		const RasterTriangle& triangle = m_triangles[triangleIndex];
+		// rows start on a multiple of 4, any extra pixels fail the edge tests
+		const int minX = std::max(triangle.minX, tileMinX) & ~3;
+		const int maxX = std::min(triangle.maxX, tileMaxX);
+		const int minY = std::max(triangle.minY, tileMinY);
+		const int maxY = std::min(triangle.maxY, tileMaxY);
+
+		for (int y = minY; y <= maxY; ++y)
+		{
+			const float centerY = y + 0.5f;
+			float* pRow = m_depthBuffer.data() + y * OCCLUSION_BUFFER_WIDTH;
+#ifdef ORCA_SSE2
+			const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+			const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+			const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+			const __m128 depthA = _mm_set1_ps(triangle.depthA);
+			const __m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+			const __m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+			const __m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+			const __m128 rowDepth = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+				const __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, centerX), rowEdge0);
+				const __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, centerX), rowEdge1);
+				const __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, centerX), rowEdge2);
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, _mm_setzero_ps()), _mm_cmpge_ps(edge1, _mm_setzero_ps())), _mm_cmpge_ps(edge2, _mm_setzero_ps()));
+				if (!_mm_movemask_ps(inside))
+				{
+					continue;
+				}
+
+				const __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+				const __m128 current = _mm_loadu_ps(pRow + x);
+				const __m128 nearest = _mm_min_ps(current, depth);
+				_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+#else
+			for (int x = minX; x <= maxX; ++x)
+			{
+				const float centerX = x + 0.5f;
+				bool bInside = true;
+				for (unsigned int edge = 0; edge < 3; ++edge)
+				{
+					bInside &= triangle.edgeA[edge] * centerX + triangle.edgeB[edge] * centerY + triangle.edgeC[edge] >= 0.0f;
+				}
+				if (bInside)
+				{
+					pRow[x] = std::min(pRow[x], triangle.depthA * centerX + triangle.depthB * centerY + triangle.depthC);
+				}
+			}
+#endif
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+const unsigned int OCCLUSION_BUFFER_WIDTH = 256;
+const unsigned int OCCLUSION_BUFFER_HEIGHT = 128;
+// each tile is rasterized by one job, widths have to be multiples of 4 for the SSE rows
+const unsigned int OCCLUSION_TILE_WIDTH = 64;
+const unsigned int OCCLUSION_TILE_HEIGHT = 32;
+// no other triangle of the occluder shares this edge
+const unsigned int OCCLUDER_OPEN_EDGE = ~0u;
+
+// reduced copy of a model's biggest opaque meshes, used only to fill the occlusion buffer
+struct OccluderMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+	// the triangle across each edge, from vertex 0 to 1, 1 to 2 and 2 to 0, or OCCLUDER_OPEN_EDGE
+	std::vector<unsigned int> neighbours;
+};
+
+// keeps the original triangles with at least minArea and drops the smaller detail, never moving a vertex so the
+// occluder stays within the real surface. Vertices at the same position are shared so seams don't open edges.
+// Appends to outMesh, so several meshes can go into one occluder.
+void SimplifyOccluderMesh(const glm::vec3* pPositions, const unsigned int* pIndices, unsigned int numIndices, float minArea, OccluderMesh& outMesh);
+
+// Software depth buffer for culling whatever is hidden behind big occluders. Occluder triangles are transformed,
+// clipped to the near plane and binned into screen tiles, then the tiles are rasterized in parallel across the job
+// system, four pixels at a time. Only pixels entirely inside the occluder's surface are written, at the farthest
+// depth the triangle has within them, so the buffer never claims more than the occluders really cover. Edges are
+// pulled in by half a pixel unless the triangle across them continues the surface on screen. Occludees are tested by
+// their box's screen rectangle and nearest depth, and are hidden only if every pixel under the rectangle already
+// holds something nearer.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	// clears the buffer and drops last frame's occluders
+	void Begin(const glm::mat4& viewProjection);
+	void AddOccluder(const OccluderMesh& mesh, const glm::mat4& transform);
+	// fills the depth buffer from every occluder added since Begin
+	void Rasterize();
+
+	// world space box against the depth buffer, conservative so it only returns false for boxes that are definitely hidden
+	bool IsVisible(const AABB& aabb);
+
+	unsigned int GetNumOccluderTriangles() const { return static_cast<unsigned int>(m_triangles.size()); }
+	// since Begin
+	unsigned int GetNumTested() const { return m_numTested; }
+	unsigned int GetNumOccluded() const { return m_numOccluded; }
+
+	// row major from the bottom, depth in [0, 1] with 1 at the far plane
+	const float* GetDepthBuffer() const { return m_depthBuffer.data(); }
+
+private:
+	// edge functions and depth plane in pixel space, evaluated at pixel centres and already offset so they give the
+	// worst case over the whole pixel
+	struct RasterTriangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	// innerEdges has a bit for each edge that another drawn triangle continues past, which is left where it is
+	void SetupTriangle(const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2, unsigned int innerEdges);
+	void RasterizeTile(unsigned int tile);
+
+	glm::mat4 m_viewProjection;
+	std::vector<float> m_depthBuffer;
+	std::vector<RasterTriangle> m_triangles;
+	// triangles overlapping each tile, by index into m_triangles
+	std::vector<std::vector<uint32_t>> m_tileBins;
+	std::vector<glm::vec4> m_clipPositions;
+	// per occluder triangle, 1 or -1 for its winding on screen or 0 if it isn't drawn whole
+	std::vector<int8_t> m_facings;
+
+	unsigned int m_numTested;
+	unsigned int m_numOccluded;
+};
+
+#endif
\ No newline at end of file
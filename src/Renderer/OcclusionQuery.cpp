@@ -0,0 +1,183 @@
+#include "OcclusionQuery.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Core/Hash.h"
+#include "GLStateCache.h"
+#include "ShaderManager.h"
+
+namespace
+{
+	const char* const BOX_VERTEX_SHADER = "assets/shaders/solid_color.vert";
+	const char* const BOX_FRAGMENT_SHADER = "assets/shaders/solid_color.frag";
+
+	const glm::vec3 BOX_VERTICES[] = {
+		{ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 1.0f },
+	};
+
+	// face culling is left as it is, so the winding is consistent
+	const unsigned int BOX_INDICES[] = {
+		0, 2, 1, 0, 3, 2, // back
+		4, 5, 6, 4, 6, 7, // front
+		0, 4, 7, 0, 7, 3, // left
+		1, 2, 6, 1, 6, 5, // right
+		0, 1, 5, 0, 5, 4, // bottom
+		3, 7, 6, 3, 6, 2, // top
+	};
+}
+
+OcclusionQuery::OcclusionQuery()
+	: m_id(0)
+	, m_bPending(false)
+	, m_bOccluded(false)
+	, m_lastFrame(0)
+{
+}
+
+OcclusionQuery::~OcclusionQuery()
+{
+	if (m_id)
+	{
+		glDeleteQueries(1, &m_id);
+	}
+}
+
+void OcclusionQuery::Update()
+{
+	if (!m_bPending)
+	{
+		return;
+	}
+
+	GLuint bAvailable = GL_FALSE;
+	glGetQueryObjectuiv(m_id, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+	if (bAvailable)
+	{
+		GLuint bAnySamplesPassed = GL_TRUE;
+		glGetQueryObjectuiv(m_id, GL_QUERY_RESULT, &bAnySamplesPassed);
+		m_bOccluded = !bAnySamplesPassed;
+		m_bPending = false;
+	}
+}
+
+void OcclusionQuery::Reset()
+{
+	// beginning the query again discards whatever's in flight, so there's nothing to clean up on the GPU side
+	m_bPending = false;
+	m_bOccluded = false;
+}
+
+void OcclusionQuery::Begin()
+{
+	if (!m_id)
+	{
+		glGenQueries(1, &m_id);
+	}
+
+	glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, m_id);
+	m_bPending = true;
+}
+
+void OcclusionQuery::End()
+{
+	glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+}
+
+OcclusionQueryBatch::OcclusionQueryBatch()
+	: m_entries()
+	, m_pShader(nullptr)
+	, m_modelHandle(INVALID_UNIFORM_HANDLE)
+	, m_viewHandle(INVALID_UNIFORM_HANDLE)
+	, m_projectionHandle(INVALID_UNIFORM_HANDLE)
+	, m_vao(0)
+	, m_vbo(0)
+	, m_ebo(0)
+{
+}
+
+OcclusionQueryBatch::~OcclusionQueryBatch()
+{
+	if (!m_pShader)
+	{
+		return;
+	}
+
+	ShaderManager::GetInstance()->DeleteShader(m_pShader);
+
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	pStateCache->OnVertexArrayDeleted(m_vao);
+	pStateCache->OnBufferDeleted(m_vbo);
+	pStateCache->OnBufferDeleted(m_ebo);
+	glDeleteVertexArrays(1, &m_vao);
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteBuffers(1, &m_ebo);
+}
+
+void OcclusionQueryBatch::Clear()
+{
+	m_entries.clear();
+}
+
+void OcclusionQueryBatch::Add(OcclusionQuery* pQuery, const AABB& worldBounds)
+{
+	m_entries.push_back(Entry{ pQuery, worldBounds });
+}
+
+void OcclusionQueryBatch::Issue(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (m_entries.empty())
+	{
+		return;
+	}
+
+	if (!m_pShader)
+	{
+		CreateResources();
+	}
+
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	pStateCache->SetColorMask(false);
+	pStateCache->SetDepthMask(false);
+	// box faces lying on the mesh's own surface still count
+	pStateCache->SetDepthFunc(GL_LEQUAL);
+	pStateCache->BindVertexArray(m_vao);
+
+	m_pShader->Bind();
+	m_pShader->SetUniform(m_viewHandle, view);
+	m_pShader->SetUniform(m_projectionHandle, projection);
+	for (const Entry& entry : m_entries)
+	{
+		const glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), entry.bounds.min), entry.bounds.max - entry.bounds.min);
+		m_pShader->SetUniform(m_modelHandle, model);
+
+		entry.pQuery->Begin();
+		glDrawElements(GL_TRIANGLES, sizeof(BOX_INDICES) / sizeof(BOX_INDICES[0]), GL_UNSIGNED_INT, 0);
+		entry.pQuery->End();
+	}
+
+	pStateCache->SetDepthFunc(GL_LESS);
+	pStateCache->SetDepthMask(true);
+	pStateCache->SetColorMask(true);
+}
+
+void OcclusionQueryBatch::CreateResources()
+{
+	m_pShader = ShaderManager::GetInstance()->CreateShader(BOX_VERTEX_SHADER, BOX_FRAGMENT_SHADER);
+	m_modelHandle = m_pShader->GetUniformHandle(HashLiteral("model"));
+	m_viewHandle = m_pShader->GetUniformHandle(HashLiteral("view"));
+	m_projectionHandle = m_pShader->GetUniformHandle(HashLiteral("projection"));
+
+	glCreateBuffers(1, &m_vbo);
+	glNamedBufferStorage(m_vbo, sizeof(BOX_VERTICES), BOX_VERTICES, 0);
+	glCreateBuffers(1, &m_ebo);
+	glNamedBufferStorage(m_ebo, sizeof(BOX_INDICES), BOX_INDICES, 0);
+
+	glCreateVertexArrays(1, &m_vao);
+	glVertexArrayVertexBuffer(m_vao, 0, m_vbo, 0, sizeof(glm::vec3));
+	glVertexArrayElementBuffer(m_vao, m_ebo);
+	glEnableVertexArrayAttrib(m_vao, 0);
+	glVertexArrayAttribFormat(m_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(m_vao, 0, 0);
+}
\ No newline at end of file
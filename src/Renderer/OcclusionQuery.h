@@ -0,0 +1,80 @@
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Shader.h"
+
+// GL_ANY_SAMPLES_PASSED_CONSERVATIVE query on one draw's bounding box. The result is only read once the GPU has it, so
+// nothing ever waits: a draw goes by the last result that came back, and while a query is still in flight the draw is
+// wrapped in conditional rendering on it instead.
+class OcclusionQuery
+{
+public:
+	OcclusionQuery();
+	~OcclusionQuery();
+
+	// picks up the result of the query in flight if it's arrived
+	void Update();
+	// forgets the last result and any query in flight, so the draw counts as visible until a new one comes back
+	void Reset();
+
+	void Begin();
+	void End();
+
+	unsigned int GetId() const { return m_id; }
+	bool IsPending() const { return m_bPending; }
+	// no samples of the box passed in the last result that came back
+	bool IsOccluded() const { return m_bOccluded; }
+
+	// frame the owner last used the query in. A result older than the previous frame says nothing about now.
+	unsigned int GetLastFrame() const { return m_lastFrame; }
+	void SetLastFrame(unsigned int frame) { m_lastFrame = frame; }
+
+private:
+	// created on the first Begin
+	unsigned int m_id;
+	bool m_bPending;
+	bool m_bOccluded;
+	unsigned int m_lastFrame;
+};
+
+// Draws the boxes for a frame's queries in one go after the opaque draws, with colour and depth writes off so they
+// only test against the depth buffer.
+class OcclusionQueryBatch
+{
+public:
+	OcclusionQueryBatch();
+	~OcclusionQueryBatch();
+
+	void Clear();
+	void Add(OcclusionQuery* pQuery, const AABB& worldBounds);
+	void Issue(const glm::mat4& view, const glm::mat4& projection);
+
+	unsigned int GetNumQueries() const { return static_cast<unsigned int>(m_entries.size()); }
+
+private:
+	struct Entry
+	{
+		OcclusionQuery* pQuery;
+		AABB bounds;
+	};
+
+	void CreateResources();
+
+	std::vector<Entry> m_entries;
+
+	// unit cube, scaled and moved onto each box
+	Shader* m_pShader;
+	uniformHandle_t m_modelHandle;
+	uniformHandle_t m_viewHandle;
+	uniformHandle_t m_projectionHandle;
+	unsigned int m_vao;
+	unsigned int m_vbo;
+	unsigned int m_ebo;
+};
+
+#endif
\ No newline at end of file
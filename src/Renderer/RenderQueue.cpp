@@ -0,0 +1,313 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <glad/glad.h>
+
+#include "Camera.h"
+#include "GLStateCache.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "OcclusionCuller.h"
+
+namespace
+{
+	const unsigned int PASS_SHIFT = 62;
+	const unsigned int TRANSLUCENT_SHIFT = 61;
+	const unsigned int SHADER_BITS = 16;
+	const unsigned int MATERIAL_BITS = 21;
+	const unsigned int DEPTH_BITS = 24;
+
+	// the draws buffer in assets/shaders/include/draw_data.glsl
+	const unsigned int DRAWS_BINDING = 0;
+
+	// per frame, the ring buffers grow past it if needed
+	const unsigned int INITIAL_DRAW_CAPACITY = 1024;
+
+	const uint64_t SHADER_MASK = (1ull << SHADER_BITS) - 1;
+	const uint64_t MATERIAL_MASK = (1ull << MATERIAL_BITS) - 1;
+	const uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+
+	// the bits of a non-negative float sort the same way as its value, so the top 24 of them make a depth bucket that
+	// keeps more precision close to the camera without needing the near and far planes
+	uint64_t GetDepthBits(float depth)
+	{
+		depth = depth > 0.0f ? depth : 0.0f;
+		uint32_t bits = 0;
+		memcpy(&bits, &depth, sizeof(bits));
+		return (bits >> (31 - DEPTH_BITS)) & DEPTH_MASK;
+	}
+
+	uint64_t MakeSortKey(RenderPass pass, bool bTranslucent, unsigned int shaderId, unsigned int materialId, float depth)
+	{
+		const uint64_t shader = shaderId & SHADER_MASK;
+		const uint64_t material = materialId & MATERIAL_MASK;
+		const uint64_t depthBits = GetDepthBits(depth);
+
+		uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+		if (bTranslucent)
+		{
+			key |= 1ull << TRANSLUCENT_SHIFT;
+			key |= (~depthBits & DEPTH_MASK) << (SHADER_BITS + MATERIAL_BITS);
+			key |= shader << MATERIAL_BITS;
+			key |= material;
+		}
+		else
+		{
+			key |= shader << (MATERIAL_BITS + DEPTH_BITS);
+			key |= material << DEPTH_BITS;
+			key |= depthBits;
+		}
+		return key;
+	}
+
+	// a box around the camera gets clipped by the near plane and can fail its query however visible it is
+	bool ContainsViewPosition(const AABB& aabb, const glm::vec3& viewPosition, float nearDistance)
+	{
+		return glm::all(glm::greaterThanEqual(viewPosition, aabb.min - nearDistance)) && glm::all(glm::lessThanEqual(viewPosition, aabb.max + nearDistance));
+	}
+}
+
+RenderQueue::RenderQueue()
+	: m_viewMatrix(1.0f)
+	, m_projectionMatrix(1.0f)
+	, m_frustum()
+	, m_viewPosition(0.0f)
+	, m_projectionScale(1.0f)
+	, m_nearDistance(0.0f)
+	, m_meshes()
+	, m_bounds()
+	, m_transforms()
+	, m_occlusionQueries()
+	, m_keys()
+	, m_sortTemp()
+	, m_culler()
+	, m_pOcclusionCuller(nullptr)
+	, m_queryBatch()
+	, m_frame(0)
+	, m_drawData()
+	, m_commands()
+	, m_batches()
+	, m_drawBuffer(INITIAL_DRAW_CAPACITY)
+	, m_commandBuffer(INITIAL_DRAW_CAPACITY)
+	, m_numOccluded(0)
+	, m_numQuerySkipped(0)
+	, m_numConditionalDraws(0)
+	, m_numMaterialChanges(0)
+	, m_numVertexArrayChanges(0)
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::Begin(Camera& camera)
+{
+	m_viewMatrix = camera.GetViewMatrix();
+	m_projectionMatrix = camera.GetProjectionMatrix();
+	m_frustum = camera.GetFrustum();
+	m_viewPosition = camera.GetPosition();
+	m_projectionScale = camera.GetProjectionMatrix()[1][1] * camera.GetHeight() * 0.5f;
+	m_nearDistance = camera.GetNearPlaneDistance();
+
+	m_meshes.clear();
+	m_bounds.clear();
+	m_transforms.clear();
+	m_occlusionQueries.clear();
+	m_keys.clear();
+	m_culler.Clear();
+}
+
+void RenderQueue::Submit(Mesh* pMesh, const glm::mat4& transform, RenderPass pass, bool bOcclusionQuery)
+{
+	Material* pMaterial = pMesh->GetMaterial();
+	Shader* pShader = pMaterial->GetShader();
+
+	const AABB aabb = TransformAABB(pMesh->GetAABB(), transform);
+	const BoundingSphere sphere = TransformBoundingSphere(pMesh->GetBoundingSphere(), transform);
+	m_culler.Add(aabb, sphere);
+
+	// view space looks down -z
+	const float depth = -(m_viewMatrix * glm::vec4(sphere.center, 1.0f)).z;
+
+	SortKey sortKey;
+	sortKey.key = MakeSortKey(pass, pMaterial->IsTranslucent(), pShader ? pShader->GetId() : 0, pMaterial->GetId(), depth);
+	sortKey.value = static_cast<uint32_t>(m_meshes.size());
+	m_keys.push_back(sortKey);
+	m_meshes.push_back(pMesh);
+	m_bounds.push_back(aabb);
+	m_transforms.push_back(transform);
+	m_occlusionQueries.push_back(bOcclusionQuery);
+}
+
+void RenderQueue::Flush()
+{
+	m_culler.Cull(m_frustum, m_viewPosition, m_projectionScale);
+	m_keys.erase(std::remove_if(m_keys.begin(), m_keys.end(), [this](const SortKey& sortKey) { return !m_culler.IsVisible(sortKey.value); }), m_keys.end());
+
+	// after the frustum test, so only what's on screen gets the more expensive one
+	const size_t numVisible = m_keys.size();
+	if (m_pOcclusionCuller)
+	{
+		m_keys.erase(std::remove_if(m_keys.begin(), m_keys.end(), [this](const SortKey& sortKey) { return !m_pOcclusionCuller->IsVisible(m_bounds[sortKey.value]); }), m_keys.end());
+	}
+	m_numOccluded = static_cast<unsigned int>(numVisible - m_keys.size());
+
+	m_sortTemp.resize(m_keys.size());
+	RadixSort(m_keys.data(), m_sortTemp.data(), m_keys.size());
+
+	m_numMaterialChanges = 0;
+	m_numVertexArrayChanges = 0;
+	m_numQuerySkipped = 0;
+	m_numConditionalDraws = 0;
+	m_queryBatch.Clear();
+	++m_frame;
+
+	m_drawData.clear();
+	m_commands.clear();
+	m_batches.clear();
+
+	for (const SortKey& sortKey : m_keys)
+	{
+		Mesh* pMesh = m_meshes[sortKey.value];
+
+		OcclusionQuery* pConditionalQuery = nullptr;
+		if (m_occlusionQueries[sortKey.value])
+		{
+			OcclusionQuery& query = pMesh->GetOcclusionQuery();
+			const AABB& bounds = m_bounds[sortKey.value];
+			const bool bContainsView = ContainsViewPosition(bounds, m_viewPosition, m_nearDistance);
+			// results from before the draw last went off screen, or from inside its box, don't count
+			if (query.GetLastFrame() + 1 != m_frame || bContainsView)
+			{
+				query.Reset();
+			}
+			query.SetLastFrame(m_frame);
+
+			if (!bContainsView)
+			{
+				query.Update();
+				if (query.IsPending())
+				{
+					pConditionalQuery = &query;
+				}
+				else
+				{
+					// a new query whether it's drawn or not, otherwise a hidden draw could never come back
+					m_queryBatch.Add(&query, bounds);
+					if (query.IsOccluded())
+					{
+						++m_numQuerySkipped;
+						continue;
+					}
+				}
+			}
+		}
+
+		if (m_commands.size() == MAX_DRAW_IDS)
+		{
+			printf("Error. More than %u draws in one frame, the rest are dropped\n", MAX_DRAW_IDS);
+			break;
+		}
+
+		const unsigned int slot = static_cast<unsigned int>(m_commands.size());
+		GpuDrawData drawData = {};
+		drawData.transform = m_transforms[sortKey.value];
+		drawData.numIndices = pMesh->GetNumIndices();
+		drawData.firstIndex = pMesh->GetFirstIndex();
+		drawData.baseVertex = pMesh->GetBaseVertex();
+		m_drawData.push_back(drawData);
+		m_commands.push_back({ pMesh->GetNumIndices(), 1, pMesh->GetFirstIndex(), pMesh->GetBaseVertex(), slot });
+
+		const bool bTranslucent = (sortKey.key >> TRANSLUCENT_SHIFT) & 1;
+		const bool bNewBatch = m_batches.empty() || pConditionalQuery || m_batches.back().pConditionalQuery
+			|| m_batches.back().pMaterial != pMesh->GetMaterial() || m_batches.back().vertexArray != pMesh->GetVertexArray()
+			|| m_batches.back().bTranslucent != bTranslucent;
+		if (bNewBatch)
+		{
+			m_batches.push_back({ pMesh->GetMaterial(), pMesh->GetVertexArray(), bTranslucent, pConditionalQuery, slot, 0 });
+		}
+		++m_batches.back().numCommands;
+	}
+
+	ComputeDrawMatrices(m_projectionMatrix * m_viewMatrix, m_drawData.data(), m_drawData.size());
+
+	GLStateCache* pStateCache = GLStateCache::GetInstance();
+	if (!m_commands.empty())
+	{
+		// built in the vectors first, mapped memory is write combined and slow to read back from
+		const unsigned int numDraws = static_cast<unsigned int>(m_commands.size());
+		memcpy(m_drawBuffer.BeginFrame(numDraws), m_drawData.data(), numDraws * sizeof(GpuDrawData));
+		memcpy(m_commandBuffer.BeginFrame(numDraws), m_commands.data(), numDraws * sizeof(DrawElementsIndirectCommand));
+		m_drawBuffer.BindRange(GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING);
+		pStateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer.GetBuffer());
+	}
+
+	Material* pCurrentMaterial = nullptr;
+	unsigned int currentVertexArray = 0;
+	bool bBlending = false;
+	for (const DrawBatch& batch : m_batches)
+	{
+		if (batch.bTranslucent != bBlending)
+		{
+			if (batch.bTranslucent)
+			{
+				pStateCache->SetEnabled(GL_BLEND, true);
+				pStateCache->SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				pStateCache->SetDepthMask(false);
+			}
+			else
+			{
+				pStateCache->SetEnabled(GL_BLEND, false);
+				pStateCache->SetDepthMask(true);
+			}
+			bBlending = batch.bTranslucent;
+		}
+
+		if (batch.pMaterial != pCurrentMaterial)
+		{
+			pCurrentMaterial = batch.pMaterial;
+			pCurrentMaterial->ApplyParams();
+			++m_numMaterialChanges;
+		}
+
+		if (batch.vertexArray != currentVertexArray)
+		{
+			currentVertexArray = batch.vertexArray;
+			pStateCache->BindVertexArray(currentVertexArray);
+			++m_numVertexArrayChanges;
+		}
+
+		const void* pOffset = reinterpret_cast<const void*>(m_commandBuffer.GetOffset() + batch.firstCommand * sizeof(DrawElementsIndirectCommand));
+		if (batch.pConditionalQuery)
+		{
+			// the GPU skips the draw if the query's result is in by the time it gets there, and draws it otherwise
+			glBeginConditionalRender(batch.pConditionalQuery->GetId(), GL_QUERY_NO_WAIT);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, pOffset, batch.numCommands, 0);
+			glEndConditionalRender();
+			++m_numConditionalDraws;
+		}
+		else
+		{
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, pOffset, batch.numCommands, 0);
+		}
+	}
+
+	if (bBlending)
+	{
+		pStateCache->SetEnabled(GL_BLEND, false);
+		pStateCache->SetDepthMask(true);
+	}
+
+	if (!m_commands.empty())
+	{
+		m_drawBuffer.EndFrame();
+		m_commandBuffer.EndFrame();
+	}
+
+	// against the finished depth buffer, and translucent draws don't write depth so they don't affect it
+	m_queryBatch.Issue(m_viewMatrix, m_projectionMatrix);
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Core/RadixSort.h"
+#include "FrustumCuller.h"
+#include "DrawData.h"
+#include "FrameRingBuffer.h"
+#include "OcclusionQuery.h"
+
+class Camera;
+class Material;
+class Mesh;
+class OcclusionCuller;
+
+// passes are drawn in order, everything in one pass before anything in the next
+enum RenderPass
+{
+	RP_MAIN = 0,
+};
+
+// Collects the frame's draws and issues them in an order that keeps state changes down. Every draw gets a 64-bit
+// key, which is radix sorted once per frame:
+//
+// opaque:      pass:2 | 0:1 | shader:16 | material:21 | depth:24       (front to back within a material)
+// translucent: pass:2 | 1:1 | inverted depth:24 | shader:16 | material:21 (back to front)
+//
+// Draws whose bounds are outside the camera's frustum, or too small on screen, are dropped before sorting, followed by
+// those hidden behind the occluders when an occlusion culler is set. Draws submitted with an occlusion query go by the
+// result of their box's query from an earlier frame, and get a new one issued after the opaque draws.
+//
+// What's left is packed in sorted order into one indirect command and one GpuDrawData per draw, copied once into
+// persistently mapped ring buffers, and each run of draws sharing a material and vertex array goes out as a single
+// glMultiDrawElementsIndirect. The command's base instance is the draw's slot, which the draw id attribute turns into
+// the index of its matrices, so nothing is set per draw. The normal and world view projection matrices are computed
+// for the whole frame in one batch. Draws waiting on a query are their own run, wrapped in conditional rendering.
+// Draws past MAX_DRAW_IDS in a frame are dropped.
+class RenderQueue
+{
+public:
+	// needs a current GL context
+	RenderQueue();
+	~RenderQueue();
+
+	// starts a new frame, dropping anything submitted before
+	void Begin(Camera& camera);
+	void Submit(Mesh* pMesh, const glm::mat4& transform, RenderPass pass = RP_MAIN, bool bOcclusionQuery = false);
+	// culls, sorts and draws everything submitted since Begin
+	void Flush();
+
+	// optional, rasterized by the caller before Flush. Null turns occlusion culling off.
+	void SetOcclusionCuller(OcclusionCuller* pOcclusionCuller) { m_pOcclusionCuller = pOcclusionCuller; }
+
+	unsigned int GetNumSubmitted() const { return static_cast<unsigned int>(m_meshes.size()); }
+	// draws that survived culling in the last Flush
+	unsigned int GetNumDraws() const { return static_cast<unsigned int>(m_keys.size()); }
+	// for the cull counts from the last Flush and the minimum screen size
+	FrustumCuller& GetCuller() { return m_culler; }
+	const FrustumCuller& GetCuller() const { return m_culler; }
+	// draws that passed the frustum and size tests but were hidden by occluders in the last Flush
+	unsigned int GetNumOccluded() const { return m_numOccluded; }
+	// hardware occlusion queries in the last Flush. Skipped draws are the ones known to be hidden, conditional ones
+	// still had a query in flight and were left to the GPU.
+	unsigned int GetNumQueriesIssued() const { return m_queryBatch.GetNumQueries(); }
+	unsigned int GetNumQuerySkipped() const { return m_numQuerySkipped; }
+	unsigned int GetNumConditionalDraws() const { return m_numConditionalDraws; }
+	// state changes issued by the last Flush
+	unsigned int GetNumMaterialChanges() const { return m_numMaterialChanges; }
+	unsigned int GetNumVertexArrayChanges() const { return m_numVertexArrayChanges; }
+	unsigned int GetNumMultiDraws() const { return static_cast<unsigned int>(m_batches.size()); }
+
+private:
+	// a run of consecutive commands drawn with one call
+	struct DrawBatch
+	{
+		Material* pMaterial;
+		unsigned int vertexArray;
+		bool bTranslucent;
+		// null unless the run is a single draw waiting on this query
+		OcclusionQuery* pConditionalQuery;
+		unsigned int firstCommand;
+		unsigned int numCommands;
+	};
+
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	Frustum m_frustum;
+	glm::vec3 m_viewPosition;
+	float m_projectionScale;
+	float m_nearDistance;
+
+	std::vector<Mesh*> m_meshes;
+	// world space bounds of each of m_meshes, for the occlusion test
+	std::vector<AABB> m_bounds;
+	std::vector<glm::mat4> m_transforms;
+	std::vector<bool> m_occlusionQueries;
+	// values index into m_meshes, which are added to the culler in the same order
+	std::vector<SortKey> m_keys;
+	std::vector<SortKey> m_sortTemp;
+	FrustumCuller m_culler;
+	OcclusionCuller* m_pOcclusionCuller;
+	OcclusionQueryBatch m_queryBatch;
+	unsigned int m_frame;
+
+	std::vector<GpuDrawData> m_drawData;
+	std::vector<DrawElementsIndirectCommand> m_commands;
+	std::vector<DrawBatch> m_batches;
+	FrameRingBuffer<GpuDrawData> m_drawBuffer;
+	FrameRingBuffer<DrawElementsIndirectCommand> m_commandBuffer;
+
+	unsigned int m_numOccluded;
+	unsigned int m_numQuerySkipped;
+	unsigned int m_numConditionalDraws;
+	unsigned int m_numMaterialChanges;
+	unsigned int m_numVertexArrayChanges;
+};
+
+#endif
\ No newline at end of file
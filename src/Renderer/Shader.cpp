@@ -1,21 +1,95 @@
 #include "Shader.h"
 
-#include <cerrno>
+#include <algorithm>
 #include <cstdio>
 
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "Core/Utils.h"
+#include "Core/FileSystem.h"
+#include "GLStateCache.h"
+#include "ShaderCache.h"
+#include "ShaderPreprocessor.h"
 
 
-shaderId_t Shader::sCurrentProgram = 0;
+namespace
+{
+	struct ShaderFeatureDefine
+	{
+		ShaderFeature feature;
+		const char* pDefine;
+	};
+
+	const ShaderFeatureDefine SHADER_FEATURE_DEFINES[] = {
+		{ SF_DIFFUSE_MAP, "HAS_DIFFUSE_MAP" },
+		{ SF_SPECULAR_MAP, "HAS_SPECULAR_MAP" },
+		{ SF_DRAW_DATA, "HAS_DRAW_DATA" },
+	};
+
+	bool IsSamplerType(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_SAMPLER_1D:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_3D:
+		case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_CUBE_SHADOW:
+		case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_2D:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+void GetShaderDefines(shaderPermutation_t permutation, std::vector<std::string>& outDefines)
+{
+	outDefines.clear();
+	for (const ShaderFeatureDefine& featureDefine : SHADER_FEATURE_DEFINES)
+	{
+		if (permutation & featureDefine.feature)
+		{
+			outDefines.push_back(featureDefine.pDefine);
+		}
+	}
+}
+
+Shader::Shader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, shaderPermutation_t permutation)
+	: m_key()
+	, m_id(0)
+	, m_uniforms()
+	, m_uniformBlocks()
+	, m_uniformLookup()
+	, m_uniformBlockLookup()
+	, m_pUniformOwner(nullptr)
+{
+	const unsigned int stageTypes[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	const std::string stagePaths[] = { vertexShaderPath, fragmentShaderPath };
+	Build(stageTypes, stagePaths, 2, permutation);
+}
+
+Shader::Shader(const std::string& computeShaderPath, shaderPermutation_t permutation)
+	: m_key()
+	, m_id(0)
+	, m_uniforms()
+	, m_uniformBlocks()
+	, m_uniformLookup()
+	, m_uniformBlockLookup()
+	, m_pUniformOwner(nullptr)
+{
+	const unsigned int stageType = GL_COMPUTE_SHADER;
+	Build(&stageType, &computeShaderPath, 1, permutation);
+}
 
-Shader::Shader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath)
-	: m_id(0)
-	, mUniformLocationMap()
+void Shader::Build(const unsigned int* pStageTypes, const std::string* pStagePaths, unsigned int numStages, shaderPermutation_t permutation)
 {
-	auto CheckShaderCompileStatus = [](GLuint shader) -> void
+	auto CheckShaderCompileStatus = [](GLuint shader, const std::vector<std::string>& files) -> void
 	{
 		GLint status;
 		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
@@ -24,9 +98,14 @@ Shader::Shader(const std::string& vertexShaderPath, const std::string& fragmentS
 			char infoLog[512];
 			glGetShaderInfoLog(shader, 512, NULL, infoLog);
 			printf("Shader compilation failed. %s\n", infoLog);
+			// errors are reported against each file's source string number
+			for (size_t i = 0; i < files.size(); ++i)
+			{
+				printf("  %zu: %s\n", i, files[i].c_str());
+			}
 		}
 	};
-	auto CheckProgramLinkStatus = [](GLuint program) -> void
+	auto CheckProgramLinkStatus = [](GLuint program) -> bool
 	{
 		GLint status;
 		glGetProgramiv(program, GL_LINK_STATUS, &status);
@@ -36,100 +115,225 @@ Shader::Shader(const std::string& vertexShaderPath, const std::string& fragmentS
 			glGetProgramInfoLog(program, 512, NULL, infoLog);
 			printf("Program linking failed. %s\n", infoLog);
 		}
+		return status != 0;
 	};
 
-	// vertex shader
-	char* pVertexShaderSource = (char*)LoadFileContents(vertexShaderPath);
-	if (!pVertexShaderSource)
+	auto CompileShader = [&](GLenum type, const std::string& source, const std::vector<std::string>& files) -> GLuint
 	{
-		printf("Failed to generate shader program. Invalid vertex shader \"%s\"\n", vertexShaderPath.c_str());
-		return;
+		const GLchar* pSource = source.c_str();
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &pSource, nullptr);
+		glCompileShader(shader);
+		CheckShaderCompileStatus(shader, files);
+		return shader;
+	};
+
+	auto GetStageName = [](GLenum type) -> const char*
+	{
+		switch (type)
+		{
+		case GL_VERTEX_SHADER:
+			return "vertex";
+		case GL_FRAGMENT_SHADER:
+			return "fragment";
+		case GL_COMPUTE_SHADER:
+			return "compute";
+		default:
+			return "unknown";
+		}
+	};
+
+	std::vector<std::string> defines;
+	GetShaderDefines(permutation, defines);
+
+	std::vector<std::string> sources(numStages);
+	std::vector<std::vector<std::string>> files(numStages);
+	std::vector<FileView> sourceViews(numStages);
+	for (unsigned int i = 0; i < numStages; ++i)
+	{
+		if (!PreprocessShader(pStagePaths[i], defines, sources[i], files[i]))
+		{
+			printf("Failed to generate shader program. Invalid %s shader \"%s\"\n", GetStageName(pStageTypes[i]), pStagePaths[i].c_str());
+			return;
+		}
+		sourceViews[i] = FileView{ reinterpret_cast<const unsigned char*>(sources[i].data()), sources[i].size() };
 	}
-	//const char* const pVertexShaderSource = vertexShaderSource.c_str();
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &pVertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-	CheckShaderCompileStatus(vertexShader);
-
-	// fragment shader
-	char* pFragmentShaderSource = (char*)LoadFileContents(fragmentShaderPath);
-	if (!pFragmentShaderSource)
-	{
-		printf("Failed to generate shader program. Invalid fragment shader \"%s\"\n", fragmentShaderPath.c_str());
-		glDeleteShader(vertexShader);
+
+	// warm starts get the linked program straight from the binary cache. The key covers the preprocessed text, so
+	// it changes with the defines and with any included file.
+	ShaderCache* pShaderCache = ShaderCache::GetInstance();
+	const hash_t cacheKey = pShaderCache->ComputeKey(sourceViews);
+	m_id = pShaderCache->LoadProgram(cacheKey);
+	if (m_id != 0)
+	{
+		Reflect();
 		return;
 	}
-	//const char* const pFragmentShaderSource = fragmentShaderSource.c_str();
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &pFragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-	CheckShaderCompileStatus(fragmentShader);
+
+	std::vector<GLuint> shaders(numStages);
+	for (unsigned int i = 0; i < numStages; ++i)
+	{
+		shaders[i] = CompileShader(pStageTypes[i], sources[i], files[i]);
+	}
 
 	// link shaders together
 	m_id = glCreateProgram();
-	glAttachShader(m_id, vertexShader);
-	glAttachShader(m_id, fragmentShader);
+	glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (GLuint shader : shaders)
+	{
+		glAttachShader(m_id, shader);
+	}
 	glLinkProgram(m_id);
-	CheckProgramLinkStatus(m_id);
-
-	// clean up source code pointers and delete shaders
-	delete[] pVertexShaderSource;
-	delete[] pFragmentShaderSource;
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	if (CheckProgramLinkStatus(m_id))
+	{
+		pShaderCache->StoreProgram(cacheKey, m_id);
+		Reflect();
+	}
 
-	// TODO: pre-populate uniform map with locations of uniforms
+	// the program keeps what it needs, the shader objects can go
+	for (GLuint shader : shaders)
+	{
+		glDetachShader(m_id, shader);
+		glDeleteShader(shader);
+	}
 }
 
 Shader::~Shader()
 {
-	// TODO: need to manage shaders such that we can delete them when appropriate
-	//glDeleteProgram(m_id);
+	GLStateCache::GetInstance()->OnProgramDeleted(m_id);
+	glDeleteProgram(m_id);
 }
 
 void Shader::Bind()
 {
-	if (sCurrentProgram == m_id)
-	{
-		return;
-	}
+	GLStateCache::GetInstance()->UseProgram(m_id);
+}
+
+uniformHandle_t Shader::GetUniformHandle(hash_t nameHash) const
+{
+	const ShaderUniform* pUniform = FindUniform(nameHash);
+	return pUniform ? pUniform->location : INVALID_UNIFORM_HANDLE;
+}
 
-	glUseProgram(m_id);
-	sCurrentProgram = m_id;
+void Shader::SetUniform(uniformHandle_t handle, int value)
+{
+	glUniform1i(handle, value);
+}
+
+void Shader::SetUniform(uniformHandle_t handle, unsigned int value)
+{
+	glUniform1ui(handle, value);
 }
 
-void Shader::SetUniform(const std::string& name, int value)
+void Shader::SetUniform(uniformHandle_t handle, float value)
 {
-	glUniform1i(GetUniformLocation(name), value);
+	glUniform1f(handle, value);
 }
 
-void Shader::SetUniform(const std::string& name, float value)
+void Shader::SetUniform(uniformHandle_t handle, const glm::vec3& value)
 {
-	glUniform1f(GetUniformLocation(name), value);
+	glUniform3fv(handle, 1, glm::value_ptr(value));
 }
 
-void Shader::SetUniform(const std::string& name, const glm::vec3& value)
+void Shader::SetUniform(uniformHandle_t handle, const glm::vec4& value)
 {
-	glUniform3fv(GetUniformLocation(name), 1, glm::value_ptr(value));
+	glUniform4fv(handle, 1, glm::value_ptr(value));
 }
 
-void Shader::SetUniform(const std::string& name, const glm::mat4& value)
+void Shader::SetUniform(uniformHandle_t handle, const glm::mat4& value)
 {
-	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
+	glUniformMatrix4fv(handle, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-int Shader::GetUniformLocation(const std::string& name)
+void Shader::SetUniform(uniformHandle_t handle, const glm::vec4* pValues, unsigned int count)
 {
-	auto it = mUniformLocationMap.find(name);
-	if (it != mUniformLocationMap.end())
+	glUniform4fv(handle, count, glm::value_ptr(pValues[0]));
+}
+
+bool Shader::AcquireUniforms(const void* pOwner)
+{
+	if (m_pUniformOwner == pOwner)
 	{
-		return it->second;
+		return false;
 	}
 
-	GLint loc = glGetUniformLocation(m_id, name.c_str());
-	if (loc != GL_INVALID_INDEX)
+	m_pUniformOwner = pOwner;
+	return true;
+}
+
+void Shader::ReleaseUniforms(const void* pOwner)
+{
+	if (m_pUniformOwner == pOwner)
 	{
-		mUniformLocationMap[name] = loc;
+		m_pUniformOwner = nullptr;
+	}
+}
+
+const ShaderUniform* Shader::FindUniform(hash_t nameHash) const
+{
+	auto it = m_uniformLookup.find(nameHash);
+	return it != m_uniformLookup.end() ? &m_uniforms[it->second] : nullptr;
+}
+
+const ShaderUniformBlock* Shader::FindUniformBlock(hash_t nameHash) const
+{
+	auto it = m_uniformBlockLookup.find(nameHash);
+	return it != m_uniformBlockLookup.end() ? &m_uniformBlocks[it->second] : nullptr;
+}
+
+void Shader::Reflect()
+{
+	auto GetResourceName = [this](GLenum programInterface, GLuint index, GLint nameLength) -> std::string
+	{
+		// the reported length includes the terminator
+		std::string name(static_cast<size_t>(std::max(nameLength, 1)), '\0');
+		glGetProgramResourceName(m_id, programInterface, index, nameLength, nullptr, &name[0]);
+		name.resize(name.size() - 1);
+		return name;
+	};
+
+	GLint numBlocks = 0;
+	glGetProgramInterfaceiv(m_id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &numBlocks);
+	m_uniformBlocks.resize(static_cast<size_t>(numBlocks));
+	for (GLint i = 0; i < numBlocks; ++i)
+	{
+		const GLenum properties[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+		GLint values[3] = {};
+		glGetProgramResourceiv(m_id, GL_UNIFORM_BLOCK, i, 3, properties, 3, nullptr, values);
+
+		ShaderUniformBlock& block = m_uniformBlocks[i];
+		block.name = GetResourceName(GL_UNIFORM_BLOCK, i, values[0]);
+		block.nameHash = HashString(block.name);
+		block.index = static_cast<unsigned int>(i);
+		block.binding = static_cast<unsigned int>(values[1]);
+		block.dataSize = static_cast<unsigned int>(values[2]);
+		m_uniformBlockLookup[block.nameHash] = static_cast<unsigned int>(i);
+	}
+
+	GLint numUniforms = 0;
+	glGetProgramInterfaceiv(m_id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
+	m_uniforms.resize(static_cast<size_t>(numUniforms));
+	for (GLint i = 0; i < numUniforms; ++i)
+	{
+		const GLenum properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET };
+		GLint values[6] = {};
+		glGetProgramResourceiv(m_id, GL_UNIFORM, i, 6, properties, 6, nullptr, values);
+
+		ShaderUniform& uniform = m_uniforms[i];
+		uniform.name = GetResourceName(GL_UNIFORM, i, values[0]);
+		uniform.nameHash = HashString(uniform.name);
+		uniform.type = static_cast<unsigned int>(values[1]);
+		uniform.arraySize = values[2];
+		uniform.location = values[3];
+		uniform.blockIndex = values[4];
+		uniform.offset = values[5];
+		uniform.bSampler = IsSamplerType(uniform.type);
+		m_uniformLookup[uniform.nameHash] = static_cast<unsigned int>(i);
+
+		// arrays are reported as "name[0]", but should be reachable by their plain name as well
+		if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+		{
+			m_uniformLookup[HashBytes(uniform.name.data(), uniform.name.size() - 3)] = static_cast<unsigned int>(i);
+		}
 	}
-	return loc;
 }
\ No newline at end of file
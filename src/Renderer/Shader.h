@@ -2,32 +2,110 @@
 #define SHADER_H
 
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include "Core/Hash.h"
+
 typedef unsigned int shaderId_t;
+// location of a uniform in the default block, resolved once through GetUniformHandle
+typedef int uniformHandle_t;
+const uniformHandle_t INVALID_UNIFORM_HANDLE = -1;
+// bitmask of ShaderFeatures, picks which variant of a shader gets compiled
+typedef unsigned int shaderPermutation_t;
+
+// optional parts of a shader, each compiled in through a define so materials only pay for the features they use
+enum ShaderFeature
+{
+	SF_DIFFUSE_MAP = 1 << 0,
+	SF_SPECULAR_MAP = 1 << 1,
+	// the model matrix comes from the per draw storage buffer instead of a uniform, for GPU driven draws
+	SF_DRAW_DATA = 1 << 2,
+};
+
+void GetShaderDefines(shaderPermutation_t permutation, std::vector<std::string>& outDefines);
+
+// an active uniform, as reflected from the linked program
+struct ShaderUniform
+{
+	std::string name;
+	hash_t nameHash = 0;
+	// GL type enum, e.g. GL_FLOAT_VEC3 or GL_SAMPLER_2D
+	unsigned int type = 0;
+	int arraySize = 1;
+	// INVALID_UNIFORM_HANDLE for uniforms in a block, which have a block index and offset instead
+	uniformHandle_t location = INVALID_UNIFORM_HANDLE;
+	int blockIndex = -1;
+	int offset = -1;
+	bool bSampler = false;
+};
+
+struct ShaderUniformBlock
+{
+	std::string name;
+	hash_t nameHash = 0;
+	unsigned int index = 0;
+	unsigned int binding = 0;
+	unsigned int dataSize = 0;
+};
 
+// Linked program, either vertex and fragment or a lone compute shader. Only created through ShaderManager so that every
+// material using the same sources shares it.
+// Every active uniform and block is reflected once after linking, so setting a uniform is a plain integer handle.
 class Shader
 {
-public:
-	Shader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
-	~Shader();
+	friend class ShaderManager;
 
+public:
 	void Bind();
 
-	void SetUniform(const std::string& name, int value);
-	void SetUniform(const std::string& name, float value);
-	void SetUniform(const std::string& name, const glm::vec3& value);
-	void SetUniform(const std::string& name, const glm::mat4& value);
+	shaderId_t GetId() const { return m_id; }
+
+	// handles are fixed for the program's lifetime, so resolve them once and keep them. Inactive or unknown names
+	// give INVALID_UNIFORM_HANDLE, which the setters ignore.
+	uniformHandle_t GetUniformHandle(hash_t nameHash) const;
+	uniformHandle_t GetUniformHandle(const std::string& name) const { return GetUniformHandle(HashString(name)); }
+
+	// the program has to be bound
+	void SetUniform(uniformHandle_t handle, int value);
+	void SetUniform(uniformHandle_t handle, unsigned int value);
+	void SetUniform(uniformHandle_t handle, float value);
+	void SetUniform(uniformHandle_t handle, const glm::vec3& value);
+	void SetUniform(uniformHandle_t handle, const glm::vec4& value);
+	void SetUniform(uniformHandle_t handle, const glm::mat4& value);
+	// arrays, from the handle of the first element
+	void SetUniform(uniformHandle_t handle, const glm::vec4* pValues, unsigned int count);
+
+	const std::vector<ShaderUniform>& GetUniforms() const { return m_uniforms; }
+	const std::vector<ShaderUniformBlock>& GetUniformBlocks() const { return m_uniformBlocks; }
+	const ShaderUniform* FindUniform(hash_t nameHash) const;
+	const ShaderUniformBlock* FindUniformBlock(hash_t nameHash) const;
+
+	// default block uniforms are program state, shared by everything drawn with it. Returns true if something other
+	// than pOwner set them last, in which case pOwner has to set all of its values again.
+	bool AcquireUniforms(const void* pOwner);
+	// forgets pOwner if it set the uniforms last, for when it's destroyed or switches shader
+	void ReleaseUniforms(const void* pOwner);
 
 private:
+	std::string m_key;
 	shaderId_t m_id;
-	std::map<std::string, int> mUniformLocationMap;
 
-	int GetUniformLocation(const std::string& name);
+	std::vector<ShaderUniform> m_uniforms;
+	std::vector<ShaderUniformBlock> m_uniformBlocks;
+	// name hash to index in m_uniforms. Arrays are found by both "name" and "name[0]".
+	std::unordered_map<hash_t, unsigned int> m_uniformLookup;
+	std::unordered_map<hash_t, unsigned int> m_uniformBlockLookup;
+	const void* m_pUniformOwner;
 
-	static shaderId_t sCurrentProgram;
+	void Build(const unsigned int* pStageTypes, const std::string* pStagePaths, unsigned int numStages, shaderPermutation_t permutation);
+	void Reflect();
+
+	Shader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, shaderPermutation_t permutation);
+	Shader(const std::string& computeShaderPath, shaderPermutation_t permutation);
+	~Shader();
 };
 
 #endif
\ No newline at end of file
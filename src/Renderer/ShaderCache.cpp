@@ -0,0 +1,184 @@
+#include "ShaderCache.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+
+#include <glad/glad.h>
+
+namespace
+{
+	hash_t HashGLString(GLenum name, hash_t seed)
+	{
+		const GLubyte* pString = glGetString(name);
+		return pString ? HashString(reinterpret_cast<const char*>(pString), seed) : seed;
+	}
+}
+
+ShaderCache* ShaderCache::s_instance = nullptr;
+
+ShaderCache::ShaderCache()
+	: m_driverHash(HASH_SEED)
+	, m_bSupported(false)
+	, m_bDirectoryCreated(false)
+{
+	m_driverHash = HashGLString(GL_VENDOR, m_driverHash);
+	m_driverHash = HashGLString(GL_RENDERER, m_driverHash);
+	m_driverHash = HashGLString(GL_VERSION, m_driverHash);
+	m_driverHash = HashGLString(GL_SHADING_LANGUAGE_VERSION, m_driverHash);
+
+	// some drivers expose the entry points but no formats, in which case there's nothing to cache
+	GLint numFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	m_bSupported = numFormats > 0;
+}
+
+ShaderCache::~ShaderCache()
+{
+}
+
+ShaderCache* ShaderCache::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new ShaderCache();
+	}
+
+	return s_instance;
+}
+
+hash_t ShaderCache::ComputeKey(const std::vector<FileView>& sources) const
+{
+	hash_t key = m_driverHash;
+	for (const FileView& source : sources)
+	{
+		// hash the length as well so moving text from the end of one stage to the start of the next changes the key
+		const uint64_t size = source.size;
+		key = HashBytes(&size, sizeof(size), key);
+		key = HashBytes(source.pData, source.size, key);
+	}
+	return key;
+}
+
+shaderId_t ShaderCache::LoadProgram(hash_t key) const
+{
+	if (!m_bSupported)
+	{
+		return 0;
+	}
+
+	const std::string filename = GetCacheFilename(key);
+	File file;
+	if (!FileSystem::GetInstance()->Open(filename, file))
+	{
+		return 0;
+	}
+
+	const unsigned char* pData = file.GetData();
+	const size_t size = file.GetSize();
+	const ShaderCacheHeader* pHeader = reinterpret_cast<const ShaderCacheHeader*>(pData);
+	const bool bValid = size >= sizeof(ShaderCacheHeader)
+		&& pHeader->magic == SHADER_CACHE_MAGIC
+		&& pHeader->version == SHADER_CACHE_VERSION
+		&& pHeader->key == key
+		&& pHeader->driverHash == m_driverHash
+		&& sizeof(ShaderCacheHeader) + static_cast<uint64_t>(pHeader->binarySize) <= size
+		&& HashBytes(pData + sizeof(ShaderCacheHeader), pHeader->binarySize) == pHeader->binaryHash;
+	if (!bValid)
+	{
+		printf("Shader cache \"%s\" is corrupt\n", filename.c_str());
+		file.Close();
+		std::remove(filename.c_str());
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, pHeader->binaryFormat, pData + sizeof(ShaderCacheHeader), static_cast<GLsizei>(pHeader->binarySize));
+
+	// drivers are free to reject binaries at any time, e.g. after an update that kept the version string
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status)
+	{
+		glDeleteProgram(program);
+		file.Close();
+		std::remove(filename.c_str());
+		return 0;
+	}
+
+	return program;
+}
+
+void ShaderCache::StoreProgram(hash_t key, shaderId_t program)
+{
+	if (!m_bSupported)
+	{
+		return;
+	}
+
+	GLint binarySize = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+	if (binarySize <= 0)
+	{
+		return;
+	}
+
+	std::vector<unsigned char> binary(static_cast<size_t>(binarySize));
+	GLenum binaryFormat = 0;
+	GLsizei length = 0;
+	glGetProgramBinary(program, binarySize, &length, &binaryFormat, binary.data());
+	if (length <= 0)
+	{
+		return;
+	}
+	binary.resize(static_cast<size_t>(length));
+
+	if (!m_bDirectoryCreated)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+		m_bDirectoryCreated = true;
+	}
+
+	ShaderCacheHeader header = {};
+	header.magic = SHADER_CACHE_MAGIC;
+	header.version = SHADER_CACHE_VERSION;
+	header.key = key;
+	header.driverHash = m_driverHash;
+	header.binaryFormat = binaryFormat;
+	header.binarySize = static_cast<uint32_t>(binary.size());
+	header.binaryHash = HashBytes(binary.data(), binary.size());
+
+	// write to a temporary file first so a crash never leaves a truncated binary behind
+	const std::string filename = GetCacheFilename(key);
+	const std::string tempFilename = filename + ".tmp";
+	FILE* pFile = fopen(tempFilename.c_str(), "wb");
+	if (!pFile)
+	{
+		printf("Failed to open shader cache \"%s\" for writing\n", tempFilename.c_str());
+		return;
+	}
+
+	bool bSuccess = std::fwrite(&header, sizeof(header), 1, pFile) == 1
+		&& std::fwrite(binary.data(), 1, binary.size(), pFile) == binary.size();
+	bSuccess = (std::fclose(pFile) == 0) && bSuccess;
+
+	if (bSuccess)
+	{
+		std::remove(filename.c_str());
+		bSuccess = std::rename(tempFilename.c_str(), filename.c_str()) == 0;
+	}
+
+	if (!bSuccess)
+	{
+		printf("Failed to write shader cache \"%s\"\n", filename.c_str());
+		std::remove(tempFilename.c_str());
+	}
+}
+
+std::string ShaderCache::GetCacheFilename(hash_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64, key);
+	return std::string(SHADER_CACHE_DIRECTORY) + "/" + name + SHADER_CACHE_EXTENSION;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Core/Hash.h"
+#include "Core/FileSystem.h"
+#include "Shader.h"
+
+// On-disk cache of linked program binaries, so warm starts skip GLSL compilation. Binaries are only valid for the
+// driver that produced them, so the key covers the driver as well as the sources, and one file is written per key.
+//
+// layout: header | binary
+
+const char* const SHADER_CACHE_DIRECTORY = "shadercache";
+const char* const SHADER_CACHE_EXTENSION = ".oprog";
+const uint32_t SHADER_CACHE_MAGIC = 0x474F5250; // "PROG"
+// bump whenever the layout changes
+const uint32_t SHADER_CACHE_VERSION = 1;
+
+struct ShaderCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	hash_t key;
+	hash_t driverHash;
+	uint32_t binaryFormat;
+	uint32_t binarySize;
+	hash_t binaryHash;
+};
+
+class ShaderCache
+{
+public:
+	~ShaderCache();
+
+	// needs a current GL context
+	static ShaderCache* GetInstance();
+
+	// key for a program built from the given shader sources, in stage order. Defines and anything else affecting
+	// compilation have to be part of the source text.
+	hash_t ComputeKey(const std::vector<FileView>& sources) const;
+
+	// creates a program from the cached binary, or returns 0 if there's no binary or the driver rejected it
+	shaderId_t LoadProgram(hash_t key) const;
+	// the program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void StoreProgram(hash_t key, shaderId_t program);
+
+	bool IsSupported() const { return m_bSupported; }
+
+private:
+	ShaderCache();
+
+	std::string GetCacheFilename(hash_t key) const;
+
+	// vendor, renderer and version strings
+	hash_t m_driverHash;
+	bool m_bSupported;
+	bool m_bDirectoryCreated;
+
+	static ShaderCache* s_instance;
+};
+
+#endif
\ No newline at end of file
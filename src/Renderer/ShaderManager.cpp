@@ -0,0 +1,87 @@
+#include "ShaderManager.h"
+
+#include <cstdio>
+
+namespace
+{
+	std::string GetShaderKey(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, shaderPermutation_t permutation)
+	{
+		// newlines can't appear in paths, so this can't be ambiguous
+		return vertexShaderPath + '\n' + fragmentShaderPath + '\n' + std::to_string(permutation);
+	}
+}
+
+ShaderManager* ShaderManager::s_instance = nullptr;
+
+ShaderManager::ShaderManager()
+	: m_shaders()
+{
+}
+
+ShaderManager::~ShaderManager()
+{
+	for (auto& it : m_shaders)
+	{
+		delete it.second.pShader;
+	}
+	m_shaders.clear();
+}
+
+ShaderManager* ShaderManager::GetInstance()
+{
+	if (!s_instance)
+	{
+		s_instance = new ShaderManager();
+	}
+
+	return s_instance;
+}
+
+Shader* ShaderManager::CreateShader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, shaderPermutation_t permutation)
+{
+	const std::string key = GetShaderKey(vertexShaderPath, fragmentShaderPath, permutation);
+	auto it = m_shaders.find(key);
+	if (it != m_shaders.end())
+	{
+		++it->second.refCount;
+		return it->second.pShader;
+	}
+
+	Shader* pShader = new Shader(vertexShaderPath, fragmentShaderPath, permutation);
+	pShader->m_key = key;
+	m_shaders.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(pShader, 1));
+	return pShader;
+}
+
+Shader* ShaderManager::CreateComputeShader(const std::string& computeShaderPath, shaderPermutation_t permutation)
+{
+	// an empty fragment path keeps the key apart from any vertex and fragment pair
+	const std::string key = GetShaderKey(computeShaderPath, "", permutation);
+	auto it = m_shaders.find(key);
+	if (it != m_shaders.end())
+	{
+		++it->second.refCount;
+		return it->second.pShader;
+	}
+
+	Shader* pShader = new Shader(computeShaderPath, permutation);
+	pShader->m_key = key;
+	m_shaders.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(pShader, 1));
+	return pShader;
+}
+
+void ShaderManager::DeleteShader(Shader* pShader)
+{
+	auto it = m_shaders.find(pShader->m_key);
+	if (it == m_shaders.end())
+	{
+		printf("No shader \"%s\" found in ShaderManager\n", pShader->m_key.c_str());
+		return;
+	}
+
+	if (--it->second.refCount == 0)
+	{
+		delete it->second.pShader;
+		m_shaders.erase(it);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+#include <string>
+#include <unordered_map>
+
+#include "Shader.h"
+
+class ShaderManager
+{
+public:
+	~ShaderManager();
+
+	static ShaderManager* GetInstance();
+
+	// returns the program already built from these sources and permutation if there is one, so each variant is only
+	// compiled once however many materials use it, and only variants something asks for are compiled at all. Every
+	// call needs a matching DeleteShader.
+	Shader* CreateShader(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, shaderPermutation_t permutation = 0);
+	Shader* CreateComputeShader(const std::string& computeShaderPath, shaderPermutation_t permutation = 0);
+	void DeleteShader(Shader* pShader);
+
+	unsigned int GetNumShaders() const { return static_cast<unsigned int>(m_shaders.size()); }
+
+private:
+	struct Entry
+	{
+		Shader* pShader = nullptr;
+		unsigned int refCount = 0;
+
+		Entry(Shader* pShader, int refCount) : pShader(pShader), refCount(refCount) {}
+	};
+
+	ShaderManager();
+
+	std::unordered_map<std::string, Entry> m_shaders;
+
+	static ShaderManager* s_instance;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Core/FileSystem.h"
+
+namespace
+{
+	// deep enough for any sane include tree, shallow enough to stop a runaway one
+	const unsigned int MAX_INCLUDE_DEPTH = 32;
+
+	// if line is the given directive, returns the position just past its name
+	bool MatchDirective(const std::string& line, const char* pDirective, size_t& outEnd)
+	{
+		size_t pos = line.find_first_not_of(" \t");
+		if (pos == std::string::npos || line[pos] != '#')
+		{
+			return false;
+		}
+		pos = line.find_first_not_of(" \t", pos + 1);
+		if (pos == std::string::npos || line.compare(pos, strlen(pDirective), pDirective) != 0)
+		{
+			return false;
+		}
+
+		outEnd = pos + strlen(pDirective);
+		return outEnd == line.size() || line[outEnd] == ' ' || line[outEnd] == '\t' || line[outEnd] == '"' || line[outEnd] == '<';
+	}
+
+	bool ParseIncludePath(const std::string& line, size_t start, std::string& outPath)
+	{
+		const size_t open = line.find_first_of("\"<", start);
+		if (open == std::string::npos)
+		{
+			return false;
+		}
+		const size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos || close == open + 1)
+		{
+			return false;
+		}
+
+		outPath = line.substr(open + 1, close - open - 1);
+		return true;
+	}
+
+	std::string GetDirectory(const std::string& filename)
+	{
+		const size_t separator = filename.find_last_of("/\\");
+		return separator == std::string::npos ? std::string() : filename.substr(0, separator + 1);
+	}
+
+	struct PreprocessState
+	{
+		const std::vector<std::string>* pDefines = nullptr;
+		std::string* pSource = nullptr;
+		std::vector<std::string>* pFiles = nullptr;
+		bool bWroteDefines = false;
+	};
+
+	void WriteDefines(PreprocessState& state)
+	{
+		for (const std::string& define : *state.pDefines)
+		{
+			*state.pSource += "#define " + define + "\n";
+		}
+		state.bWroteDefines = true;
+	}
+
+	bool ExpandFile(const std::string& filename, unsigned int depth, PreprocessState& state)
+	{
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			printf("Error. Shader includes nested too deeply at \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		File file;
+		if (!FileSystem::GetInstance()->Open(filename, file))
+		{
+			printf("Failed to open shader \"%s\"\n", filename.c_str());
+			return false;
+		}
+
+		const unsigned int fileIndex = static_cast<unsigned int>(state.pFiles->size());
+		state.pFiles->push_back(filename);
+		if (depth > 0)
+		{
+			*state.pSource += "#line 1 " + std::to_string(fileIndex) + "\n";
+		}
+
+		const char* pText = reinterpret_cast<const char*>(file.GetData());
+		const char* pEnd = pText + file.GetSize();
+		unsigned int lineNumber = 0;
+		while (pText < pEnd)
+		{
+			const char* pLineEnd = std::find(pText, pEnd, '\n');
+			std::string line(pText, pLineEnd);
+			pText = pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+			++lineNumber;
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+
+			size_t directiveEnd = 0;
+			if (MatchDirective(line, "include", directiveEnd))
+			{
+				std::string includePath;
+				if (!ParseIncludePath(line, directiveEnd, includePath))
+				{
+					printf("Error. Malformed #include in \"%s\" line %u\n", filename.c_str(), lineNumber);
+					return false;
+				}
+
+				// every file is only pulled in once, which also stops include cycles
+				includePath = GetDirectory(filename) + includePath;
+				if (std::find(state.pFiles->begin(), state.pFiles->end(), includePath) == state.pFiles->end())
+				{
+					if (!ExpandFile(includePath, depth + 1, state))
+					{
+						return false;
+					}
+					*state.pSource += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+				}
+				continue;
+			}
+
+			*state.pSource += line;
+			*state.pSource += '\n';
+
+			// #version has to come before anything else, so the defines go straight after it
+			if (!state.bWroteDefines && depth == 0 && MatchDirective(line, "version", directiveEnd))
+			{
+				WriteDefines(state);
+				*state.pSource += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+			}
+		}
+
+		return true;
+	}
+}
+
+bool PreprocessShader(const std::string& filename, const std::vector<std::string>& defines, std::string& outSource, std::vector<std::string>& outFiles)
+{
+	outSource.clear();
+	outFiles.clear();
+
+	PreprocessState state;
+	state.pDefines = &defines;
+	state.pSource = &outSource;
+	state.pFiles = &outFiles;
+	if (!ExpandFile(filename, 0, state))
+	{
+		return false;
+	}
+
+	// no #version, so the defines can go first
+	if (!state.bWroteDefines && !defines.empty())
+	{
+		std::string source;
+		source.swap(outSource);
+		WriteDefines(state);
+		outSource += "#line 1 0\n";
+		outSource += source;
+	}
+	return true;
+}
\ No newline at end of file
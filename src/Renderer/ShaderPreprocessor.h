@@ -0,0 +1,12 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+// Expands #include "file" directives (relative to the including file, each file included at most once) and injects
+// a #define for each of the given defines straight after #version. #line directives keep compiler errors pointing at
+// the right line, with each file's index in outFiles as its source string number.
+bool PreprocessShader(const std::string& filename, const std::vector<std::string>& defines, std::string& outSource, std::vector<std::string>& outFiles);
+
+#endif
\ No newline at end of file
@@ -1,18 +1,29 @@
 #include "Texture.h"
 
+#include <cstdio>
+#include <vector>
+
 #include <glm/gtc/type_ptr.hpp>
-#ifndef STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#endif
-#include <stb_image.h>
 
-textureId_t Texture::s_currentTexture = 0;
+#include "GLStateCache.h"
+#include "TextureLoader.h"
+
+// S3TC isn't core GL, so the loader doesn't define these
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
 
 Texture::Texture()
 	: m_filename("")
 	, m_id(0)
 	, m_width(0)
 	, m_height(0)
+	, m_bPlaceholder(false)
 {
 }
 
@@ -21,61 +32,109 @@ Texture::Texture(const std::string& filename, const TextureParams& params, bool
 	, m_id(0)
 	, m_width(0)
 	, m_height(0)
+	, m_bPlaceholder(false)
 {
 	Load(filename, params, isSRGB);
 }
 
 Texture::~Texture()
 {
-	glDeleteTextures(1, &m_id);
+	// the placeholder is shared, so it belongs to TextureManager
+	if (!m_bPlaceholder)
+	{
+		GLStateCache::GetInstance()->OnTextureDeleted(m_id);
+		glDeleteTextures(1, &m_id);
+	}
 }
 
 void Texture::Load(const std::string& filename, const TextureParams& params, bool isSRGB)
 {
-	stbi_set_flip_vertically_on_load(params.bFlipVerticallyOnLoad);
-
-	int numChannels;
-	unsigned char* pTextureData = stbi_load(filename.c_str(), &m_width, &m_height, &numChannels, params.forceComponents);
-	if (!pTextureData)
+	LoadedTextureData data;
+	if (!LoadTextureData(filename, params, isSRGB, data))
 	{
-		printf("Failed to load texture \"%s\"\n", filename.c_str());
 		return;
 	}
-	numChannels = params.forceComponents == 0 ? numChannels : params.forceComponents;
 
-	GLenum format = GL_RGBA;
-	GLenum internalFormat = format;
-	switch (numChannels)
+	if (Upload(data.format, data.bSRGB, data.levels.data(), static_cast<unsigned int>(data.levels.size())))
 	{
-	case 1:
-		format = GL_RED;
+		ApplyParams(params);
+	}
+}
+
+bool Texture::Upload(TextureFormat format, bool isSRGB, const TextureLevel* pLevels, unsigned int numLevels)
+{
+	GLenum pixelFormat = GL_RGBA;
+	GLenum internalFormat = GL_RGBA8;
+	switch (format)
+	{
+	case TF_R8:
+		pixelFormat = GL_RED;
 		internalFormat = GL_R8;
 		break;
-	case 2:
-		format = GL_RG;
+	case TF_RG8:
+		pixelFormat = GL_RG;
 		internalFormat = GL_RG8;
 		break;
-	case 3:
-		format = GL_RGB;
+	case TF_RGB8:
+		pixelFormat = GL_RGB;
 		internalFormat = isSRGB ? GL_SRGB8 : GL_RGB8;
 		break;
-	case 4:
-		format = GL_RGBA;
-		internalFormat = isSRGB? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	case TF_RGBA8:
+		pixelFormat = GL_RGBA;
+		internalFormat = isSRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
 		break;
-	default:
-		printf("Error. Unsupported number of channels (%i) in texture \"%s\"\n", numChannels, filename.c_str());
+	case TF_BC1:
+		internalFormat = isSRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		break;
+	case TF_BC3:
+		internalFormat = isSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 		break;
+	case TF_BC4:
+		internalFormat = GL_COMPRESSED_RED_RGTC1;
+		break;
+	case TF_BC5:
+		internalFormat = GL_COMPRESSED_RG_RGTC2;
+		break;
+	case TF_BC7:
+		internalFormat = isSRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		break;
+	default:
+		printf("Error. Unsupported format (%i) for texture \"%s\"\n", format, m_filename.c_str());
+		return false;
 	}
 
-	glGenTextures(1, &m_id);
-	Bind();
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width, m_height, 0, format, GL_UNSIGNED_BYTE, (void*)pTextureData);
+	m_width = pLevels[0].width;
+	m_height = pLevels[0].height;
+
+	// uploads go through the texture name rather than a binding, so they never disturb what's bound for drawing.
+	// Mips always come from the loader, and immutable storage with just those levels keeps the texture complete.
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
+	glTextureStorage2D(m_id, numLevels, internalFormat, m_width, m_height);
+
+	// rows are tightly packed, which matters for RGB data and the smallest mips
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (unsigned int level = 0; level < numLevels; ++level)
+	{
+		const TextureLevel& textureLevel = pLevels[level];
+		if (IsCompressedFormat(format))
+		{
+			glCompressedTextureSubImage2D(m_id, level, 0, 0, textureLevel.width, textureLevel.height, internalFormat, static_cast<GLsizei>(textureLevel.size), textureLevel.pData);
+		}
+		else
+		{
+			glTextureSubImage2D(m_id, level, 0, 0, textureLevel.width, textureLevel.height, pixelFormat, GL_UNSIGNED_BYTE, textureLevel.pData);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-	glGenerateMipmap(GL_TEXTURE_2D);
-	ApplyParams(params);
+	// single channel textures read as grey in the shaders, the same as the 3 component data they replace
+	if (GetTextureFormatComponents(format) == 1)
+	{
+		const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTextureParameteriv(m_id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
 
-	stbi_image_free(pTextureData);
+	return true;
 }
 
 void Texture::ApplyParams(const TextureParams& params)
@@ -83,16 +142,16 @@ void Texture::ApplyParams(const TextureParams& params)
 	switch (params.filterMode)
 	{
 	case FM_NEAREST:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		break;
 	case FM_BILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		break;
 	case FM_TRILINEAR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(m_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		break;
 	default:
 		printf("Error. Invalid filter mode %i specified for texture \"%s\"\n", params.filterMode, m_filename.c_str());
@@ -102,21 +161,21 @@ void Texture::ApplyParams(const TextureParams& params)
 	switch (params.wrapMode)
 	{
 	case WM_REPEAT:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		break;
 	case WM_CLAMP:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		break;
 	case WM_BORDER:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, glm::value_ptr(params.borderColor));
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTextureParameterfv(m_id, GL_TEXTURE_BORDER_COLOR, glm::value_ptr(params.borderColor));
 		break;
 	case WM_MIRROR:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+		glTextureParameteri(m_id, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
 		break;
 	default:
 		printf("Error. Invalid wrap mode %i specified for texture \"%s\"\n", params.wrapMode, m_filename.c_str());
@@ -124,13 +183,7 @@ void Texture::ApplyParams(const TextureParams& params)
 	}
 }
 
-void Texture::Bind()
+void Texture::Bind(unsigned int unit)
 {
-	if (s_currentTexture == m_id)
-	{
-		return;
-	}
-
-	glBindTexture(GL_TEXTURE_2D, m_id);
-	s_currentTexture = m_id;
+	GLStateCache::GetInstance()->BindTexture(unit, m_id);
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 
 typedef unsigned int textureId_t;
 
+struct TextureLevel;
+
 enum TextureWrapMode
 {
 	WM_REPEAT,
@@ -23,11 +25,39 @@ enum TextureFilterMode
 	FM_TRILINEAR,	// linear interpolation between texels and between closest mipmaps
 };
 
+// pixel layouts a texture can be stored in, either on disk or on the GPU
+enum TextureFormat
+{
+	TF_R8,
+	TF_RG8,
+	TF_RGB8,
+	TF_RGBA8,
+
+	// block compressed, 4x4 texels per block
+	TF_BC1,		// RGB, 8 bytes per block
+	TF_BC3,		// RGBA, 16 bytes per block
+	TF_BC4,		// R, 8 bytes per block
+	TF_BC5,		// RG, 16 bytes per block
+	TF_BC7,		// RGBA, 16 bytes per block
+};
+
+// block compression orca-bake applies when baking a texture. Textures decoded at runtime are always uncompressed.
+enum TextureCompression
+{
+	TC_NONE,
+	TC_BC1,
+	TC_BC3,
+	TC_BC4,
+	TC_BC5,
+	TC_BC7,
+};
+
 struct TextureParams
 {
 	TextureFilterMode filterMode = FM_BILINEAR;
 	TextureWrapMode wrapMode = WM_REPEAT;
 	glm::vec4 borderColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	TextureCompression compression = TC_NONE;
 	int forceComponents = 0;
 	bool bGenerateMips = true;
 	bool bFlipVerticallyOnLoad = true;
@@ -38,24 +68,26 @@ class Texture
 	friend class TextureManager;
 
 public:
-	void Bind();
+	void Bind(unsigned int unit);
 
 	unsigned int GetWidth() const { return m_width; }
 	unsigned int GetHeight() const { return m_height; }
+	// true while an async load is still in flight and the texture is bound to TextureManager's placeholder
+	bool IsPlaceholder() const { return m_bPlaceholder; }
 
 private:
 	std::string m_filename;
 	textureId_t m_id;
 	int m_width;
 	int m_height;
-
-	static textureId_t s_currentTexture;
+	bool m_bPlaceholder;
 
 	Texture();
 	Texture(const std::string& filename, const TextureParams& params, bool isSRGB = false);
 	~Texture();
 
 	void Load(const std::string& filename, const TextureParams& params, bool isSRGB = false);
+	bool Upload(TextureFormat format, bool isSRGB, const TextureLevel* pLevels, unsigned int numLevels);
 	void ApplyParams(const TextureParams& params);
 };
 
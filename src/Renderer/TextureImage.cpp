@@ -0,0 +1,298 @@
+#include "TextureImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Core/FileSystem.h"
+#include "Core/JobSystem.h"
+#include "Core/Simd.h"
+
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#endif
+#include <stb_image.h>
+
+namespace
+{
+	float SRGBToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	struct SRGBTables
+	{
+		SRGBTables()
+		{
+			for (unsigned int i = 0; i < 256; ++i)
+			{
+				toLinear[i] = SRGBToLinear(i / 255.0f);
+			}
+			for (unsigned int i = 0; i < 255; ++i)
+			{
+				thresholds[i] = SRGBToLinear((i + 0.5f) / 255.0f);
+			}
+		}
+
+		float toLinear[256];
+		// linear value halfway between each pair of consecutive 8 bit sRGB values, for exact rounding on the way back
+		float thresholds[255];
+	};
+
+	const SRGBTables& GetSRGBTables()
+	{
+		static const SRGBTables tables;
+		return tables;
+	}
+
+	// alpha is always stored linear, only colour channels go through the sRGB curve
+	bool IsSRGBChannel(unsigned int channel, bool bSRGB)
+	{
+		return bSRGB && channel < 3;
+	}
+
+	void DecodeRow(const unsigned char* pSrc, unsigned int width, unsigned int numComponents, bool bSRGB, float* pDst)
+	{
+		const SRGBTables& tables = GetSRGBTables();
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			for (unsigned int c = 0; c < 4; ++c)
+			{
+				const unsigned char value = c < numComponents ? pSrc[x * numComponents + c] : 0;
+				pDst[x * 4 + c] = IsSRGBChannel(c, bSRGB) ? tables.toLinear[value] : value / 255.0f;
+			}
+		}
+	}
+
+	void EncodeRow(const float* pSrc, unsigned int width, unsigned int numComponents, bool bSRGB, unsigned char* pDst)
+	{
+		const SRGBTables& tables = GetSRGBTables();
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			for (unsigned int c = 0; c < numComponents; ++c)
+			{
+				const float value = pSrc[x * 4 + c];
+				if (IsSRGBChannel(c, bSRGB))
+				{
+					pDst[x * numComponents + c] = static_cast<unsigned char>(std::upper_bound(tables.thresholds, tables.thresholds + 255, value) - tables.thresholds);
+				}
+				else
+				{
+					pDst[x * numComponents + c] = static_cast<unsigned char>(std::min(std::max(value * 255.0f + 0.5f, 0.0f), 255.0f));
+				}
+			}
+		}
+	}
+}
+
+unsigned int GetTextureFormatComponents(TextureFormat format)
+{
+	switch (format)
+	{
+	case TF_R8:
+	case TF_BC4:
+		return 1;
+	case TF_RG8:
+	case TF_BC5:
+		return 2;
+	case TF_RGB8:
+	case TF_BC1:
+		return 3;
+	case TF_RGBA8:
+	case TF_BC3:
+	case TF_BC7:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+bool IsCompressedFormat(TextureFormat format)
+{
+	return format >= TF_BC1;
+}
+
+bool HasSRGBVariant(TextureFormat format)
+{
+	return format == TF_RGB8 || format == TF_RGBA8 || format == TF_BC1 || format == TF_BC3 || format == TF_BC7;
+}
+
+unsigned int GetTextureFormatBlockSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TF_BC1:
+	case TF_BC4:
+		return 8;
+	case TF_BC3:
+	case TF_BC5:
+	case TF_BC7:
+		return 16;
+	default:
+		return GetTextureFormatComponents(format);
+	}
+}
+
+TextureFormat GetCompressedFormat(TextureCompression compression)
+{
+	switch (compression)
+	{
+	case TC_BC1:
+		return TF_BC1;
+	case TC_BC3:
+		return TF_BC3;
+	case TC_BC4:
+		return TF_BC4;
+	case TC_BC5:
+		return TF_BC5;
+	case TC_BC7:
+	default:
+		return TF_BC7;
+	}
+}
+
+size_t GetTextureLevelSize(TextureFormat format, unsigned int width, unsigned int height)
+{
+	if (IsCompressedFormat(format))
+	{
+		return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetTextureFormatBlockSize(format);
+	}
+
+	return static_cast<size_t>(width) * height * GetTextureFormatComponents(format);
+}
+
+unsigned int GetMipLevelCount(unsigned int width, unsigned int height)
+{
+	unsigned int numLevels = 1;
+	for (unsigned int size = std::max(width, height); size > 1; size >>= 1)
+	{
+		++numLevels;
+	}
+	return numLevels;
+}
+
+bool DecodeTextureImage(const std::string& filename, const TextureParams& params, bool isSRGB, TextureImage& outImage)
+{
+	File file;
+	if (!FileSystem::GetInstance()->Open(filename, file))
+	{
+		printf("Failed to load texture \"%s\"\n", filename.c_str());
+		return false;
+	}
+
+	int width = 0;
+	int height = 0;
+	int numChannels = 0;
+	unsigned char* pPixels = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, &numChannels, params.forceComponents);
+	if (!pPixels)
+	{
+		printf("Failed to decode texture \"%s\". %s\n", filename.c_str(), stbi_failure_reason());
+		return false;
+	}
+	numChannels = params.forceComponents == 0 ? numChannels : params.forceComponents;
+
+	switch (numChannels)
+	{
+	case 1:
+		outImage.format = TF_R8;
+		break;
+	case 2:
+		outImage.format = TF_RG8;
+		break;
+	case 3:
+		outImage.format = TF_RGB8;
+		break;
+	case 4:
+		outImage.format = TF_RGBA8;
+		break;
+	default:
+		printf("Error. Unsupported number of channels (%i) in texture \"%s\"\n", numChannels, filename.c_str());
+		stbi_image_free(pPixels);
+		return false;
+	}
+
+	outImage.bSRGB = isSRGB && HasSRGBVariant(outImage.format);
+	outImage.bFlippedVertically = params.bFlipVerticallyOnLoad;
+	outImage.width = width;
+	outImage.height = height;
+	outImage.levels.resize(1);
+
+	std::vector<unsigned char>& level = outImage.levels[0];
+	const size_t rowSize = static_cast<size_t>(width) * numChannels;
+	level.resize(rowSize * height);
+	if (params.bFlipVerticallyOnLoad)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			memcpy(level.data() + rowSize * y, pPixels + rowSize * (height - 1 - y), rowSize);
+		}
+	}
+	else
+	{
+		memcpy(level.data(), pPixels, level.size());
+	}
+
+	stbi_image_free(pPixels);
+	return true;
+}
+
+void GenerateMipChain(TextureImage& image)
+{
+	if (IsCompressedFormat(image.format))
+	{
+		printf("Error. Can't generate mips for a compressed texture\n");
+		return;
+	}
+
+	const unsigned int numComponents = GetTextureFormatComponents(image.format);
+	const unsigned int numLevels = GetMipLevelCount(image.width, image.height);
+	image.levels.resize(numLevels);
+
+	// filter in linear space with every texel padded out to 4 floats, so each one is a single SSE register
+	std::vector<float> src(static_cast<size_t>(image.width) * image.height * 4);
+	std::vector<float> dst;
+	JobSystem::GetInstance()->ParallelFor(image.height, [&](unsigned int y)
+	{
+		DecodeRow(image.levels[0].data() + static_cast<size_t>(y) * image.width * numComponents, image.width, numComponents, image.bSRGB, src.data() + static_cast<size_t>(y) * image.width * 4);
+	});
+
+	unsigned int srcWidth = image.width;
+	unsigned int srcHeight = image.height;
+	for (unsigned int level = 1; level < numLevels; ++level)
+	{
+		const unsigned int dstWidth = std::max(srcWidth >> 1, 1u);
+		const unsigned int dstHeight = std::max(srcHeight >> 1, 1u);
+		dst.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+		image.levels[level].resize(GetTextureLevelSize(image.format, dstWidth, dstHeight));
+
+		JobSystem::GetInstance()->ParallelFor(dstHeight, [&](unsigned int y)
+		{
+			// clamp for the odd row/column left over when the source dimension is 1
+			const float* pRow0 = src.data() + static_cast<size_t>(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+			const float* pRow1 = src.data() + static_cast<size_t>(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+			float* pDstRow = dst.data() + static_cast<size_t>(y) * dstWidth * 4;
+			for (unsigned int x = 0; x < dstWidth; ++x)
+			{
+				const unsigned int x0 = std::min(x * 2, srcWidth - 1) * 4;
+				const unsigned int x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+#ifdef ORCA_SSE2
+				const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(pRow0 + x0), _mm_loadu_ps(pRow0 + x1)), _mm_add_ps(_mm_loadu_ps(pRow1 + x0), _mm_loadu_ps(pRow1 + x1)));
+				_mm_storeu_ps(pDstRow + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+				for (unsigned int c = 0; c < 4; ++c)
+				{
+					pDstRow[x * 4 + c] = (pRow0[x0 + c] + pRow0[x1 + c] + pRow1[x0 + c] + pRow1[x1 + c]) * 0.25f;
+				}
+#endif
+			}
+
+			EncodeRow(pDstRow, dstWidth, numComponents, image.bSRGB, image.levels[level].data() + static_cast<size_t>(y) * dstWidth * numComponents);
+		});
+
+		// each level is filtered from the full precision previous one rather than its 8 bit version
+		std::swap(src, dst);
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef TEXTURE_IMAGE_H
+#define TEXTURE_IMAGE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Texture.h"
+
+// CPU-side texture data with its mip chain, level 0 first. Rows (of texels or blocks) are tightly packed.
+struct TextureImage
+{
+	TextureFormat format = TF_RGBA8;
+	bool bSRGB = false;
+	bool bFlippedVertically = false;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<std::vector<unsigned char>> levels;
+};
+
+// view of a single mip level, used to upload from either a TextureImage or a mapped baked file
+struct TextureLevel
+{
+	const unsigned char* pData = nullptr;
+	size_t size = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
+
+unsigned int GetTextureFormatComponents(TextureFormat format);
+bool IsCompressedFormat(TextureFormat format);
+bool HasSRGBVariant(TextureFormat format);
+// bytes per texel for uncompressed formats, bytes per 4x4 block for compressed ones
+unsigned int GetTextureFormatBlockSize(TextureFormat format);
+TextureFormat GetCompressedFormat(TextureCompression compression);
+size_t GetTextureLevelSize(TextureFormat format, unsigned int width, unsigned int height);
+unsigned int GetMipLevelCount(unsigned int width, unsigned int height);
+
+// decodes an image file into level 0 of outImage, applying the flip and component count from params. Doesn't touch
+// any global decoder state, so it can run on several threads at once.
+bool DecodeTextureImage(const std::string& filename, const TextureParams& params, bool isSRGB, TextureImage& outImage);
+
+// fills in levels 1..n from level 0 with a 2x2 box filter. The filter runs on floats in linear space, so sRGB images
+// don't darken as they shrink, and rows are spread across the job system.
+void GenerateMipChain(TextureImage& image);
+
+#endif
\ No newline at end of file
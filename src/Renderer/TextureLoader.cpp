@@ -0,0 +1,111 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "Core/FileSystem.h"
+
+namespace
+{
+	// the baked copy is only usable if it came from the current source image with the same load settings
+	bool OpenBakedTexture(const std::string& filename, const TextureParams& params, bool isSRGB, Ktx2File& bakedFile)
+	{
+		if (!bakedFile.Open(filename + BAKED_TEXTURE_EXTENSION))
+		{
+			return false;
+		}
+
+		const TextureFormat format = bakedFile.GetFormat();
+		const unsigned int numComponents = GetTextureFormatComponents(format);
+		const bool bMatchesCompression = params.compression == TC_NONE ? !IsCompressedFormat(format) : format == GetCompressedFormat(params.compression);
+		const bool bMatchesParams = bMatchesCompression
+			&& (params.forceComponents == 0 || params.forceComponents == static_cast<int>(numComponents))
+			&& bakedFile.IsSRGB() == (isSRGB && HasSRGBVariant(format))
+			&& bakedFile.IsFlippedVertically() == params.bFlipVerticallyOnLoad
+			&& bakedFile.GetNumLevels() == (params.bGenerateMips ? GetMipLevelCount(bakedFile.GetWidth(), bakedFile.GetHeight()) : 1);
+
+		hash_t sourceHash = 0;
+		if (!bMatchesParams || !bakedFile.HasSourceHash() || !FileSystem::GetInstance()->GetFileHash(filename, sourceHash) || sourceHash != bakedFile.GetSourceHash())
+		{
+			bakedFile.Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool HasExtension(const std::string& filename, const char* pExtension)
+	{
+		const size_t length = strlen(pExtension);
+		return filename.size() >= length && std::equal(filename.end() - length, filename.end(), pExtension,
+			[](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+	}
+
+	template <typename T>
+	void GetFileLevels(const T& file, LoadedTextureData& outData)
+	{
+		outData.format = file.GetFormat();
+		outData.bSRGB = file.IsSRGB();
+		outData.levels.resize(file.GetNumLevels());
+		for (unsigned int i = 0; i < file.GetNumLevels(); ++i)
+		{
+			outData.levels[i] = file.GetLevel(i);
+		}
+	}
+}
+
+bool LoadTextureData(const std::string& filename, const TextureParams& params, bool isSRGB, LoadedTextureData& outData)
+{
+	// textures authored as GPU ready containers are used as they are
+	if (HasExtension(filename, BAKED_TEXTURE_EXTENSION))
+	{
+		if (!outData.bakedFile.Open(filename))
+		{
+			return false;
+		}
+		GetFileLevels(outData.bakedFile, outData);
+		return true;
+	}
+	if (HasExtension(filename, ".dds"))
+	{
+		if (!outData.ddsFile.Open(filename))
+		{
+			return false;
+		}
+		GetFileLevels(outData.ddsFile, outData);
+		return true;
+	}
+
+	// prefer the copy produced by orca-bake, which is already decoded (and compressed) and has its mip chain
+	if (OpenBakedTexture(filename, params, isSRGB, outData.bakedFile))
+	{
+		GetFileLevels(outData.bakedFile, outData);
+		return true;
+	}
+
+	// compressing is too slow to do at load time, so unbaked textures fall back to uncompressed data
+	if (!DecodeTextureImage(filename, params, isSRGB, outData.image))
+	{
+		return false;
+	}
+
+	// still on the loading thread, so the driver never has to generate mips
+	if (params.bGenerateMips)
+	{
+		GenerateMipChain(outData.image);
+	}
+
+	outData.format = outData.image.format;
+	outData.bSRGB = outData.image.bSRGB;
+	outData.levels.resize(outData.image.levels.size());
+	for (unsigned int i = 0; i < outData.levels.size(); ++i)
+	{
+		TextureLevel& level = outData.levels[i];
+		level.pData = outData.image.levels[i].data();
+		level.size = outData.image.levels[i].size();
+		level.width = std::max(outData.image.width >> i, 1u);
+		level.height = std::max(outData.image.height >> i, 1u);
+	}
+	return true;
+}
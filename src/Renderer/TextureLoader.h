@@ -0,0 +1,27 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "DdsFile.h"
+#include "Ktx2File.h"
+#include "TextureImage.h"
+
+// Pixel data for a texture, ready to upload. Levels either point into a mapped KTX2/DDS file or into pixels
+// decoded from the source image, all of which are owned here.
+struct LoadedTextureData
+{
+	Ktx2File bakedFile;
+	DdsFile ddsFile;
+	TextureImage image;
+	std::vector<TextureLevel> levels;
+	TextureFormat format = TF_RGBA8;
+	bool bSRGB = false;
+};
+
+// loads a texture's pixels without touching GL, preferring a baked copy that matches the source and load settings.
+// .ktx2 and .dds files are loaded as they are, already compressed data isn't flipped. Safe to call from worker threads.
+bool LoadTextureData(const std::string& filename, const TextureParams& params, bool isSRGB, LoadedTextureData& outData);
+
+#endif
@@ -1,14 +1,41 @@
 #include "TextureManager.h"
 
+#include <atomic>
+
+#include "Core/FileSystem.h"
+#include "TextureLoader.h"
+
+struct TextureManager::AsyncLoad
+{
+	Texture* pTexture = nullptr;
+	std::string filename;
+	TextureParams params;
+	bool isSRGB = false;
+
+	// written by the worker before the load is handed back to the render thread
+	LoadedTextureData data;
+	bool bSuccess = false;
+
+	// set when the texture is deleted before its load finishes
+	std::atomic<bool> bCancelled{ false };
+};
+
 TextureManager* TextureManager::s_instance = nullptr;
 
 TextureManager::TextureManager()
 	: m_textures()
+	, m_pendingLoads()
+	, m_completedLoads()
+	, m_placeholderId(0)
 {
 }
 
 TextureManager::~TextureManager()
 {
+	for (auto& it : m_pendingLoads)
+	{
+		it.second->bCancelled = true;
+	}
 	m_textures.clear();
 }
 
@@ -33,6 +60,7 @@ Texture* TextureManager::CreateTexture(const std::string& filename, const Textur
 	auto it = m_textures.find(filename);
 	if (it != m_textures.end())
 	{
+		++it->second.refCount;
 		return it->second.pTexture;
 	}
 
@@ -44,17 +72,109 @@ Texture* TextureManager::CreateTexture(const std::string& filename, const Textur
 	return pTexture;
 }
 
+Texture* TextureManager::CreateTextureAsync(const std::string& filename, const TextureParams& params, bool isSRGB)
+{
+	auto it = m_textures.find(filename);
+	if (it != m_textures.end())
+	{
+		++it->second.refCount;
+		return it->second.pTexture;
+	}
+
+	if (m_placeholderId == 0)
+	{
+		CreatePlaceholder();
+	}
+
+	Texture* pTexture = new Texture();
+	pTexture->m_filename = filename;
+	pTexture->m_id = m_placeholderId;
+	pTexture->m_width = 1;
+	pTexture->m_height = 1;
+	pTexture->m_bPlaceholder = true;
+	m_textures.emplace(std::piecewise_construct, std::forward_as_tuple(filename), std::forward_as_tuple(pTexture, 1));
+
+	auto pLoad = std::make_shared<AsyncLoad>();
+	pLoad->pTexture = pTexture;
+	pLoad->filename = filename;
+	pLoad->params = params;
+	pLoad->isSRGB = isSRGB;
+	m_pendingLoads.emplace(pTexture, pLoad);
+
+	// both the baked copy and the source are needed, the source for the hash that validates the baked copy. Reading
+	// them up front lets the reads of every texture in flight overlap instead of each load blocking a worker on disk.
+	FileSystem::GetInstance()->Prefetch({ filename + BAKED_TEXTURE_EXTENSION, filename }, [this, pLoad]()
+	{
+		if (!pLoad->bCancelled)
+		{
+			pLoad->bSuccess = LoadTextureData(pLoad->filename, pLoad->params, pLoad->isSRGB, pLoad->data);
+		}
+
+		std::lock_guard<std::mutex> lock(m_completedLoadsMutex);
+		m_completedLoads.push_back(pLoad);
+	});
+
+	return pTexture;
+}
+
 void TextureManager::DeleteTexture(Texture* pTexture)
 {
 	auto it = m_textures.find(pTexture->m_filename);
 	if (it == m_textures.end())
 	{
 		printf("No texture \"%s\" found in TextureManager\n", pTexture->m_filename.c_str());
+		return;
 	}
 
 	if (--it->second.refCount == 0)
 	{
+		auto pendingIt = m_pendingLoads.find(it->second.pTexture);
+		if (pendingIt != m_pendingLoads.end())
+		{
+			pendingIt->second->bCancelled = true;
+			m_pendingLoads.erase(pendingIt);
+		}
+
 		delete it->second.pTexture;
 		m_textures.erase(it);
 	}
+}
+
+void TextureManager::Update()
+{
+	std::vector<std::shared_ptr<AsyncLoad>> completedLoads;
+	{
+		std::lock_guard<std::mutex> lock(m_completedLoadsMutex);
+		completedLoads.swap(m_completedLoads);
+	}
+
+	for (const auto& pLoad : completedLoads)
+	{
+		if (pLoad->bCancelled)
+		{
+			continue;
+		}
+		m_pendingLoads.erase(pLoad->pTexture);
+
+		// a texture that failed to load just keeps showing the placeholder
+		Texture* pTexture = pLoad->pTexture;
+		LoadedTextureData& data = pLoad->data;
+		if (pLoad->bSuccess && pTexture->Upload(data.format, data.bSRGB, data.levels.data(), static_cast<unsigned int>(data.levels.size())))
+		{
+			pTexture->m_bPlaceholder = false;
+			pTexture->ApplyParams(pLoad->params);
+		}
+	}
+}
+
+void TextureManager::CreatePlaceholder()
+{
+	// mid grey, so unloaded textures neither blow out nor black out the lighting
+	const unsigned char pixel[4] = { 128, 128, 128, 255 };
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_placeholderId);
+	glTextureStorage2D(m_placeholderId, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(m_placeholderId, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	glTextureParameteri(m_placeholderId, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_placeholderId, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #ifndef TEXTURE_MANAGER_H
 #define TEXTURE_MANAGER_H
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Texture.h"
 
@@ -15,8 +18,15 @@ public:
 
 	Texture* CreateTexture(const std::string& filename, bool isSRGB = false);
 	Texture* CreateTexture(const std::string& filename, const TextureParams& params, bool isSRGB = false);
+	// returns straight away with a texture bound to a 1x1 placeholder. The image is loaded on a worker thread and
+	// swapped in by Update() once it's ready, so callers can hold on to the returned pointer as usual.
+	Texture* CreateTextureAsync(const std::string& filename, const TextureParams& params, bool isSRGB = false);
 	void DeleteTexture(Texture* pTexture);
 
+	// uploads any async loads that have finished. Must be called on the thread that owns the GL context.
+	void Update();
+	unsigned int GetNumPendingTextures() const { return static_cast<unsigned int>(m_pendingLoads.size()); }
+
 private:
 	struct Entry
 	{
@@ -26,10 +36,22 @@ private:
 		Entry(Texture* pTexture, int refCount) : pTexture(pTexture), refCount(refCount) {}
 	};
 
+	struct AsyncLoad;
+
 	TextureManager();
 
+	void CreatePlaceholder();
+
 	std::unordered_map<std::string, Entry> m_textures;
 
+	// loads still in flight, by the texture waiting on them
+	std::unordered_map<Texture*, std::shared_ptr<AsyncLoad>> m_pendingLoads;
+	// loads the workers have finished, waiting for Update() to upload them
+	std::vector<std::shared_ptr<AsyncLoad>> m_completedLoads;
+	std::mutex m_completedLoadsMutex;
+
+	textureId_t m_placeholderId;
+
 	static TextureManager* s_instance;
 };
 
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <cerrno>
 
@@ -8,17 +9,46 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "Core/FileSystem.h"
 #include "Core/InputManager.h"
 #include "Renderer/Camera.h"
+#include "Renderer/FrameRingBuffer.h"
+#include "Renderer/GLStateCache.h"
+#include "Renderer/GeometryPool.h"
+#include "Renderer/GpuCuller.h"
 #include "Renderer/Mesh.h"
 #include "Renderer/Model.h"
+#include "Renderer/OcclusionCuller.h"
+#include "Renderer/RenderQueue.h"
 #include "Renderer/Shader.h"
+#include "Renderer/ShaderManager.h"
 #include "Renderer/Texture.h"
 #include "Renderer/TextureManager.h"
 
 void OnFramebufferResize(GLFWwindow* pWindow, int width, int height);
 void ProcessInput(GLFWwindow* pWindow);
 
+// match the uniform blocks in assets/shaders/include/common.glsl, laid out std140
+struct MatricesConstants
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+};
+
+struct LightingConstants
+{
+	glm::vec3 position;
+	float padding0;
+	glm::vec3 color;
+	float ambientStrength;
+};
+
+struct CameraConstants
+{
+	glm::vec3 viewPosition;
+	float padding0;
+};
+
 struct Vertex
 {
 	glm::vec3 position;
@@ -118,158 +148,227 @@ int main(int argc, char** argv)
 	pInputManager->SetContext(pWindow);
 	TextureManager* pTextureManager = TextureManager::GetInstance();
 
-	// compile and link shaders
-	// --------------------------------------------------------------------------
-	Shader solidShader("assets/shaders/solid_color.vert", "assets/shaders/solid_color.frag");
-
-	// set up vertex data and attributes
-	// --------------------------------------------------------------------------
-	Model model;
+	// an archive built with orca-bake --pack takes priority over the loose files in assets/
+	FileSystem* pFileSystem = FileSystem::GetInstance();
+	if (pFileSystem->Exists("assets.opak"))
 	{
-		 auto start = glfwGetTime();
-		 model.LoadModel("assets/models/sponza/sponza.obj");
-		 auto end = glfwGetTime();
-		 printf("Loading model (assimp) took %fms\n", (end - start) * 1000.0f);
+		pFileSystem->Mount("assets.opak");
 	}
 
-	GLuint vao, vbo, ebo;
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &vbo);
-	glGenBuffers(1, &ebo);
-
-	glBindVertexArray(vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// NOTE: VAO stores any EBO bound, so don't unbind EBO until VAO is unbound
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-	glEnableVertexAttribArray(0);
-	// normals
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
-	// uvs
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
-	glEnableVertexAttribArray(2);
-
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
-
-	float rotationSpeed = 45.0f;
-	float translationLimit = 0.4f;
-	float scaleSpeed = 2.0f;
-
-	// camera
-	// --------------------------------------------------------------------------
-	const float fov = 90.0f;
-	const float nearPlane = 0.1f;
-	const float farPlane = 1000.0f;
-	Camera camera(WINDOW_WIDTH, WINDOW_HEIGHT, fov, nearPlane, farPlane);
-	camera.SetPosition(glm::vec3(7.0f, 1.0f, -1.85f));
-	camera.LookAt(glm::vec3(0.0f, 0.8f, -1.85f));
-	camera.SetMovementSpeed(2.0f);
-
-	// transforms
-	// --------------------------------------------------------------------------
-	glm::mat4 modelTransform(1.0f);
-	modelTransform = glm::translate(modelTransform, glm::vec3(-1.0f, -1.0f, -1.5f));
-	modelTransform = glm::scale(modelTransform, glm::vec3(0.01f, 0.01f, 0.01f));
-
-	glm::mat4 lightTransform = glm::mat4(1.0f);
-	lightTransform = glm::translate(lightTransform, glm::vec3(-3.0f, 1.3f, -0.7f));
-	lightTransform = glm::scale(lightTransform, glm::vec3(0.25f));
-
-	// lighting data
+	// compile and link shaders
 	// --------------------------------------------------------------------------
-	glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
-	float ambientStrength = 0.001f;
+	ShaderManager* pShaderManager = ShaderManager::GetInstance();
+	Shader* pSolidShader = pShaderManager->CreateShader("assets/shaders/solid_color.vert", "assets/shaders/solid_color.frag");
 
-	solidShader.Bind();
-	solidShader.SetUniform("color", lightColor);
-
-	// uniform buffer object for lights and matrices
-	// --------------------------------------------------------------------------
-	GLuint uboMatrices, uboLighting, uboCamera;
-
-	glGenBuffers(1, &uboMatrices);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 128, nullptr, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
-	
-	glGenBuffers(1, &uboLighting);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboLighting);
-	glBufferData(GL_UNIFORM_BUFFER, 32, nullptr, GL_STATIC_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 1, uboLighting);
-
-	// set lighting data now
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, 12, glm::value_ptr(lightTransform[3]));
-	glBufferSubData(GL_UNIFORM_BUFFER, 16, 12, glm::value_ptr(lightColor));
-	glBufferSubData(GL_UNIFORM_BUFFER, 28, 4, &ambientStrength);
-
-	glGenBuffers(1, &uboCamera);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboCamera);
-	glBufferData(GL_UNIFORM_BUFFER, 16, nullptr, GL_DYNAMIC_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 2, uboCamera);
-
-	// set model matrix
-	model.SetTransform(modelTransform);
-
-	// start currentTime 1 frame back so we don't get weird timing issues on the first frame
-	float deltaTime = 1.0f / 60.0f;
-	float currentTime = glfwGetTime() - deltaTime;
-	float previousTime = currentTime;
-
-	while (!glfwWindowShouldClose(pWindow))
+	// everything that owns GL objects lives in this scope, so it is all destroyed before the context is
 	{
-		previousTime = currentTime;
-		currentTime = glfwGetTime();
-		deltaTime = currentTime - previousTime;
-		printf("Frame time: %2.2fms (%.1f fps)\r", deltaTime * 1000.0f, 1.0f / deltaTime);
-
-		// input
-		// ----------------------------------------------------------------------
-		ProcessInput(pWindow);
-
-		// update
-		// ----------------------------------------------------------------------
-		camera.Update(deltaTime);
-
-		const glm::mat4& projectionMatrix = camera.GetProjectionMatrix();
-		const glm::mat4& viewMatrix = camera.GetViewMatrix();
-		const glm::vec3 lightPos(lightTransform[3]);
-
-		// set matrix uniform buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, 64, glm::value_ptr(projectionMatrix));
-		glBufferSubData(GL_UNIFORM_BUFFER, 64, 64, glm::value_ptr(viewMatrix));
-
-		// same for camera
-		glBindBuffer(GL_UNIFORM_BUFFER, uboCamera);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, 12, glm::value_ptr(camera.GetPosition()));
-
-		// render
-		// ----------------------------------------------------------------------
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		model.Draw();
-
-		glBindVertexArray(vao);
-		solidShader.Bind();
-		solidShader.SetUniform("model", lightTransform);
-		solidShader.SetUniform("view", viewMatrix);
-		solidShader.SetUniform("projection", projectionMatrix);
-		glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(indices[0]), GL_UNSIGNED_INT, 0);
-
-		// swap buffers and poll IO events
-		// ----------------------------------------------------------------------
-		glfwSwapBuffers(pWindow);
-		glfwPollEvents();
+		// set up vertex data and attributes
+		// --------------------------------------------------------------------------
+		Model model;
+		{
+			 auto start = glfwGetTime();
+			 model.LoadModel("assets/models/sponza/sponza.obj");
+			 auto end = glfwGetTime();
+			 printf("Loading model took %fms\n", (end - start) * 1000.0f);
+		}
+
+		GLStateCache* pStateCache = GLStateCache::GetInstance();
+		GeometryPool* pGeometryPool = GeometryPool::GetInstance();
+
+		GLuint vao, vbo, ebo;
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+
+		pStateCache->BindVertexArray(vao);
+
+		pStateCache->BindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+		// NOTE: VAO stores any EBO bound, so don't unbind EBO until VAO is unbound
+		pStateCache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+		// position
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+		glEnableVertexAttribArray(0);
+		// normals
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+		glEnableVertexAttribArray(1);
+		// uvs
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+		glEnableVertexAttribArray(2);
+
+		pStateCache->SetEnabled(GL_DEPTH_TEST, true);
+		glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+
+		float rotationSpeed = 45.0f;
+		float translationLimit = 0.4f;
+		float scaleSpeed = 2.0f;
+
+		// camera
+		// --------------------------------------------------------------------------
+		const float fov = 90.0f;
+		const float nearPlane = 0.1f;
+		const float farPlane = 1000.0f;
+		Camera camera(WINDOW_WIDTH, WINDOW_HEIGHT, fov, nearPlane, farPlane);
+		camera.SetPosition(glm::vec3(7.0f, 1.0f, -1.85f));
+		camera.LookAt(glm::vec3(0.0f, 0.8f, -1.85f));
+		camera.SetMovementSpeed(2.0f);
+
+		// transforms
+		// --------------------------------------------------------------------------
+		glm::mat4 modelTransform(1.0f);
+		modelTransform = glm::translate(modelTransform, glm::vec3(-1.0f, -1.0f, -1.5f));
+		modelTransform = glm::scale(modelTransform, glm::vec3(0.01f, 0.01f, 0.01f));
+
+		glm::mat4 lightTransform = glm::mat4(1.0f);
+		lightTransform = glm::translate(lightTransform, glm::vec3(-3.0f, 1.3f, -0.7f));
+		lightTransform = glm::scale(lightTransform, glm::vec3(0.25f));
+
+		// lighting data
+		// --------------------------------------------------------------------------
+		glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
+		float ambientStrength = 0.001f;
+
+		// handles are resolved once, the per-frame sets below are plain integers
+		const uniformHandle_t solidColorHandle = pSolidShader->GetUniformHandle(HashLiteral("color"));
+		const uniformHandle_t solidModelHandle = pSolidShader->GetUniformHandle(HashLiteral("model"));
+		const uniformHandle_t solidViewHandle = pSolidShader->GetUniformHandle(HashLiteral("view"));
+		const uniformHandle_t solidProjectionHandle = pSolidShader->GetUniformHandle(HashLiteral("projection"));
+
+		pSolidShader->Bind();
+		pSolidShader->SetUniform(solidColorHandle, lightColor);
+
+		// per frame uniform blocks for lights and matrices, written straight into mapped memory
+		// --------------------------------------------------------------------------
+		FrameRingBuffer<MatricesConstants> matricesBuffer;
+		FrameRingBuffer<LightingConstants> lightingBuffer;
+		FrameRingBuffer<CameraConstants> cameraBuffer;
+
+		// set model matrix
+		model.SetTransform(modelTransform);
+		model.SetOcclusionQueries(true);
+
+		// --gpu-culling culls and draws the model on the GPU instead, where GL 4.6 is available
+		GpuCuller gpuCuller;
+		for (int i = 1; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "--gpu-culling") == 0)
+			{
+				if (GpuCuller::IsSupported())
+				{
+					model.SetGpuDriven(true);
+				}
+				else
+				{
+					printf("GPU culling needs OpenGL 4.6, falling back to CPU culling\n");
+				}
+			}
+		}
+
+		RenderQueue renderQueue;
+		// anything under a couple of pixels across can't contribute more than noise
+		renderQueue.GetCuller().SetMinScreenSize(2.0f);
+		OcclusionCuller occlusionCuller;
+		renderQueue.SetOcclusionCuller(&occlusionCuller);
+
+		// start currentTime 1 frame back so we don't get weird timing issues on the first frame
+		float deltaTime = 1.0f / 60.0f;
+		float currentTime = glfwGetTime() - deltaTime;
+		float previousTime = currentTime;
+
+		while (!glfwWindowShouldClose(pWindow))
+		{
+			previousTime = currentTime;
+			currentTime = glfwGetTime();
+			deltaTime = currentTime - previousTime;
+
+			pStateCache->BeginFrame();
+			const GLStateStats& stateStats = pStateCache->GetLastFrameStats();
+			const FrustumCuller& culler = renderQueue.GetCuller();
+			printf("Frame time: %2.2fms (%.1f fps), state calls: %u issued, %u filtered, draws: %u visible in %u multi draws, %u outside frustum, %u too small, %u occluded, queries: %u issued, %u skipped, GPU multi draws: %u\r", deltaTime * 1000.0f, 1.0f / deltaTime,
+				stateStats.numIssued, stateStats.numFiltered, renderQueue.GetNumDraws(), renderQueue.GetNumMultiDraws(), culler.GetNumFrustumCulled(), culler.GetNumSmallCulled(), renderQueue.GetNumOccluded(),
+				renderQueue.GetNumQueriesIssued(), renderQueue.GetNumQuerySkipped(), gpuCuller.GetNumMultiDraws());
+
+			// input
+			// ----------------------------------------------------------------------
+			ProcessInput(pWindow);
+
+			// update
+			// ----------------------------------------------------------------------
+			pTextureManager->Update();
+			pGeometryPool->Update();
+			camera.Update(deltaTime);
+
+			const glm::mat4& projectionMatrix = camera.GetProjectionMatrix();
+			const glm::mat4& viewMatrix = camera.GetViewMatrix();
+			const glm::vec3 lightPos(lightTransform[3]);
+
+			// set the uniform blocks' data for this frame
+			MatricesConstants* pMatrices = matricesBuffer.BeginFrame();
+			pMatrices->projection = projectionMatrix;
+			pMatrices->view = viewMatrix;
+			matricesBuffer.BindRange(GL_UNIFORM_BUFFER, 0);
+
+			LightingConstants* pLighting = lightingBuffer.BeginFrame();
+			pLighting->position = lightPos;
+			pLighting->color = lightColor;
+			pLighting->ambientStrength = ambientStrength;
+			lightingBuffer.BindRange(GL_UNIFORM_BUFFER, 1);
+
+			CameraConstants* pCamera = cameraBuffer.BeginFrame();
+			pCamera->viewPosition = camera.GetPosition();
+			cameraBuffer.BindRange(GL_UNIFORM_BUFFER, 2);
+
+			// render
+			// ----------------------------------------------------------------------
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			occlusionCuller.Begin(projectionMatrix * viewMatrix);
+			model.SubmitOccluders(occlusionCuller);
+			occlusionCuller.Rasterize();
+
+			// GPU driven opaque draws go first, so the render queue's translucent ones blend over them
+			gpuCuller.Begin(camera);
+			model.DrawGpuDriven(gpuCuller, GCP_FIRST);
+			if (model.IsGpuDriven())
+			{
+				// the second pass picks up whatever this frame's depth shows last frame's hid wrongly, and the next
+				// frame's first pass tests against the same pyramid
+				int framebufferWidth = 0;
+				int framebufferHeight = 0;
+				glfwGetFramebufferSize(pWindow, &framebufferWidth, &framebufferHeight);
+				gpuCuller.UpdateDepthPyramid(framebufferWidth, framebufferHeight);
+				model.DrawGpuDriven(gpuCuller, GCP_SECOND);
+			}
+
+			renderQueue.Begin(camera);
+			model.Submit(renderQueue);
+			renderQueue.Flush();
+
+			pStateCache->BindVertexArray(vao);
+			pSolidShader->Bind();
+			pSolidShader->SetUniform(solidModelHandle, lightTransform);
+			pSolidShader->SetUniform(solidViewHandle, viewMatrix);
+			pSolidShader->SetUniform(solidProjectionHandle, projectionMatrix);
+			glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(indices[0]), GL_UNSIGNED_INT, 0);
+
+			// this frame's regions are free again once the GPU gets past everything drawn above
+			matricesBuffer.EndFrame();
+			lightingBuffer.EndFrame();
+			cameraBuffer.EndFrame();
+
+			// swap buffers and poll IO events
+			// ----------------------------------------------------------------------
+			glfwSwapBuffers(pWindow);
+			glfwPollEvents();
+		}
 	}
 
+	// programs have to go while the context is still alive
+	pShaderManager->DeleteShader(pSolidShader);
+
 	glfwTerminate();
 	return 0;
 }